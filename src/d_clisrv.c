@@ -83,6 +83,8 @@ boolean server = true; // true or false but !server == client
 #define client (!server)
 boolean nodownload = false;
 boolean serverrunning = false;
+boolean relay = false; // Client of the real server that passes the game on to viewers, see -relay
+boolean viewonly = false; // Joins without a player, to watch a relay or be one, see -viewer
 INT32 serverplayer = 0;
 char motd[254], server_context[8]; // Message of the Day, Unique Context (even without Mumble support)
 
@@ -113,12 +115,55 @@ tic_t servermaxping = 20; // server's max delay, in frames. Defaults to 20
 static tic_t nettics[MAXNETNODES]; // what tic the client have received
 static tic_t supposedtics[MAXNETNODES]; // nettics prevision for smaller packet
 static UINT8 nodewaiting[MAXNETNODES];
+static boolean nodeisviewer[MAXNETNODES]; // Watches without a player: a relay on the server, or a viewer on a relay
 static tic_t firstticstosend; // min of the nettics
 static tic_t tictoclear = 0; // optimize d_clearticcmd
 static tic_t maketic;
 
 static INT16 consistancy[TICQUEUE];
 
+#ifdef SATURNSYNCH
+// Extended consistency records, see cv_consistencyreport
+typedef struct
+{
+	tic_t tic;
+	UINT32 category[NUMCONSISTENCY];
+	UINT32 player[MAXPLAYERS];
+	consistencymobj_t *mobj; // Every mobj, in thinker order
+	size_t nummobjs, maxmobjs;
+	UINT8 numluavars;
+	UINT32 luaname[CONSISTENCYLUAVARS];
+	UINT32 luavalue[CONSISTENCYLUAVARS];
+} consistencyrecord_t;
+
+static consistencyrecord_t consistencyrecord[CONSISTENCYHISTORY];
+static tic_t consistencyasked[MAXNETNODES];
+
+// Adaptive tic batching, see cv_adaptivetics
+#define NODECMDQUEUE 32
+
+typedef struct
+{
+	ticcmd_t cmds[NODECMDQUEUE][MAXSPLITSCREENPLAYERS];
+	UINT8 head, count;
+	UINT16 seq; // Sequence number of the newest queued tic
+	boolean started; // Got a batch since the advice last changed
+	boolean primed; // Buffered enough to start feeding maketic
+	UINT8 batch; // Tics per packet the node was last told to send
+	UINT8 lead; // Tics held back to ride out jitter
+	tic_t lastarrival;
+	fixed_t jitter; // Smoothed variation in packet arrival, in tics
+} nodecmdqueue_t;
+
+static nodecmdqueue_t nodecmdqueue[MAXNETNODES];
+
+static UINT8 cl_ticbatch = 0; // Tics per packet the server asked for, 0 to send every tic as usual
+static ticcmd_t cl_cmdhistory[2*MAXTICBATCH][MAXSPLITSCREENPLAYERS]; // Every tic goes out in two packets
+static UINT16 cl_cmdseq = 0;
+static UINT8 cl_cmdsqueued = 0;
+static UINT8 cl_cmdsunsent = 0;
+#endif
+
 // Resynching shit!
 static UINT32 resynch_score[MAXNETNODES]; // "score" for kicking -- if this gets too high then cfail kick
 static UINT16 resynch_delay[MAXNETNODES]; // delay time before the player can be considered to have desynched
@@ -195,6 +240,19 @@ typedef struct textcmdtic_s
 ticcmd_t netcmds[TICQUEUE][MAXPLAYERS];
 static textcmdtic_t *textcmds[TEXTCMD_HASH_SIZE] = {NULL};
 
+// Freed textcmd entries are kept here for reuse, so that a running game
+// doesn't go to the zone allocator for every tic that carries a netxcmd.
+// The pools only grow once more entries are in use than ever before.
+#define TEXTCMD_PREALLOC BACKUPTICS
+static textcmdtic_t *freetextcmdtics = NULL;
+static textcmdplayer_t *freetextcmdplayers = NULL;
+static UINT32 textcmdticsowned = 0, textcmdplayersowned = 0; // Pooled or in use
+
+// Heap allocations counted where the send paths can make them. In PARANOIA
+// builds NetUpdate checks that a server tic makes none of them.
+static UINT32 textcmdallocs = 0; // Textcmd entries, when a pool runs dry
+static UINT32 gamestateallocs = 0; // Gamestate caches, compressed copies and deltas
+
 consvar_t cv_showjoinaddress = {"showjoinaddress", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 
 consvar_t cv_shownodeip = {"showipinnodelist", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
@@ -204,6 +262,10 @@ consvar_t cv_playbackspeed = {"playbackspeed", "1", 0, playbackspeed_cons_t, NUL
 
 consvar_t cv_httpsource = {"http_source", "", CV_SAVE, NULL, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+// How many files to download from http_source at once
+static CV_PossibleValue_t httpdownloads_cons_t[] = {{1, "MIN"}, {16, "MAX"}, {0, NULL}};
+consvar_t cv_httpdownloads = {"http_downloads", "4", CV_SAVE, httpdownloads_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 consvar_t cv_kicktime = {"kicktime", "10", CV_SAVE, CV_Unsigned, NULL, 0, NULL, NULL, 0, 0, NULL};
 
 static inline void *G_DcpyTiccmd(void* dest, const ticcmd_t* src, const size_t n)
@@ -232,6 +294,291 @@ static inline void *G_ScpyTiccmd(ticcmd_t* dest, void* src, const size_t n)
 	return ret+n;
 }
 
+#ifdef SATURNSYNCH
+// PT_SERVERDELTATICS: each cmd is a mask byte saying which fields differ
+// from the same player's cmd on the previous tic, followed by the changed
+// fields. The first tic of a packet is against the last tic the client has
+// acknowledged, which is named by a distance byte at the start of the cmds
+// (0 for a zeroed base). Both ends keep the cmds of the last tics sent or
+// accepted so that the base survives across packets.
+#define TICDELTA_FORWARD   0x01
+#define TICDELTA_SIDE      0x02
+#define TICDELTA_ANGLE     0x04 // zigzag varint
+#define TICDELTA_AIMING    0x08 // zigzag varint
+#define TICDELTA_BUTTONS   0x10 // varint, xored with the old buttons
+#define TICDELTA_DRIFTTURN 0x20 // zigzag varint
+#define TICDELTA_LATENCY   0x40
+
+#define TICDELTA_MAXSIZE (1 + 1 + 1 + 3 + 3 + 3 + 3 + 1)
+
+#define TICDELTAHISTORY (2*BACKUPTICS)
+
+typedef struct
+{
+	tic_t tic;
+	boolean valid; // False if the tic was sent twice with different cmds
+	ticcmd_t cmds[MAXPLAYERS]; // Slots past the packet's numslots are zeroed
+} ticdeltabase_t;
+
+static boolean can_receive_ticdelta[MAXNETNODES];
+static ticdeltabase_t *ticdeltasent[MAXNETNODES]; // Allocated for nodes that can receive deltas
+static ticdeltabase_t ticdeltareceived[TICDELTAHISTORY];
+static UINT8 ticdeltabuf[1 + BACKUPTICS * MAXPLAYERS * TICDELTA_MAXSIZE];
+static ticcmd_t ticdeltacmds[BACKUPTICS * MAXPLAYERS];
+static const ticcmd_t ticdeltazero;
+
+static UINT8 *D_WriteVarint(UINT8 *p, UINT16 v)
+{
+	while (v >= 0x80)
+	{
+		WRITEUINT8(p, (v & 0x7F) | 0x80);
+		v >>= 7;
+	}
+	WRITEUINT8(p, v);
+	return p;
+}
+
+// Returns -1 if the varint runs past the end of the packet
+static INT32 D_ReadVarint(UINT8 **p, const UINT8 *end)
+{
+	INT32 r = 0;
+	INT32 shift;
+
+	for (shift = 0; shift < 21; shift += 7)
+	{
+		UINT8 b;
+
+		if (*p >= end)
+			return -1;
+		b = *(*p)++;
+		r |= (b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return r & 0xFFFF;
+	}
+	return -1;
+}
+
+static UINT8 *D_WriteZigzag(UINT8 *p, INT16 old, INT16 cur)
+{
+	const INT16 d = (INT16)(cur - old);
+	return D_WriteVarint(p, (UINT16)(((UINT16)d << 1) ^ (UINT16)(d >> 15)));
+}
+
+static INT16 D_Unzigzag(INT16 old, INT32 v)
+{
+	return (INT16)(old + ((v >> 1) ^ -(v & 1)));
+}
+
+static UINT8 *D_WriteTiccmdDelta(UINT8 *p, const ticcmd_t *from, const ticcmd_t *to)
+{
+	UINT8 *mask = p++;
+
+	*mask = 0;
+
+	if (to->forwardmove != from->forwardmove)
+	{
+		*mask |= TICDELTA_FORWARD;
+		WRITESINT8(p, to->forwardmove);
+	}
+	if (to->sidemove != from->sidemove)
+	{
+		*mask |= TICDELTA_SIDE;
+		WRITESINT8(p, to->sidemove);
+	}
+	if (to->angleturn != from->angleturn)
+	{
+		*mask |= TICDELTA_ANGLE;
+		p = D_WriteZigzag(p, from->angleturn, to->angleturn);
+	}
+	if (to->aiming != from->aiming)
+	{
+		*mask |= TICDELTA_AIMING;
+		p = D_WriteZigzag(p, from->aiming, to->aiming);
+	}
+	if (to->buttons != from->buttons)
+	{
+		*mask |= TICDELTA_BUTTONS;
+		p = D_WriteVarint(p, to->buttons ^ from->buttons);
+	}
+	if (to->driftturn != from->driftturn)
+	{
+		*mask |= TICDELTA_DRIFTTURN;
+		p = D_WriteZigzag(p, from->driftturn, to->driftturn);
+	}
+	if (to->latency != from->latency)
+	{
+		*mask |= TICDELTA_LATENCY;
+		WRITEUINT8(p, to->latency);
+	}
+
+	return p;
+}
+
+static boolean D_ReadTiccmdDelta(UINT8 **p, const UINT8 *end, const ticcmd_t *from, ticcmd_t *to)
+{
+	UINT8 mask;
+	INT32 v;
+
+	if (*p >= end)
+		return false;
+	mask = *(*p)++;
+	*to = *from;
+
+	if (mask & TICDELTA_FORWARD)
+	{
+		if (*p >= end)
+			return false;
+		to->forwardmove = (SINT8)*(*p)++;
+	}
+	if (mask & TICDELTA_SIDE)
+	{
+		if (*p >= end)
+			return false;
+		to->sidemove = (SINT8)*(*p)++;
+	}
+	if (mask & TICDELTA_ANGLE)
+	{
+		if ((v = D_ReadVarint(p, end)) < 0)
+			return false;
+		to->angleturn = D_Unzigzag(from->angleturn, v);
+	}
+	if (mask & TICDELTA_AIMING)
+	{
+		if ((v = D_ReadVarint(p, end)) < 0)
+			return false;
+		to->aiming = D_Unzigzag(from->aiming, v);
+	}
+	if (mask & TICDELTA_BUTTONS)
+	{
+		if ((v = D_ReadVarint(p, end)) < 0)
+			return false;
+		to->buttons = (UINT16)(from->buttons ^ v);
+	}
+	if (mask & TICDELTA_DRIFTTURN)
+	{
+		if ((v = D_ReadVarint(p, end)) < 0)
+			return false;
+		to->driftturn = D_Unzigzag(from->driftturn, v);
+	}
+	if (mask & TICDELTA_LATENCY)
+	{
+		if (*p >= end)
+			return false;
+		to->latency = *(*p)++;
+	}
+
+	return true;
+}
+
+// Remembers what was sent to a node for tic, as a base for later packets
+static void SV_RecordDeltaBase(INT32 node, tic_t tic, INT32 numslots)
+{
+	ticdeltabase_t *base = &ticdeltasent[node][tic % TICDELTAHISTORY];
+	ticcmd_t cmds[MAXPLAYERS];
+
+	memset(cmds, 0, sizeof (cmds));
+	M_Memcpy(cmds, netcmds[tic%TICQUEUE], numslots * sizeof (ticcmd_t));
+
+	if (base->tic != tic)
+	{
+		base->tic = tic;
+		base->valid = true;
+		M_Memcpy(base->cmds, cmds, sizeof (cmds));
+	}
+	else if (base->valid && memcmp(base->cmds, cmds, sizeof (cmds)))
+		base->valid = false; // The client may hold either version
+}
+
+// The base for a packet starting at firsttic is the newest tic the node
+// has acknowledged, if what was sent for it is still known.
+// Returns NULL for a zeroed base.
+static const ticcmd_t *SV_GetDeltaBase(INT32 node, tic_t firsttic, UINT8 *distance)
+{
+	const tic_t basetic = nettics[node] - 1;
+	const ticdeltabase_t *base;
+
+	*distance = 0;
+	if (!nettics[node] || basetic >= firsttic || firsttic - basetic > BACKUPTICS)
+		return NULL;
+
+	base = &ticdeltasent[node][basetic % TICDELTAHISTORY];
+	if (!base->valid || base->tic != basetic)
+		return NULL;
+
+	*distance = (UINT8)(firsttic - basetic);
+	return base->cmds;
+}
+
+// Delta-encodes tics firsttic..lasttic-1 into ticdeltabuf, against the
+// base the node has acknowledged unless zerobase is set.
+// Returns the encoded length.
+static size_t SV_WriteDeltaTics(INT32 node, tic_t firsttic, tic_t lasttic, INT32 numslots, boolean zerobase)
+{
+	UINT8 *p = ticdeltabuf;
+	UINT8 distance = 0;
+	const ticcmd_t *base = zerobase ? NULL : SV_GetDeltaBase(node, firsttic, &distance);
+	tic_t i;
+	INT32 j;
+
+	WRITEUINT8(p, distance);
+	for (i = firsttic; i < lasttic; i++)
+		for (j = 0; j < numslots; j++)
+			p = D_WriteTiccmdDelta(p,
+				i != firsttic ? &netcmds[(i-1)%TICQUEUE][j] : base ? &base[j] : &ticdeltazero,
+				&netcmds[i%TICQUEUE][j]);
+
+	return p - ticdeltabuf;
+}
+
+// Decodes numtics*numslots cmds starting at firsttic into ticdeltacmds.
+// Returns where the textcmds start, or NULL if the packet is malformed
+// or its base tic is no longer known.
+static UINT8 *CL_ReadDeltaTics(UINT8 *p, const UINT8 *end, tic_t firsttic, UINT8 numtics, UINT8 numslots)
+{
+	const ticcmd_t *from, *base = NULL;
+	UINT8 distance;
+	INT32 i, j;
+
+	if (numtics > BACKUPTICS || numslots > MAXPLAYERS || p >= end)
+		return NULL;
+
+	distance = READUINT8(p);
+	if (distance)
+	{
+		const tic_t basetic = firsttic - distance;
+		const ticdeltabase_t *received = &ticdeltareceived[basetic % TICDELTAHISTORY];
+
+		if (!received->valid || received->tic != basetic)
+		{
+			DEBFILE(va("delta base %u for tic %u is gone\n", basetic, firsttic));
+			return NULL;
+		}
+		base = received->cmds;
+	}
+
+	for (i = 0; i < numtics; i++)
+		for (j = 0; j < numslots; j++)
+		{
+			from = i ? &ticdeltacmds[(i-1)*numslots + j] : base ? &base[j] : &ticdeltazero;
+			if (!D_ReadTiccmdDelta(&p, end, from, &ticdeltacmds[i*numslots + j]))
+				return NULL;
+		}
+
+	return p;
+}
+
+// Remembers an accepted tic, as a base the server may delta against
+static void CL_RecordDeltaBase(tic_t tic, UINT8 numslots)
+{
+	ticdeltabase_t *received = &ticdeltareceived[tic % TICDELTAHISTORY];
+
+	received->tic = tic;
+	received->valid = true;
+	memset(received->cmds, 0, sizeof (received->cmds));
+	M_Memcpy(received->cmds, netcmds[tic%TICQUEUE], numslots * sizeof (ticcmd_t));
+}
+#endif
+
 
 // Some software don't support largest packet
 // (original sersetup, not exactely, but the probability of sending a packet
@@ -348,6 +695,104 @@ UINT8 GetFreeXCmdSize(void)
 	return (UINT8)(localtextcmd[0] - 2);
 }
 
+#ifdef PARANOIA
+// A pool may only run dry when every entry it owns is in use; any fewer
+// in the textcmd lists means some were dropped instead of given back.
+static void D_CheckTextcmdPool(void)
+{
+	UINT32 ticsinuse = 0, playersinuse = 0;
+	INT32 i, j;
+
+	for (i = 0; i < TEXTCMD_HASH_SIZE; i++)
+	{
+		const textcmdtic_t *textcmdtic;
+
+		for (textcmdtic = textcmds[i]; textcmdtic; textcmdtic = textcmdtic->next)
+		{
+			ticsinuse++;
+			for (j = 0; j < TEXTCMD_HASH_SIZE; j++)
+			{
+				const textcmdplayer_t *textcmdplayer;
+
+				for (textcmdplayer = textcmdtic->playercmds[j]; textcmdplayer; textcmdplayer = textcmdplayer->next)
+					playersinuse++;
+			}
+		}
+	}
+
+	if ((!freetextcmdtics && ticsinuse != textcmdticsowned)
+		|| (!freetextcmdplayers && playersinuse != textcmdplayersowned))
+		I_Error("Textcmd pool leaked: %u of %u tic entries and %u of %u player entries in use",
+			ticsinuse, textcmdticsowned, playersinuse, textcmdplayersowned);
+}
+#endif
+
+// Takes a cleared tic entry from the pool, allocating one if it is empty
+static textcmdtic_t *D_AllocTextcmdTic(void)
+{
+	textcmdtic_t *textcmdtic = freetextcmdtics;
+
+	if (textcmdtic)
+	{
+		freetextcmdtics = textcmdtic->next;
+		memset(textcmdtic, 0, sizeof (textcmdtic_t));
+	}
+	else
+	{
+#ifdef PARANOIA
+		D_CheckTextcmdPool();
+#endif
+		textcmdtic = Z_Calloc(sizeof (textcmdtic_t), PU_STATIC, NULL);
+		textcmdticsowned++;
+		textcmdallocs++;
+	}
+
+	return textcmdtic;
+}
+
+// Takes a cleared player entry from the pool, allocating one if it is empty
+static textcmdplayer_t *D_AllocTextcmdPlayer(void)
+{
+	textcmdplayer_t *textcmdplayer = freetextcmdplayers;
+
+	if (textcmdplayer)
+	{
+		freetextcmdplayers = textcmdplayer->next;
+		textcmdplayer->next = NULL;
+		textcmdplayer->cmd[0] = 0; // the buffer is only read up to its length byte
+	}
+	else
+	{
+#ifdef PARANOIA
+		D_CheckTextcmdPool();
+#endif
+		textcmdplayer = Z_Calloc(sizeof (textcmdplayer_t), PU_STATIC, NULL);
+		textcmdplayersowned++;
+		textcmdallocs++;
+	}
+
+	return textcmdplayer;
+}
+
+// Fills the pools up front, so the first netxcmds of a game don't allocate
+static void D_PreallocTextcmds(void)
+{
+	INT32 i;
+
+	for (i = 0; i < TEXTCMD_PREALLOC; i++)
+	{
+		textcmdtic_t *textcmdtic = Z_Calloc(sizeof (textcmdtic_t), PU_STATIC, NULL);
+		textcmdplayer_t *textcmdplayer = Z_Calloc(sizeof (textcmdplayer_t), PU_STATIC, NULL);
+
+		textcmdtic->next = freetextcmdtics;
+		freetextcmdtics = textcmdtic;
+		textcmdplayer->next = freetextcmdplayers;
+		freetextcmdplayers = textcmdplayer;
+	}
+	textcmdticsowned += TEXTCMD_PREALLOC;
+	textcmdplayersowned += TEXTCMD_PREALLOC;
+}
+
 // Frees all textcmd memory for the specified tic
 static void D_FreeTextcmd(tic_t tic)
 {
@@ -375,13 +820,15 @@ static void D_FreeTextcmd(tic_t tic)
 			while (textcmdplayer)
 			{
 				textcmdplayer_t *tcpnext = textcmdplayer->next;
-				Z_Free(textcmdplayer);
+				textcmdplayer->next = freetextcmdplayers;
+				freetextcmdplayers = textcmdplayer;
 				textcmdplayer = tcpnext;
 			}
 		}
 
-		// Free this tic's own memory.
-		Z_Free(textcmdtic);
+		// Give this tic's own memory back to the pool.
+		textcmdtic->next = freetextcmdtics;
+		freetextcmdtics = textcmdtic;
 	}
 }
 
@@ -420,7 +867,7 @@ static UINT8* D_GetTextcmd(tic_t tic, INT32 playernum)
 	// If we don't have an entry for the tic, make it.
 	if (!textcmdtic)
 	{
-		textcmdtic = *tctprev = Z_Calloc(sizeof (textcmdtic_t), PU_STATIC, NULL);
+		textcmdtic = *tctprev = D_AllocTextcmdTic();
 		textcmdtic->tic = tic;
 	}
 
@@ -437,7 +884,7 @@ static UINT8* D_GetTextcmd(tic_t tic, INT32 playernum)
 	// If we don't have an entry for the player, make it.
 	if (!textcmdplayer)
 	{
-		textcmdplayer = *tcpprev = Z_Calloc(sizeof (textcmdplayer_t), PU_STATIC, NULL);
+		textcmdplayer = *tcpprev = D_AllocTextcmdPlayer();
 		textcmdplayer->playernum = playernum;
 	}
 
@@ -490,7 +937,8 @@ static void ExtraDataTicker(void)
 	// If you are a client, you can safely forget the net commands for this tic
 	// If you are the server, you need to remember them until every client has been aknowledged,
 	// because if you need to resend a PT_SERVERTICS packet, you need to put the commands in it
-	if (client)
+	// A relay resends them to its viewers, so it forgets them in RL_SendTics instead
+	if (client && !relay)
 		D_FreeTextcmd(gametic);
 }
 
@@ -896,7 +1344,7 @@ static inline void resynch_write_ctf(resynchend_pak *rst)
 	}
 }
 
-static inline void resynch_read_ctf(resynchend_pak *p)
+static void resynch_read_ctf(resynchend_pak *p)
 {
 	UINT8 i;
 
@@ -1331,13 +1779,38 @@ static inline void CL_DrawConnectionStatus(void)
 			static char tempname[28];
 			fileneeded_t *file = &fileneeded[lastfilenum];
 			char *filename = file->filename;
+			UINT32 currentsize = file->currentsize;
+			UINT32 totalsize = file->totalsize;
+			UINT32 bps;
+			INT32 active = 1;
 
 			// Draw the bottom box.
 			M_DrawTextBox(BASEVIDWIDTH/2-128-8, BASEVIDHEIGHT-58-8, 32, 1);
 			V_DrawCenteredString(BASEVIDWIDTH/2, BASEVIDHEIGHT-58-14, V_YELLOWMAP, "Press ESC to abort");
 
 			Net_GetNetStat();
-			dldlength = (INT32)((file->currentsize/(double)file->totalsize) * 256);
+			bps = getbps;
+#ifdef HAVE_CURL
+			if (cl_mode == CL_DOWNLOADHTTPFILES)
+			{
+				// Show every file being downloaded at once as one
+				INT32 i;
+
+				active = 0;
+				currentsize = totalsize = 0;
+				for (i = 0; i < fileneedednum; i++)
+				{
+					if (fileneeded[i].status != FS_DOWNLOADING)
+						continue;
+					if (!active++)
+						filename = fileneeded[i].filename;
+					currentsize += fileneeded[i].currentsize;
+					totalsize += fileneeded[i].totalsize;
+				}
+				bps = curl_getbps;
+			}
+#endif
+			dldlength = totalsize ? (INT32)((currentsize/(double)totalsize) * 256) : 0;
 			if (dldlength > 256)
 				dldlength = 256;
 			V_DrawFill(BASEVIDWIDTH/2-128, BASEVIDHEIGHT-58, 256, 8, 175);
@@ -1347,7 +1820,9 @@ static inline void CL_DrawConnectionStatus(void)
 			// offset filename to just the name only part
 			filename += strlen(filename) - nameonlylength(filename);
 
-			if (strlen(filename) > sizeof(tempname)-1) // too long to display fully
+			if (active > 1)
+				snprintf(tempname, sizeof(tempname), "%d files", active);
+			else if (strlen(filename) > sizeof(tempname)-1) // too long to display fully
 			{
 				size_t endhalfpos = strlen(filename)-10;
 				// display as first 14 chars + ... + last 10 chars
@@ -1368,14 +1843,14 @@ static inline void CL_DrawConnectionStatus(void)
 			V_DrawCenteredString(BASEVIDWIDTH/2, BASEVIDHEIGHT-58-22, V_YELLOWMAP,
 				va(M_GetText("\"%s\""), tempname));
 			V_DrawString(BASEVIDWIDTH/2-128, BASEVIDHEIGHT-58, V_20TRANS|V_MONOSPACE,
-				va(" %4uK/%4uK",fileneeded[lastfilenum].currentsize>>10,file->totalsize>>10));
+				va(" %4uK/%4uK",currentsize>>10,totalsize>>10));
 			V_DrawRightAlignedString(BASEVIDWIDTH/2+128, BASEVIDHEIGHT-58, V_20TRANS|V_MONOSPACE,
-				va("%3.1fK/s ", ((double)getbps)/1024));
+				va("%3.1fK/s ", ((double)bps)/1024));
 
 			// Download progress
 
-			if (fileneeded[lastfilenum].currentsize != fileneeded[lastfilenum].totalsize)
-				totaldldsize = downloadcompletedsize+fileneeded[lastfilenum].currentsize; //Add in single file progress download if applicable
+			if (active > 1 || currentsize != totalsize)
+				totaldldsize = downloadcompletedsize+currentsize; //Add in single file progress download if applicable
 			else
 				totaldldsize = downloadcompletedsize;
 
@@ -1440,7 +1915,9 @@ static boolean CL_SendJoin(void)
 		CONS_Printf(M_GetText("Sending join request...\n"));
 	netbuffer->packettype = PT_CLIENTJOIN;
 
-	if (splitscreen)
+	if (viewonly)
+		localplayers = 0; // Just watching, see SV_AddViewer
+	else if (splitscreen)
 		localplayers += splitscreen;
 	else if (botingame)
 		localplayers++;
@@ -1455,6 +1932,11 @@ static boolean CL_SendJoin(void)
 #ifdef SATURNJOIN
 	netbuffer->u.clientcfg.issaturn = ISSATURN;
 #endif
+	netbuffer->u.clientcfg.compression = NETCOMPRESS_SUPPORTED;
+#ifdef SATURNSYNCH
+	netbuffer->u.clientcfg.ticdelta = TICDELTA_VERSION;
+#endif
+	netbuffer->u.clientcfg.viewer = (UINT8)viewonly;
 
 	return HSendPacket(servernode, false, 0, sizeof (clientconfig_pak));
 }
@@ -1724,7 +2206,9 @@ static boolean SV_SendServerConfig(INT32 node)
 	netbuffer->u.servercfg.serverplayer = (UINT8)serverplayer;
 	netbuffer->u.servercfg.totalslotnum = (UINT8)(doomcom->numslots);
 	netbuffer->u.servercfg.gametic = (tic_t)LONG(gametic);
-	netbuffer->u.servercfg.clientnode = (UINT8)node;
+	// Nodes without a player get a node number no XD_ADDPLAYER will ever use,
+	// since on a relay it means nothing to the real server
+	netbuffer->u.servercfg.clientnode = (UINT8)(nodeisviewer[node] ? UINT8_MAX : node);
 	netbuffer->u.servercfg.gamestate = (UINT8)gamestate;
 	netbuffer->u.servercfg.gametype = (UINT8)gametype;
 	netbuffer->u.servercfg.modifiedgame = (UINT8)modifiedgame;
@@ -1802,73 +2286,440 @@ static boolean SV_ResendingSavegameToAnyone(void)
 }
 #endif
 
-static void SV_SendSaveGame(INT32 node, boolean resending)
+// The gamestate sent to joiners is serialized and compressed at most once
+// per tic. Everyone asking for it on that tic is sent the same shared
+// buffer; the cache holds one reference of its own until the tic is over.
+// The decompressed length in the header has this set for deflate.
+#define SAVEGAME_DEFLATE 0x80000000
+
+static struct
 {
-	size_t length, compressedlen;
-	UINT8 *savebuffer;
-	UINT8 *compressedsave;
-	UINT8 *buffertosend;
+	UINT8 *data[NETCOMPRESS_DEFLATE+1]; // SF_SHARED_RAM, for each compression method as needed
+	size_t length[NETCOMPRESS_DEFLATE+1];
+	UINT8 *raw; // SF_SHARED_RAM, uncompressed and without the length header
+	size_t rawlength;
+#ifdef SATURNSYNCH
+	UINT32 rawsum; // For delta resends
+#endif
+	tic_t tic;
+	gamestate_t gamestate;
+	boolean resending;
+} savegamecache;
 
-	// first save it in a malloced buffer
-	savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
-	if (!savebuffer)
+static void SV_ReleaseSaveGameCache(void)
+{
+	INT32 i;
+
+	for (i = 0; i <= NETCOMPRESS_DEFLATE; i++)
 	{
-		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
-		return;
+		if (savegamecache.data[i])
+			SV_ReleaseSharedRam(savegamecache.data[i]);
+		savegamecache.data[i] = NULL;
 	}
+	if (savegamecache.raw)
+		SV_ReleaseSharedRam(savegamecache.raw);
+	savegamecache.raw = NULL;
+}
 
-	// Leave room for the uncompressed length.
-	save_p = savebuffer + sizeof(UINT32);
+#ifdef SATURNSYNCH
+// Gamestate resends are sent as a delta against the last gamestate the
+// client loaded when both sides still have it. The delta replaces the
+// decompressed length in the header with GAMESTATEDELTA, then carries the
+// checksum of the base, the length of the result and the (maybe compressed)
+// length of the delta itself, followed by a list of copy and literal runs.
+#define GAMESTATEDELTA 0xFFFFFFFF
+#define GAMESTATEDELTAHEADER (4*sizeof (UINT32))
+#define DELTA_LITERAL 0 // UINT32 length, then the bytes
+#define DELTA_COPY 1 // UINT32 offset into the base, UINT32 length
+#define DELTAMINMATCH 16
+#define DELTAHASHBITS 16
+
+static UINT8 *gamestatebase[MAXNETNODES]; // SF_SHARED_RAM, last gamestate sent to each node
+static size_t gamestatebaselength[MAXNETNODES];
+static UINT32 gamestatebasesum[MAXNETNODES];
+static UINT32 clientgamestatebase[MAXNETNODES]; // Checksum of what the node says it has loaded
+
+// The client's side of the above
+static UINT8 *cl_gamestatebase = NULL;
+static size_t cl_gamestatebaselength;
+static UINT32 cl_gamestatebasesum;
+
+static UINT32 GamestateChecksum(const UINT8 *data, size_t length)
+{
+	UINT32 sum = 0x811C9DC5 ^ (UINT32)length;
+
+	while (length--)
+		sum = (sum ^ *data++) * 0x01000193;
+	return sum ? sum : 1; // 0 means "no gamestate"
+}
 
-	P_SaveNetGame(resending);
+static void SV_ClearGamestateBase(INT32 node)
+{
+	if (gamestatebase[node])
+		SV_ReleaseSharedRam(gamestatebase[node]);
+	gamestatebase[node] = NULL;
+	clientgamestatebase[node] = 0;
+}
 
-	length = save_p - savebuffer;
-	if (length > SAVEGAMESIZE)
-	{
-		free(savebuffer);
-		save_p = NULL;
-		I_Error("Savegame buffer overrun");
-	}
+static void CL_ClearGamestateBase(void)
+{
+	if (cl_gamestatebase)
+		Z_Free(cl_gamestatebase);
+	cl_gamestatebase = NULL;
+	cl_gamestatebasesum = 0;
+}
 
-	// Allocate space for compressed save: one byte fewer than for the
-	// uncompressed data to ensure that the compression is worthwhile.
-	compressedsave = malloc(length - 1);
-	if (!compressedsave)
-	{
-		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
-		return;
-	}
+static inline UINT32 DeltaHash(const UINT8 *p)
+{
+	UINT32 h = 0x811C9DC5;
+	INT32 i;
 
-	// Attempt to compress it.
-	if((compressedlen = lzf_compress(savebuffer + sizeof(UINT32), length - sizeof(UINT32), compressedsave + sizeof(UINT32), length - sizeof(UINT32) - 1)))
-	{
-		// Compressing succeeded; send compressed data
+	for (i = 0; i < DELTAMINMATCH; i++)
+		h = (h ^ p[i]) * 0x01000193;
+	return (h ^ (h >> DELTAHASHBITS)) & ((1<<DELTAHASHBITS) - 1);
+}
 
-		free(savebuffer);
+static boolean DeltaWriteLiteral(UINT8 **p, const UINT8 *end, const UINT8 *literal, size_t length)
+{
+	UINT8 *q = *p;
 
-		// State that we're compressed.
-		buffertosend = compressedsave;
-		WRITEUINT32(compressedsave, length - sizeof(UINT32));
-		length = compressedlen + sizeof(UINT32);
-	}
-	else
-	{
-		// Compression failed to make it smaller; send original
+	if (!length)
+		return true;
+	if ((size_t)(end - q) < 1 + sizeof (UINT32) + length)
+		return false;
+	WRITEUINT8(q, DELTA_LITERAL);
+	WRITEUINT32(q, (UINT32)length);
+	M_Memcpy(q, literal, length);
+	*p = q + length;
+	return true;
+}
 
-		free(compressedsave);
+/** Encodes target as copy and literal runs against base
+  *
+  * \return Length of the delta, or 0 if it didn't fit in outsize
+  *
+  */
+static size_t SV_EncodeGamestateDelta(const UINT8 *base, size_t baselength,
+	const UINT8 *target, size_t targetlength, UINT8 *out, size_t outsize)
+{
+	INT32 *table;
+	UINT8 *p = out;
+	const UINT8 *end = out + outsize;
+	size_t pos = 0, literal = 0, i;
 
-		// State that we're not compressed
-		buffertosend = savebuffer;
-		WRITEUINT32(savebuffer, 0);
-	}
+	table = malloc(sizeof (INT32) << DELTAHASHBITS);
+	if (!table)
+		return 0;
+	gamestateallocs++;
+	memset(table, 0xFF, sizeof (INT32) << DELTAHASHBITS);
 
-	SV_SendRam(node, buffertosend, length, SF_RAM, 0);
-	save_p = NULL;
+	// Index the base in aligned blocks; matches are found at any offset
+	// in the target and grown in both directions from there.
+	for (i = 0; i + DELTAMINMATCH <= baselength; i += DELTAMINMATCH)
+		table[DeltaHash(base + i)] = (INT32)i;
 
-	// Remember when we started sending the savegame so we can handle timeouts
-	sendingsavegame[node] = true;
-	freezetimeout[node] = I_GetTime() + jointimeout + length / 1024; // 1 extra tic for each kilobyte
-}
+	while (pos + DELTAMINMATCH <= targetlength)
+	{
+		INT32 candidate = table[DeltaHash(target + pos)];
+		size_t offset, length;
+
+		if (candidate < 0 || memcmp(base + candidate, target + pos, DELTAMINMATCH))
+		{
+			pos++;
+			continue;
+		}
+
+		offset = (size_t)candidate;
+		length = DELTAMINMATCH;
+		while (offset + length < baselength && pos + length < targetlength
+			&& base[offset + length] == target[pos + length])
+			length++;
+		while (offset > 0 && pos > literal && base[offset - 1] == target[pos - 1])
+		{
+			offset--;
+			pos--;
+			length++;
+		}
+
+		if (!DeltaWriteLiteral(&p, end, target + literal, pos - literal)
+			|| (size_t)(end - p) < 1 + 2*sizeof (UINT32))
+		{
+			free(table);
+			return 0;
+		}
+		WRITEUINT8(p, DELTA_COPY);
+		WRITEUINT32(p, (UINT32)offset);
+		WRITEUINT32(p, (UINT32)length);
+
+		pos += length;
+		literal = pos;
+	}
+
+	free(table);
+
+	if (!DeltaWriteLiteral(&p, end, target + literal, targetlength - literal))
+		return 0;
+	return p - out;
+}
+
+/** Rebuilds a gamestate from a delta against base
+  *
+  * \return false if the delta doesn't describe exactly outlength bytes
+  *
+  */
+static boolean CL_ApplyGamestateDelta(const UINT8 *base, size_t baselength,
+	UINT8 *delta, size_t deltalength, UINT8 *out, size_t outlength)
+{
+	UINT8 *p = delta;
+	const UINT8 *end = delta + deltalength;
+	size_t pos = 0;
+
+	while (p < end)
+	{
+		UINT8 op = READUINT8(p);
+
+		if (op == DELTA_LITERAL && (size_t)(end - p) >= sizeof (UINT32))
+		{
+			size_t length = READUINT32(p);
+
+			if (length > (size_t)(end - p) || length > outlength - pos)
+				return false;
+			M_Memcpy(out + pos, p, length);
+			p += length;
+			pos += length;
+		}
+		else if (op == DELTA_COPY && (size_t)(end - p) >= 2*sizeof (UINT32))
+		{
+			size_t offset = READUINT32(p);
+			size_t length = READUINT32(p);
+
+			if (offset > baselength || length > baselength - offset || length > outlength - pos)
+				return false;
+			M_Memcpy(out + pos, base + offset, length);
+			pos += length;
+		}
+		else
+			return false;
+	}
+
+	return pos == outlength;
+}
+
+/** Sends a node the cached gamestate as a delta against its last one
+  *
+  * \return Bytes queued, or 0 if the node should get the full gamestate
+  *
+  */
+static size_t SV_SendGamestateDelta(INT32 node, size_t fulllength)
+{
+	UINT8 *delta, *buffertosend, *p;
+	size_t deltalength, compressedlen, length;
+
+	if (!gamestatebase[node] || !clientgamestatebase[node]
+		|| clientgamestatebase[node] != gamestatebasesum[node])
+		return 0;
+
+	// Anything not smaller than the full compressed gamestate is useless
+	if (fulllength <= GAMESTATEDELTAHEADER + 1)
+		return 0;
+	length = fulllength - GAMESTATEDELTAHEADER - 1;
+
+	delta = malloc(length);
+	if (!delta)
+		return 0;
+	gamestateallocs++;
+	deltalength = SV_EncodeGamestateDelta(gamestatebase[node], gamestatebaselength[node],
+		savegamecache.raw, savegamecache.rawlength, delta, length);
+	if (!deltalength)
+	{
+		free(delta);
+		return 0;
+	}
+
+	buffertosend = malloc(GAMESTATEDELTAHEADER + deltalength);
+	if (!buffertosend)
+	{
+		free(delta);
+		return 0;
+	}
+	gamestateallocs++;
+
+	p = buffertosend;
+	WRITEUINT32(p, GAMESTATEDELTA);
+	WRITEUINT32(p, gamestatebasesum[node]);
+	WRITEUINT32(p, (UINT32)savegamecache.rawlength);
+	if (deltalength > 1 && (compressedlen = lzf_compress(delta, deltalength, p + sizeof (UINT32), deltalength - 1)))
+	{
+		WRITEUINT32(p, (UINT32)deltalength);
+		length = GAMESTATEDELTAHEADER + compressedlen;
+	}
+	else
+	{
+		WRITEUINT32(p, 0);
+		M_Memcpy(p, delta, deltalength);
+		length = GAMESTATEDELTAHEADER + deltalength;
+	}
+	free(delta);
+
+	DEBFILE(va("Sending node %d a gamestate delta of %s bytes instead of %s\n",
+		node, sizeu1(length), sizeu2(fulllength)));
+	SV_SendRam(node, buffertosend, length, SF_RAM, 0);
+	return length;
+}
+
+/** Remembers the cached gamestate as what a node will have loaded next
+  */
+static void SV_SetGamestateBase(INT32 node)
+{
+	SV_ClearGamestateBase(node);
+	gamestatebase[node] = SV_RetainSharedRam(savegamecache.raw);
+	gamestatebaselength[node] = savegamecache.rawlength;
+	gamestatebasesum[node] = savegamecache.rawsum;
+}
+#endif
+
+static boolean SV_CacheSaveGame(boolean resending)
+{
+	size_t length;
+	UINT8 *savebuffer;
+	UINT8 *raw;
+
+	// first save it in a malloced buffer
+	savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
+	if (!savebuffer)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
+		return false;
+	}
+	gamestateallocs++;
+
+	save_p = savebuffer;
+
+	P_SaveNetGame(resending);
+
+	length = save_p - savebuffer;
+	save_p = NULL;
+	if (length > SAVEGAMESIZE)
+	{
+		free(savebuffer);
+		I_Error("Savegame buffer overrun");
+	}
+
+	// Keep the plain gamestate around to compress for each method
+	// and to build deltas from
+	raw = SV_AllocSharedRam(length);
+	if (!raw)
+	{
+		free(savebuffer);
+		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
+		return false;
+	}
+	gamestateallocs++;
+	M_Memcpy(raw, savebuffer, length);
+	free(savebuffer);
+
+	savegamecache.raw = raw;
+	savegamecache.rawlength = length;
+#ifdef SATURNSYNCH
+	savegamecache.rawsum = GamestateChecksum(raw, length);
+#endif
+	savegamecache.tic = gametic;
+	savegamecache.gamestate = gamestate;
+	savegamecache.resending = resending;
+	return true;
+}
+
+static boolean SV_CompressSaveGame(UINT8 method)
+{
+	size_t length = savegamecache.rawlength + sizeof(UINT32);
+	size_t compressedlen;
+	UINT8 *buffertosend;
+	UINT8 *p;
+
+	// Allocate space for compressed save: one byte fewer than for the
+	// uncompressed data to ensure that the compression is worthwhile.
+	buffertosend = SV_AllocSharedRam(length - 1);
+	if (!buffertosend)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
+		return false;
+	}
+	gamestateallocs++;
+
+	// Attempt to compress it.
+	p = buffertosend;
+	if((compressedlen = Net_Compress(method, savegamecache.raw, savegamecache.rawlength, buffertosend + sizeof(UINT32), savegamecache.rawlength - 1)))
+	{
+		// Compressing succeeded; send compressed data
+		// State that we're compressed, and how.
+		if (method == NETCOMPRESS_DEFLATE)
+			WRITEUINT32(p, savegamecache.rawlength | SAVEGAME_DEFLATE);
+		else
+			WRITEUINT32(p, savegamecache.rawlength);
+		Net_CountCompression(method, length, compressedlen + sizeof(UINT32), true);
+		length = compressedlen + sizeof(UINT32);
+	}
+	else
+	{
+		// Compression failed to make it smaller; send original
+		SV_ReleaseSharedRam(buffertosend);
+		buffertosend = SV_AllocSharedRam(length);
+		if (!buffertosend)
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
+			return false;
+		}
+		gamestateallocs++;
+
+		// State that we're not compressed
+		p = buffertosend;
+		WRITEUINT32(p, 0);
+		M_Memcpy(p, savegamecache.raw, savegamecache.rawlength);
+	}
+
+	savegamecache.data[method] = buffertosend;
+	savegamecache.length[method] = length;
+	return true;
+}
+
+static void SV_SendSaveGame(INT32 node, boolean resending)
+{
+	size_t length = 0;
+	UINT8 method = SV_PickCompression(node);
+
+	if (method == NETCOMPRESS_NONE)
+		method = NETCOMPRESS_LZF; // Every client can take these
+
+	if (!savegamecache.raw || savegamecache.tic != gametic
+		|| savegamecache.gamestate != gamestate || savegamecache.resending != resending)
+	{
+		SV_ReleaseSaveGameCache();
+		if (!SV_CacheSaveGame(resending))
+			return;
+	}
+	else
+		DEBFILE(va("Reusing gamestate from tic %u for node %d\n", savegamecache.tic, node));
+
+	if (!savegamecache.data[method] && !SV_CompressSaveGame(method))
+		return;
+
+#ifdef SATURNSYNCH
+	if (resending)
+		length = SV_SendGamestateDelta(node, savegamecache.length[method]);
+#endif
+	if (!length)
+	{
+		SV_SendRam(node, savegamecache.data[method], savegamecache.length[method], SF_SHARED_RAM, 0);
+		length = savegamecache.length[method];
+	}
+#ifdef SATURNSYNCH
+	SV_SetGamestateBase(node);
+#endif
+
+	// Remember when we started sending the savegame so we can handle timeouts
+	sendingsavegame[node] = true;
+	freezetimeout[node] = I_GetTime() + jointimeout + length / 1024; // 1 extra tic for each kilobyte
+}
 
 #ifdef DUMPCONSISTENCY
 #define TMPSAVENAME "badmath.sav"
@@ -1936,13 +2787,65 @@ static void CL_LoadReceivedSavegame(boolean reloading)
 
 	// Decompress saved game if necessary.
 	decompressedlen = READUINT32(save_p);
+#ifdef SATURNSYNCH
+	if (decompressedlen == GAMESTATEDELTA)
+	{
+		UINT32 basesum, deltalen;
+		UINT8 *delta, *decompressedbuffer;
+
+		if (length < GAMESTATEDELTAHEADER)
+			I_Error("Can't read savegame sent");
+		basesum = READUINT32(save_p);
+		decompressedlen = READUINT32(save_p);
+		deltalen = READUINT32(save_p);
+
+		// The server only sends these for the base we told it we have
+		if (!cl_gamestatebase || basesum != cl_gamestatebasesum)
+			I_Error("Received a gamestate delta for a gamestate we don't have");
+
+		delta = save_p;
+		if (deltalen > 0)
+		{
+			delta = Z_Malloc(deltalen, PU_STATIC, NULL);
+			if (lzf_decompress(save_p, length - GAMESTATEDELTAHEADER, delta, deltalen) != deltalen)
+				I_Error("Can't read savegame sent");
+		}
+		else
+			deltalen = (UINT32)(length - GAMESTATEDELTAHEADER);
+
+		decompressedbuffer = Z_Malloc(decompressedlen, PU_STATIC, NULL);
+		if (!CL_ApplyGamestateDelta(cl_gamestatebase, cl_gamestatebaselength,
+			delta, deltalen, decompressedbuffer, decompressedlen))
+			I_Error("Can't read savegame sent");
+
+		CONS_Printf(M_GetText("Rebuilt savegame length %s from delta\n"), sizeu1(decompressedlen));
+		if (delta != save_p)
+			Z_Free(delta);
+		Z_Free(savebuffer);
+		save_p = savebuffer = decompressedbuffer;
+	}
+	else
+#endif
 	if(decompressedlen > 0)
 	{
-		UINT8 *decompressedbuffer = Z_Malloc(decompressedlen, PU_STATIC, NULL);
-		lzf_decompress(save_p, length - sizeof(UINT32), decompressedbuffer, decompressedlen);
+		UINT8 method = (decompressedlen & SAVEGAME_DEFLATE) ? NETCOMPRESS_DEFLATE : NETCOMPRESS_LZF;
+		UINT8 *decompressedbuffer;
+
+		decompressedlen &= ~SAVEGAME_DEFLATE;
+		decompressedbuffer = Z_Malloc(decompressedlen, PU_STATIC, NULL);
+		if (!Net_Decompress(method, save_p, length - sizeof(UINT32), decompressedbuffer, decompressedlen))
+			I_Error("Can't read savegame sent");
+		Net_CountCompression(method, decompressedlen + sizeof(UINT32), length, false);
 		Z_Free(savebuffer);
 		save_p = savebuffer = decompressedbuffer;
 	}
+	else
+	{
+		// Keep the gamestate at the start of the buffer
+		decompressedlen = length - sizeof(UINT32);
+		memmove(savebuffer, save_p, decompressedlen);
+		save_p = savebuffer;
+	}
 
 	paused = false;
 	demo.playback = false;
@@ -1970,7 +2873,16 @@ static void CL_LoadReceivedSavegame(boolean reloading)
 	}
 
 	// done
+#ifdef SATURNSYNCH
+	// Hold on to it; the server may send the next one as a delta against it
+	CL_ClearGamestateBase();
+	cl_gamestatebase = savebuffer;
+	cl_gamestatebaselength = decompressedlen;
+	cl_gamestatebasesum = GamestateChecksum(savebuffer, decompressedlen);
+	memset(ticdeltareceived, 0, sizeof (ticdeltareceived)); // Tics from before the gamestate can't be bases
+#else
 	Z_Free(savebuffer);
+#endif
 	save_p = NULL;
 	if (unlink(tmpsave) == -1)
 		CONS_Alert(CONS_ERROR, M_GetText("Can't delete %s\n"), tmpsave);
@@ -2054,17 +2966,31 @@ UINT32 serverlistultimatecount = 0;
 static boolean resendserverlistnode[MAXNETNODES];
 static tic_t serverlistepoch;
 
+// Master server listings are asked over the query socket rather than
+// through nodes: one slot per server, all asked at once, with the
+// replies read back a tic at a time by CL_TimeoutServerList.
+typedef struct
+{
+	char ip[16];
+	char port[8];
+	boolean answered;
+} serverquery_t;
+
+static serverquery_t serverquery[MAXSERVERLIST];
+static INT32 serverquerycount = 0;
+
 static void SL_ClearServerList(INT32 connectedserver)
 {
 	UINT32 i;
 
 	for (i = 0; i < serverlistcount; i++)
-		if (connectedserver != serverlist[i].node)
+		if (connectedserver != serverlist[i].node && serverlist[i].node > 0)
 		{
 			Net_CloseConnection(serverlist[i].node|FORCECLOSE);
 			serverlist[i].node = 0;
 		}
 	serverlistcount = 0;
+	serverquerycount = 0;
 
 	memset(resendserverlistnode, 0, sizeof resendserverlistnode);
 }
@@ -2072,6 +2998,10 @@ static void SL_ClearServerList(INT32 connectedserver)
 static UINT32 SL_SearchServer(INT32 node)
 {
 	UINT32 i;
+
+	if (node < 0)
+		return UINT32_MAX;
+
 	for (i = 0; i < serverlistcount; i++)
 		if (serverlist[i].node == node)
 			return i;
@@ -2079,14 +3009,50 @@ static UINT32 SL_SearchServer(INT32 node)
 	return UINT32_MAX;
 }
 
-static void SL_InsertServer(serverinfo_pak* info, SINT8 node)
+static UINT32 SL_SearchQuery(INT32 query)
 {
 	UINT32 i;
+	for (i = 0; i < serverlistcount; i++)
+		if (serverlist[i].query == query)
+			return i;
+
+	return UINT32_MAX;
+}
 
-	resendserverlistnode[node] = false;
+/** Cleans up a received PT_SERVERINFO for the server list. The ping in
+  * info->time is left to the caller.
+  */
+static void SL_CleanServerInfo(serverinfo_pak *info)
+{
+	char servername[MAXSERVERNAME];
+
+	info->servername[MAXSERVERNAME-1] = 0;
+	info->application[sizeof info->application - 1] = '\0';
+	memcpy(servername, info->servername, MAXSERVERNAME);
+	CopyCaretColors(info->servername, servername, MAXSERVERNAME);
+	info->gametype = (UINT8)((info->gametype == VANILLA_GT_MATCH) ? GT_MATCH : GT_RACE);
+}
+
+/** Adds or updates a server list entry; the caller resorts the list.
+  *
+  * \param info The server's PT_SERVERINFO
+  * \param node The node it answered on, or -1
+  * \param query The query slot it answered on, or -1
+  *
+  */
+static void SL_InsertServer(serverinfo_pak* info, SINT8 node, INT16 query)
+{
+	UINT32 i;
 
 	// search if not already on it
-	i = SL_SearchServer(node);
+	if (query == -1)
+	{
+		resendserverlistnode[node] = false;
+		i = SL_SearchServer(node);
+	}
+	else
+		i = SL_SearchQuery(query);
+
 	if (i == UINT32_MAX)
 	{
 		// not found add it
@@ -2109,13 +3075,52 @@ static void SL_InsertServer(serverinfo_pak* info, SINT8 node)
 			return;/* that's a different mod */
 
 		i = serverlistcount++;
+		serverlist[i].node = node;
+		serverlist[i].query = query;
 	}
 
 	serverlist[i].info = *info;
-	serverlist[i].node = node;
+}
+
+static void SendAskInfoQuery(INT32 slot)
+{
+#ifdef HOLEPUNCH
+	if (I_NetQueryHolePunch && cv_rendezvousserver.string[0])
+		I_NetQueryHolePunch(slot);
+#endif
+
+	netbuffer->packettype = PT_ASKINFO;
+	netbuffer->u.askinfo.version = VERSION;
+	// Servers echo this back, so the reply is timed from the ask it
+	// answers even after a resend. The low 32 bits are plenty for that.
+	netbuffer->u.askinfo.time = (tic_t)LONG((UINT32)I_GetPreciseTime());
+
+	HSendQuery(slot, sizeof (askinfo_pak));
+}
+
+static void SL_ReadQueries(void)
+{
+	boolean inserted = false;
+	UINT32 rtt;
+	INT32 slot;
+
+	while ((slot = HGetQuery()) != -1)
+	{
+		if (slot >= serverquerycount || netbuffer->packettype != PT_SERVERINFO)
+			continue; // a late reply to an older list, or PT_PLAYERINFO
+
+		rtt = (UINT32)I_GetPreciseTime() - (UINT32)LONG(netbuffer->u.serverinfo.time);
+		netbuffer->u.serverinfo.time = (tic_t)LONG((UINT32)((UINT64)rtt * 1000 / I_GetPrecisePrecision()));
+
+		SL_CleanServerInfo(&netbuffer->u.serverinfo);
+		SL_InsertServer(&netbuffer->u.serverinfo, -1, (INT16)slot);
+		serverquery[slot].answered = true;
+		inserted = true;
+	}
 
-	// resort server list
-	M_SortServerList();
+	// Once for everything that came in this tic, not once per server
+	if (inserted)
+		M_SortServerList();
 }
 
 void CL_UpdateServerList (void)
@@ -2144,6 +3149,26 @@ void CL_QueryServerList (msg_server_t *server_list)
 
 	serverlistepoch = I_GetTime();
 
+	if (I_NetQueryAddress)
+	{
+		for (i = 0; server_list[i].header.buffer[0] && serverquerycount < MAXSERVERLIST; i++)
+		{
+			serverquery_t *q = &serverquery[serverquerycount];
+
+			if (!I_NetQueryAddress(serverquerycount, server_list[i].ip, server_list[i].port))
+				continue;
+
+			strlcpy(q->ip, server_list[i].ip, sizeof q->ip);
+			strlcpy(q->port, server_list[i].port, sizeof q->port);
+			q->answered = false;
+
+			SendAskInfoQuery(serverquerycount++);
+		}
+
+		serverlistultimatecount = serverquerycount;
+		return;
+	}
+
 	for (i = 0; server_list[i].header.buffer[0]; i++)
 	{
 		// Make sure MS version matches our own, to
@@ -2169,6 +3194,8 @@ void CL_QueryServerList (msg_server_t *server_list)
 
 void CL_TimeoutServerList(void)
 {
+	SL_ReadQueries();
+
 	if (netgame && serverlistultimatecount > serverlistcount)
 	{
 		const tic_t timediff = I_GetTime() - serverlistepoch;
@@ -2190,6 +3217,15 @@ void CL_TimeoutServerList(void)
 				}
 			}
 
+			if (!timedout)
+			{
+				INT32 slot;
+
+				for (slot = 0; slot < serverquerycount; ++slot)
+					if (!serverquery[slot].answered)
+						SendAskInfoQuery(slot);
+			}
+
 			if (timedout)
 				serverlistultimatecount = serverlistcount;
 		}
@@ -2197,6 +3233,28 @@ void CL_TimeoutServerList(void)
 }
 #endif // ifndef NONET
 
+/** Gets a node to connect to server list entry \a i, making one if it
+  * was found through the query socket.
+  *
+  * \return The node, or -1 if none are free
+  *
+  */
+SINT8 CL_ServerListNode(UINT32 i)
+{
+	if (i >= serverlistcount)
+		return -1;
+
+#ifndef NONET
+	if (serverlist[i].node == -1 && serverlist[i].query != -1 && I_NetMakeNodewPort)
+	{
+		const serverquery_t *q = &serverquery[serverlist[i].query];
+		serverlist[i].node = I_NetMakeNodewPort(q->ip, q->port);
+	}
+#endif
+
+	return serverlist[i].node;
+}
+
 static void CL_ConfirmConnect(void)
 {
 	if (totalfilesrequestednum > 0)
@@ -2530,28 +3588,17 @@ static boolean CL_ServerConnectionTicker(const char *tmpsave, tic_t *oldtic, tic
 		case CL_PREPAREHTTPFILES:
 			if (http_source[0])
 			{
+				// Queue them all, they're downloaded http_downloads at a time
 				for (i = 0; i < fileneedednum; i++)
 					if (fileneeded[i].status == FS_NOTFOUND || fileneeded[i].status == FS_MD5SUMBAD)
-					{
-						curl_transfers++;
-					}
+						CURLPrepareFile(http_source, i);
 
 				cl_mode = CL_DOWNLOADHTTPFILES;
 			}
 			break;
 
 		case CL_DOWNLOADHTTPFILES:
-			waitmore = false;
-			for (i = 0; i < fileneedednum; i++)
-				if (fileneeded[i].status == FS_NOTFOUND || fileneeded[i].status == FS_MD5SUMBAD)
-				{
-					if (!curl_running)
-						CURLPrepareFile(http_source, i);
-					waitmore = true;
-					break;
-				}
-
-			if (waitmore)
+			if (curl_transfers)
 				break; // exit the case
 
 			if (curl_failedwebdownload && !curl_transfers)
@@ -2689,7 +3736,7 @@ static boolean CL_ServerConnectionTicker(const char *tmpsave, tic_t *oldtic, tic
 		*oldtic = I_GetTime();
 
 #ifdef CLIENT_LOADINGSCREEN
-		if (client && cl_mode != CL_CONNECTED && cl_mode != CL_ABORTED)
+		if (client && !dedicated && cl_mode != CL_CONNECTED && cl_mode != CL_ABORTED)
 		{
 			F_TitleScreenTicker(true);
 			F_TitleScreenDrawer();
@@ -3388,6 +4435,11 @@ void CL_Reset(void)
 	serverisfull = false;
 	connectiontimeout = (tic_t)cv_nettimeout.value; //reset this temporary hack
 
+#ifdef SATURNSYNCH
+	cl_ticbatch = 0;
+	cl_cmdsqueued = cl_cmdsunsent = 0;
+#endif
+
 #ifdef HAVE_CURL
 	curl_failedwebdownload = false;
 	curl_transfers = 0;
@@ -4099,6 +5151,9 @@ consvar_t cv_joinrefusemessage = {"joinrefusemessage", "The server is not accept
 
 consvar_t cv_allownewplayer = {"allowjoin", "On", CV_SAVE|CV_CALL, CV_OnOff, Joinable_OnChange, 0, NULL, NULL, 0, 0, NULL};
 
+// Let -relay processes in; each takes a node but no player, however many viewers it has
+consvar_t cv_allowrelays = {"allowrelays", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 #ifdef SATURNJOIN
 consvar_t cv_allownewsaturnplayer = {"allowsaturnjoin", "On", CV_HIDEN, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 #endif
@@ -4123,6 +5178,20 @@ consvar_t cv_gamestateattempts = {"gamestateresendattempts", "10", CV_SAVE, game
 
 static CV_PossibleValue_t resynchcooldown_cons_t[] = {{0, "MIN"}, {20, "MAX"}, {0, NULL}};
 consvar_t cv_resynchcooldown = {"gamestatecooldown", "5", CV_SAVE, resynchcooldown_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL	};
+
+// Hash each part of the game separately every tic, so a synch failure
+// can be narrowed down to what actually differs
+consvar_t cv_consistencyreport = {"consistencyreport", "Off", CV_NETVAR, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+// Have high ping clients bundle several tics per packet, and buffer
+// their cmds for as long as their connection jitters
+consvar_t cv_adaptivetics = {"adaptivetics", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+static CV_PossibleValue_t adaptivetics_maxbatch_cons_t[] = {{1, "MIN"}, {MAXTICBATCH, "MAX"}, {0, NULL}};
+consvar_t cv_adaptivetics_maxbatch = {"adaptivetics_maxbatch", "4", CV_SAVE, adaptivetics_maxbatch_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+static CV_PossibleValue_t adaptivetics_maxlead_cons_t[] = {{0, "MIN"}, {16, "MAX"}, {0, NULL}};
+consvar_t cv_adaptivetics_maxlead = {"adaptivetics_maxlead", "8", CV_SAVE, adaptivetics_maxlead_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 #endif
 
 consvar_t cv_blamecfail = {"blamecfail", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL	};
@@ -4132,13 +5201,33 @@ static CV_PossibleValue_t maxsend_cons_t[] = {{0, "MIN"}, {51200, "MAX"}, {0, NU
 consvar_t cv_maxsend = {"maxsend", "MAX", CV_SAVE, maxsend_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_noticedownload = {"noticedownload", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 
-// Speed of file downloading (in packets per tic)
+// Most file fragments a node may have unacknowledged at once
 static CV_PossibleValue_t downloadspeed_cons_t[] = {{1, "MIN"}, {300, "MAX"}, {0, NULL}};
 consvar_t cv_downloadspeed = {"downloadspeed", "300", CV_SAVE, downloadspeed_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+// How to compress gamestates and files for nodes that can take it
+static CV_PossibleValue_t netcompression_cons_t[] = {
+	{NETCOMPRESS_LZF, "LZF"},
+#ifdef HAVE_ZLIB
+	{NETCOMPRESS_DEFLATE, "Deflate"},
+#endif
+	{0, NULL}};
+#ifdef HAVE_ZLIB
+consvar_t cv_netcompression = {"netcompression", "Deflate", CV_SAVE, netcompression_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+#else
+consvar_t cv_netcompression = {"netcompression", "LZF", CV_SAVE, netcompression_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+#endif
+static CV_PossibleValue_t netcompressionlevel_cons_t[] = {{1, "MIN"}, {9, "MAX"}, {0, NULL}};
+consvar_t cv_netcompressionlevel = {"netcompressionlevel", "6", CV_SAVE, netcompressionlevel_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 static CV_PossibleValue_t connectawaittime_cons_t[] = {{1, "MIN"}, {60, "MAX"}, {0, "Inf"}, {0, NULL}};
 consvar_t cv_connectawaittime = {"connectawaittime", "5", CV_SAVE, connectawaittime_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+// Periodically dump the netstat counters in Prometheus' text format, for scraping
+consvar_t cv_netmetrics_file = {"netmetrics_file", "", CV_SAVE, NULL, NULL, 0, NULL, NULL, 0, 0, NULL};
+static CV_PossibleValue_t netmetrics_interval_cons_t[] = {{1, "MIN"}, {3600, "MAX"}, {0, NULL}};
+consvar_t cv_netmetrics_interval = {"netmetrics_interval", "15", CV_SAVE, netmetrics_interval_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 static void Got_AddPlayer(UINT8 **p, INT32 playernum);
 static void Got_RemovePlayer(UINT8 **p, INT32 playernum);
 
@@ -4186,6 +5275,8 @@ void D_ClientServerInit(void)
 #endif
 	COM_AddCommand("listplayers", Command_Listplayers);
 	COM_AddCommand("packetstat", Command_Packetstat);
+	COM_AddCommand("netstat", Command_NetStat);
+	COM_AddCommand("netcompression_stats", Command_NetCompression_f);
 #ifdef HAVE_CURL
 	COM_AddCommand("set_http_login", Command_set_http_login);
 	COM_AddCommand("list_http_logins", Command_list_http_logins);
@@ -4193,10 +5284,12 @@ void D_ClientServerInit(void)
 #ifdef PACKETDROP
 	COM_AddCommand("drop", Command_Drop);
 	COM_AddCommand("droprate", Command_Droprate);
+	COM_AddCommand("netsim", Command_NetSim);
 #endif
 #ifdef _DEBUG
 	COM_AddCommand("numnodes", Command_Numnodes);
 #endif
+	COM_AddCommand("netstress", Command_Netstress);
 #endif
 
 	RegisterNetXCmd(XD_KICK, Got_KickCmd);
@@ -4209,13 +5302,15 @@ void D_ClientServerInit(void)
 	D_LoadBan(false);
 #endif
 
+	D_PreallocTextcmds();
+
 	gametic = 0;
 	localgametic = 0;
 
 	// do not send anything before the real begin
 	SV_StopServer();
 	SV_ResetServer();
-	if (dedicated)
+	if (dedicated && !relay)
 		SV_SpawnServer();
 }
 
@@ -4223,6 +5318,7 @@ static void ResetNode(INT32 node)
 {
 	nodeingame[node] = false;
 	nodewaiting[node] = 0;
+	nodeisviewer[node] = false;
 
 	nodetoplayer[node] = -1;
 	nodetoplayer2[node] = -1;
@@ -4246,8 +5342,17 @@ static void ResetNode(INT32 node)
 #ifdef SATURNSYNCH
 	resendingsavegame[node] = false;
 	can_receive_gamestate[node] = false;
+	can_receive_ticdelta[node] = false;
+	if (ticdeltasent[node])
+	{
+		Z_Free(ticdeltasent[node]);
+		ticdeltasent[node] = NULL;
+	}
 	savegameresendcooldown[node] = 0;
 	gamestate_resend_counter[node] = 0;
+	SV_ClearGamestateBase(node);
+	consistencyasked[node] = 0;
+	memset(&nodecmdqueue[node], 0, sizeof (nodecmdqueue_t));
 #endif
 	//
 }
@@ -4264,6 +5369,8 @@ void SV_ResetServer(void)
 	neededtic = maketic;
 	tictoclear = maketic;
 
+	SV_ReleaseSaveGameCache();
+
 	for (i = 0; i < MAXNETNODES; i++)
 	{
 		ResetNode(i);
@@ -4287,6 +5394,7 @@ void SV_ResetServer(void)
 	cl_packetmissed = false;
 #ifdef SATURNSYNCH
 	cl_redownloadinggamestate = false;
+	CL_ClearGamestateBase();
 #endif
 
 	if (dedicated)
@@ -4354,10 +5462,23 @@ void D_QuitNetGame(void)
 			UnregisterServer();
 #endif
 	}
-	else if (servernode > 0 && servernode < MAXNETNODES && nodeingame[(UINT8)servernode])
+	else
 	{
-		netbuffer->packettype = PT_CLIENTQUIT;
-		HSendPacket(servernode, true, 0, 0);
+		if (relay) // The viewers have nothing to watch without us
+		{
+			INT32 i;
+
+			netbuffer->packettype = PT_SERVERSHUTDOWN;
+			for (i = 1; i < MAXNETNODES; i++)
+				if (nodeingame[i] && i != servernode)
+					HSendPacket(i, true, 0, 0);
+		}
+
+		if (servernode > 0 && servernode < MAXNETNODES && nodeingame[(UINT8)servernode])
+		{
+			netbuffer->packettype = PT_CLIENTQUIT;
+			HSendPacket(servernode, true, 0, 0);
+		}
 	}
 
 	D_CloseConnection();
@@ -4704,6 +5825,67 @@ static size_t TotalTextCmdPerTic(tic_t tic)
 	return total;
 }
 
+/** Notes what the joining node said it can handle
+  *
+  * \param node The node sending the join request
+  *
+  */
+static void SV_ReadClientConfig(SINT8 node)
+{
+	// Every client can take LZF gamestates
+	if ((size_t)doomcom->datalength > BASEPACKETSIZE + offsetof(clientconfig_pak, compression))
+		netcompression[node] = (netbuffer->u.clientcfg.compression & NETCOMPRESS_SUPPORTED) | NETCOMPRESS_LZF;
+	else
+		netcompression[node] = NETCOMPRESS_LZF;
+#ifdef SATURNSYNCH
+	can_receive_ticdelta[node] = (size_t)doomcom->datalength >= BASEPACKETSIZE + sizeof (clientconfig_pak)
+		&& netbuffer->u.clientcfg.ticdelta == TICDELTA_VERSION;
+	if (can_receive_ticdelta[node] && !ticdeltasent[node])
+		ticdeltasent[node] = Z_Calloc(TICDELTAHISTORY * sizeof (ticdeltabase_t), PU_STATIC, NULL);
+#endif
+}
+
+/** Lets in a node that watches the game without a player of its own:
+  * a relay joining the real server, or a viewer joining a relay.
+  * It gets the game state and the tics like anyone else, but its
+  * own ticcmds and textcmds are never used.
+  *
+  * \param node The node sending the join request
+  *
+  */
+static void SV_AddViewer(SINT8 node)
+{
+	SV_ReadClientConfig(node);
+
+	if (nodeingame[node])
+		return;
+
+	SV_AddNode(node);
+	nodeisviewer[node] = true;
+
+	if (!SV_SendServerConfig(node))
+	{
+		SV_SendRefuse(node, M_GetText("Server couldn't send info, please try again"));
+		ResetNode(node);
+		return;
+	}
+	SV_SendServerInfo(node, 0);
+	SV_SendSaveGame(node, false);
+
+	DEBFILE(va("node %d joined as a %s\n", node, relay ? "viewer" : "relay"));
+}
+
+/** Tells whether a join request asked to watch without a player
+  *
+  * \return True if the joining node set the viewer flag
+  *
+  */
+static boolean SV_JoinsAsViewer(void)
+{
+	return (size_t)doomcom->datalength > BASEPACKETSIZE + offsetof(clientconfig_pak, viewer)
+		&& netbuffer->u.clientcfg.viewer && !netbuffer->u.clientcfg.localplayers;
+}
+
 /** Called when a PT_CLIENTJOIN packet is received
   *
   * \param node The packet sender
@@ -4773,6 +5955,26 @@ static void HandleConnect(SINT8 node)
 	{
 		SV_SendRefuse(node, va(M_GetText("Different SRB2Kart versions cannot\nplay a netgame!\n(server version %d.%d)"), VERSION, SUBVERSION));
 	}
+	else if (relay) // Nobody gets a player through a relay, so the limits below don't apply
+	{
+		if (!SV_JoinsAsViewer())
+			SV_SendRefuse(node, M_GetText("This is a relay, it\nonly takes viewers.\nConnect with -viewer."));
+		else if (cv_allownewplayer.value)
+			SV_AddViewer(node);
+		else
+			SV_SendRefuse(node, M_GetText(cv_joinrefusemessage.string));
+	}
+	else if (netgame && SV_JoinsAsViewer())
+	{
+		if (cv_allowrelays.value)
+			SV_AddViewer(node);
+		else
+			SV_SendRefuse(node, M_GetText("This server doesn't\ntake relays or viewers."));
+	}
+	else if (netgame && !netbuffer->u.clientcfg.localplayers) // Stealth join?
+	{
+		SV_SendRefuse(node, M_GetText("No players from\nthis node."));
+	}
 #ifdef SATURNJOIN
 	else if ((!cv_allownewplayer.value && node && netbuffer->u.clientcfg.issaturn != ISSATURN) || (!cv_allownewsaturnplayer.value && node && netbuffer->u.clientcfg.issaturn == ISSATURN))
 #else
@@ -4793,10 +5995,6 @@ static void HandleConnect(SINT8 node)
 	{
 		SV_SendRefuse(node, va(M_GetText("Number of local players\nwould exceed maximum: %d"), maxplayers));
 	}
-	else if (netgame && !netbuffer->u.clientcfg.localplayers) // Stealth join?
-	{
-		SV_SendRefuse(node, M_GetText("No players from\nthis node."));
-	}
 	else
 	{
 #ifndef NONET
@@ -4805,6 +6003,8 @@ static void HandleConnect(SINT8 node)
 
 		// client authorised to join
 		nodewaiting[node] = (UINT8)(netbuffer->u.clientcfg.localplayers - playerpernode[node]);
+
+		SV_ReadClientConfig(node);
 		if (!nodeingame[node])
 		{
 			gamestate_t backupstate = gamestate;
@@ -4867,6 +6067,11 @@ static void HandleConnect(SINT8 node)
 static void HandleShutdown(SINT8 node)
 {
 	(void)node;
+	if (relay && dedicated)
+	{
+		CONS_Printf(M_GetText("Server has shutdown, closing the relay\n"));
+		I_Quit();
+	}
 	D_QuitNetGame();
 	CL_Reset();
 	D_StartTitle();
@@ -4881,6 +6086,11 @@ static void HandleShutdown(SINT8 node)
 static void HandleTimeout(SINT8 node)
 {
 	(void)node;
+	if (relay && dedicated)
+	{
+		CONS_Printf(M_GetText("Server Timeout, closing the relay\n"));
+		I_Quit();
+	}
 	D_QuitNetGame();
 	CL_Reset();
 	D_StartTitle();
@@ -4896,20 +6106,15 @@ static void HandleTimeout(SINT8 node)
   */
 static void HandleServerInfo(SINT8 node)
 {
-	char servername[MAXSERVERNAME];
 	// compute ping in ms
 	const tic_t ticnow = I_GetTime();
 	const tic_t ticthen = (tic_t)LONG(netbuffer->u.serverinfo.time);
 	const tic_t ticdiff = (ticnow - ticthen)*1000/NEWTICRATE;
 	netbuffer->u.serverinfo.time = (tic_t)LONG(ticdiff);
-	netbuffer->u.serverinfo.servername[MAXSERVERNAME-1] = 0;
-	netbuffer->u.serverinfo.application
-		[sizeof netbuffer->u.serverinfo.application - 1] = '\0';
-	memcpy(servername, netbuffer->u.serverinfo.servername, MAXSERVERNAME);
-	CopyCaretColors(netbuffer->u.serverinfo.servername, servername, MAXSERVERNAME);
-	netbuffer->u.serverinfo.gametype = (UINT8)((netbuffer->u.serverinfo.gametype == VANILLA_GT_MATCH) ? GT_MATCH : GT_RACE);
+	SL_CleanServerInfo(&netbuffer->u.serverinfo);
 
-	SL_InsertServer(&netbuffer->u.serverinfo, node);
+	SL_InsertServer(&netbuffer->u.serverinfo, node, -1);
+	M_SortServerList(); // resort server list
 
 	if (client && cl_mode > CL_SEARCHING && node == servernode)
 		memcpy(connectedservername, netbuffer->u.serverinfo.servername, MAXSERVERNAME);
@@ -4917,6 +6122,433 @@ static void HandleServerInfo(SINT8 node)
 #endif
 
 #ifdef SATURNSYNCH
+static const char *consistencynames[NUMCONSISTENCY] =
+{
+	"RNG",
+	"players",
+	"mobjs",
+	"thinkers",
+	"polyobjects",
+	"Lua variables"
+};
+
+static inline UINT32 ConsistencyMix(UINT32 h, UINT32 v)
+{
+	return (h ^ v) * 0x01000193;
+}
+
+static UINT32 PlayerConsistency(player_t *player)
+{
+	UINT32 h = 0x811C9DC5;
+	INT32 i;
+
+	h = ConsistencyMix(h, player->playerstate);
+	h = ConsistencyMix(h, player->pflags);
+	for (i = 0; i < NUMKARTSTUFF; i++)
+		h = ConsistencyMix(h, player->kartstuff[i]);
+	for (i = 0; i < NUMPOWERS; i++)
+		h = ConsistencyMix(h, player->powers[i]);
+	if (player->mo)
+	{
+		h = ConsistencyMix(h, player->mo->x);
+		h = ConsistencyMix(h, player->mo->y);
+		h = ConsistencyMix(h, player->mo->z);
+		h = ConsistencyMix(h, player->mo->momx);
+		h = ConsistencyMix(h, player->mo->momy);
+		h = ConsistencyMix(h, player->mo->momz);
+		h = ConsistencyMix(h, player->mo->angle);
+	}
+	return h;
+}
+
+static UINT32 MobjConsistency(UINT32 h, mobj_t *mo)
+{
+	h = ConsistencyMix(h, mo->type);
+	h = ConsistencyMix(h, mo->x);
+	h = ConsistencyMix(h, mo->y);
+	h = ConsistencyMix(h, mo->z);
+	h = ConsistencyMix(h, mo->momx);
+	h = ConsistencyMix(h, mo->momy);
+	h = ConsistencyMix(h, mo->momz);
+	h = ConsistencyMix(h, mo->angle);
+	h = ConsistencyMix(h, mo->flags);
+	h = ConsistencyMix(h, mo->flags2);
+	h = ConsistencyMix(h, mo->eflags);
+	h = ConsistencyMix(h, (UINT32)(mo->state - states));
+	h = ConsistencyMix(h, mo->tics);
+	h = ConsistencyMix(h, mo->health);
+	return h;
+}
+
+/** Records this tic's per-subsystem hashes
+  */
+static void RecordConsistency(void)
+{
+	consistencyrecord_t *rec = &consistencyrecord[gametic%CONSISTENCYHISTORY];
+	INT32 i;
+
+	rec->tic = gametic;
+	memset(rec->category, 0, sizeof (rec->category));
+	memset(rec->player, 0, sizeof (rec->player));
+	rec->nummobjs = 0;
+	rec->numluavars = 0;
+
+	if (gamestate != GS_LEVEL)
+		return;
+
+	rec->category[CONSISTENCY_RNG] = P_GetRandSeed();
+
+	rec->category[CONSISTENCY_PLAYERS] = 0x811C9DC5;
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		if (playeringame[i])
+			rec->player[i] = PlayerConsistency(&players[i]);
+		rec->category[CONSISTENCY_PLAYERS] = ConsistencyMix(rec->category[CONSISTENCY_PLAYERS], rec->player[i]);
+	}
+
+	if (thinkercap.next)
+	{
+		thinker_t *th;
+
+		rec->category[CONSISTENCY_THINKERS] = 0x811C9DC5;
+		rec->category[CONSISTENCY_MOBJS] = 0x811C9DC5;
+		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		{
+			consistencymobj_t *cmo;
+			mobj_t *mo;
+
+			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+			{
+				// Only the order of the others is comparable across nodes
+				rec->category[CONSISTENCY_THINKERS] = ConsistencyMix(rec->category[CONSISTENCY_THINKERS],
+					th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed ? 2 : 3);
+				continue;
+			}
+			rec->category[CONSISTENCY_THINKERS] = ConsistencyMix(rec->category[CONSISTENCY_THINKERS], 1);
+
+			if (rec->nummobjs == rec->maxmobjs)
+			{
+				rec->maxmobjs = rec->maxmobjs ? rec->maxmobjs*2 : 1024;
+				rec->mobj = Z_Realloc(rec->mobj, rec->maxmobjs * sizeof (*rec->mobj), PU_STATIC, NULL);
+			}
+
+			mo = (mobj_t *)th;
+			cmo = &rec->mobj[rec->nummobjs];
+			cmo->hash = MobjConsistency(0x811C9DC5, mo);
+			cmo->type = (UINT16)mo->type;
+			cmo->x = mo->x;
+			cmo->y = mo->y;
+			cmo->z = mo->z;
+			rec->category[CONSISTENCY_MOBJS] = ConsistencyMix(rec->category[CONSISTENCY_MOBJS], cmo->hash);
+			rec->nummobjs++;
+		}
+	}
+
+	rec->category[CONSISTENCY_POLYOBJS] = 0x811C9DC5;
+	for (i = 0; i < numPolyObjects; i++)
+	{
+		polyobj_t *po = &PolyObjects[i];
+		rec->category[CONSISTENCY_POLYOBJS] = ConsistencyMix(rec->category[CONSISTENCY_POLYOBJS], po->id);
+		rec->category[CONSISTENCY_POLYOBJS] = ConsistencyMix(rec->category[CONSISTENCY_POLYOBJS], po->centerPt.x);
+		rec->category[CONSISTENCY_POLYOBJS] = ConsistencyMix(rec->category[CONSISTENCY_POLYOBJS], po->centerPt.y);
+		rec->category[CONSISTENCY_POLYOBJS] = ConsistencyMix(rec->category[CONSISTENCY_POLYOBJS], po->angle);
+		rec->category[CONSISTENCY_POLYOBJS] = ConsistencyMix(rec->category[CONSISTENCY_POLYOBJS], po->flags);
+	}
+
+	rec->category[CONSISTENCY_LUA] = LUA_ConsistencyHash(rec->luaname, rec->luavalue, &rec->numluavars, CONSISTENCYLUAVARS);
+}
+
+/** Hashes mobjs from first on in blocks of CONSISTENCYMOBJBLOCKSIZE,
+  * the last block taking the rest
+  */
+static void ConsistencyMobjBlocks(const consistencyrecord_t *rec, size_t first, UINT32 *blocks)
+{
+	size_t i;
+
+	for (i = 0; i < CONSISTENCYMOBJBLOCKS; i++)
+		blocks[i] = 0x811C9DC5;
+	for (i = first; i < rec->nummobjs; i++)
+	{
+		const size_t block = min((i - first) / CONSISTENCYMOBJBLOCKSIZE, CONSISTENCYMOBJBLOCKS-1);
+		blocks[block] = ConsistencyMix(blocks[block], rec->mobj[i].hash);
+	}
+}
+
+/** Asks a node that failed the consistency check what it had on that tic.
+  * Sends our mobj block hashes from firstmobj on along, so the node can
+  * tell which of its mobjs to send back.
+  */
+static void SV_AskConsistencyReport(INT32 node, tic_t tic, size_t firstmobj)
+{
+	consistencyrecord_t *rec = &consistencyrecord[tic%CONSISTENCYHISTORY];
+	UINT32 blocks[CONSISTENCYMOBJBLOCKS];
+	INT32 i;
+
+	if (!cv_consistencyreport.value || rec->tic != tic)
+		return;
+
+	// One question at a time is plenty, not counting follow-ups
+	if (!firstmobj)
+	{
+		if (consistencyasked[node] && gametic < consistencyasked[node] + TICRATE)
+			return;
+		consistencyasked[node] = gametic;
+	}
+
+	ConsistencyMobjBlocks(rec, firstmobj, blocks);
+
+	netbuffer->packettype = PT_ASKCONSISTENCY;
+	netbuffer->u.askconsistency.tic = (tic_t)LONG(tic);
+	netbuffer->u.askconsistency.firstmobj = (UINT16)SHORT(firstmobj);
+	for (i = 0; i < CONSISTENCYMOBJBLOCKS; i++)
+		netbuffer->u.askconsistency.mobjblock[i] = (UINT32)LONG(blocks[i]);
+	HSendPacket(node, true, 0, sizeof (askconsistency_pak));
+}
+
+static void PT_AskConsistency(void)
+{
+	consistencyreport_pak *report = &netbuffer->u.consistencyreport;
+	consistencyrecord_t *rec;
+	UINT32 ours[CONSISTENCYMOBJBLOCKS], theirs[CONSISTENCYMOBJBLOCKS];
+	size_t asked, first = UINT16_MAX, num = 0;
+	tic_t tic;
+	INT32 i;
+
+	if (server || !cv_consistencyreport.value
+		|| (size_t)doomcom->datalength < BASEPACKETSIZE + sizeof (askconsistency_pak))
+		return;
+
+	tic = (tic_t)LONG(netbuffer->u.askconsistency.tic);
+	rec = &consistencyrecord[tic%CONSISTENCYHISTORY];
+	if (rec->tic != tic)
+		return; // Too long ago, or before we joined
+
+	// The report goes out in the same buffer
+	asked = (UINT16)SHORT(netbuffer->u.askconsistency.firstmobj);
+	for (i = 0; i < CONSISTENCYMOBJBLOCKS; i++)
+		theirs[i] = (UINT32)LONG(netbuffer->u.askconsistency.mobjblock[i]);
+
+	// Our mobjs from the start of the first block that differs from the server's
+	ConsistencyMobjBlocks(rec, asked, ours);
+	for (i = 0; i < CONSISTENCYMOBJBLOCKS; i++)
+		if (ours[i] != theirs[i])
+		{
+			first = asked + (size_t)i * CONSISTENCYMOBJBLOCKSIZE;
+			if (first < rec->nummobjs)
+				num = min(rec->nummobjs - first, CONSISTENCYMOBJBLOCKSIZE);
+			break;
+		}
+
+	netbuffer->packettype = PT_CONSISTENCYREPORT;
+	report->tic = (tic_t)LONG(rec->tic);
+	for (i = 0; i < NUMCONSISTENCY; i++)
+		report->category[i] = (UINT32)LONG(rec->category[i]);
+	for (i = 0; i < MAXPLAYERS; i++)
+		report->player[i] = (UINT32)LONG(rec->player[i]);
+
+	report->nummobjs = (UINT16)SHORT(min(rec->nummobjs, UINT16_MAX));
+	report->askedmobj = (UINT16)SHORT(asked);
+	report->firstmobj = (UINT16)SHORT(first);
+	report->nummobjentries = (UINT8)num;
+	for (i = 0; i < (INT32)num; i++)
+	{
+		const consistencymobj_t *cmo = &rec->mobj[first + i];
+		report->mobj[i].hash = (UINT32)LONG(cmo->hash);
+		report->mobj[i].type = (UINT16)SHORT(cmo->type);
+		report->mobj[i].x = (fixed_t)LONG(cmo->x);
+		report->mobj[i].y = (fixed_t)LONG(cmo->y);
+		report->mobj[i].z = (fixed_t)LONG(cmo->z);
+	}
+
+	report->numluavars = rec->numluavars;
+	for (i = 0; i < rec->numluavars; i++)
+	{
+		report->luaname[i] = (UINT32)LONG(rec->luaname[i]);
+		report->luavalue[i] = (UINT32)LONG(rec->luavalue[i]);
+	}
+
+	HSendPacket(servernode, true, 0, sizeof (consistencyreport_pak));
+}
+
+/** Prints the first mobj that differs between our record and a node's report
+  *
+  * \return Where to ask the node about the mobjs after the ones it sent, or 0 if done.
+  */
+static size_t ReportMobjConsistency(const consistencyrecord_t *ours, const consistencyreport_pak *theirs)
+{
+	const size_t theirnum = (UINT16)SHORT(theirs->nummobjs);
+	const size_t first = (UINT16)SHORT(theirs->firstmobj);
+	size_t i;
+
+	if (first == UINT16_MAX)
+	{
+		CONS_Printf(M_GetText("  mobjs differ, but none from #%s on\n"), sizeu1((UINT16)SHORT(theirs->askedmobj)));
+		return 0;
+	}
+
+	// Their entries run to the end of the block or of their mobjs, whichever comes first
+	for (i = first; i < first + CONSISTENCYMOBJBLOCKSIZE; i++)
+	{
+		const consistencymobj_t *cmo = &theirs->mobj[i - first];
+		const boolean theyhave = (i < first + min(theirs->nummobjentries, CONSISTENCYMOBJBLOCKSIZE));
+
+		if (i >= ours->nummobjs && !theyhave)
+			break;
+
+		if (!theyhave)
+		{
+			cmo = &ours->mobj[i];
+			CONS_Printf(M_GetText("  mobjs differ, first is #%s: only the server has it, type %d at (%d, %d, %d)\n"),
+				sizeu1(i), cmo->type, cmo->x>>FRACBITS, cmo->y>>FRACBITS, cmo->z>>FRACBITS);
+			return 0;
+		}
+
+		if (i >= ours->nummobjs)
+		{
+			CONS_Printf(M_GetText("  mobjs differ, first is #%s: only the player has it, type %d at (%d, %d, %d)\n"),
+				sizeu1(i), (UINT16)SHORT(cmo->type),
+				(fixed_t)LONG(cmo->x)>>FRACBITS, (fixed_t)LONG(cmo->y)>>FRACBITS, (fixed_t)LONG(cmo->z)>>FRACBITS);
+			return 0;
+		}
+
+		if (ours->mobj[i].hash != (UINT32)LONG(cmo->hash))
+		{
+			CONS_Printf(M_GetText("  mobjs differ, first is #%s: type %d at (%d, %d, %d) on the server, type %d at (%d, %d, %d) for the player\n"),
+				sizeu1(i), ours->mobj[i].type,
+				ours->mobj[i].x>>FRACBITS, ours->mobj[i].y>>FRACBITS, ours->mobj[i].z>>FRACBITS,
+				(UINT16)SHORT(cmo->type),
+				(fixed_t)LONG(cmo->x)>>FRACBITS, (fixed_t)LONG(cmo->y)>>FRACBITS, (fixed_t)LONG(cmo->z)>>FRACBITS);
+			return 0;
+		}
+	}
+
+	// The last block takes every mobj left, so it can have more than fit
+	if (i == first + CONSISTENCYMOBJBLOCKSIZE && i < UINT16_MAX && (i < ours->nummobjs || i < theirnum))
+	{
+		CONS_Printf(M_GetText("  mobjs match up to #%s, asking about the rest...\n"), sizeu1(i));
+		return i;
+	}
+
+	CONS_Printf(M_GetText("  mobjs differ, somewhere past #%s (server has %s, player has %s)\n"),
+		sizeu1(i), sizeu2(ours->nummobjs), sizeu3(theirnum));
+	return 0;
+}
+
+/** Prints the first Lua variable that differs between our record and a node's report
+  */
+static void ReportLuaConsistency(const consistencyrecord_t *ours, const consistencyreport_pak *theirs)
+{
+	const UINT8 theirnum = min(theirs->numluavars, CONSISTENCYLUAVARS);
+	UINT8 i = 0, j = 0;
+	UINT32 name = 0;
+	boolean found = false;
+	const char *varname;
+
+	// Both lists are sorted by name hash
+	while (i < ours->numluavars || j < theirnum)
+	{
+		const UINT32 theirname = (j < theirnum) ? (UINT32)LONG(theirs->luaname[j]) : UINT32_MAX;
+
+		if (j >= theirnum || (i < ours->numluavars && ours->luaname[i] < theirname))
+			name = ours->luaname[i];
+		else if (i >= ours->numluavars || theirname < ours->luaname[i])
+			name = theirname;
+		else if (ours->luavalue[i] == (UINT32)LONG(theirs->luavalue[j]))
+		{
+			i++;
+			j++;
+			continue;
+		}
+		else
+			name = ours->luaname[i];
+
+		found = true;
+		break;
+	}
+
+	if (!found)
+	{
+		CONS_Printf(M_GetText("  Lua variables differ\n"));
+		return;
+	}
+
+	varname = LUA_ConsistencyVarName(name);
+	if (varname)
+		CONS_Printf(M_GetText("  Lua variables differ, first is \"%s\"\n"), varname);
+	else
+		CONS_Printf(M_GetText("  Lua variables differ, first is one no object has now (name hash %08x)\n"), name);
+}
+
+static void PT_ConsistencyReport(SINT8 node)
+{
+	consistencyreport_pak *theirs = &netbuffer->u.consistencyreport;
+	consistencyrecord_t *ours;
+	INT32 netconsole = nodetoplayer[node];
+	tic_t tic;
+	INT32 i, j;
+	size_t askmore = 0;
+	boolean same = true;
+
+	if (client || netconsole == -1 || (size_t)doomcom->datalength < BASEPACKETSIZE + sizeof (consistencyreport_pak))
+		return;
+
+	tic = (tic_t)LONG(theirs->tic);
+	ours = &consistencyrecord[tic%CONSISTENCYHISTORY];
+	if (ours->tic != tic)
+		return;
+
+	// A follow-up about the mobjs only
+	if (theirs->askedmobj)
+	{
+		askmore = ReportMobjConsistency(ours, theirs);
+		if (askmore)
+			SV_AskConsistencyReport(node, tic, askmore);
+		return;
+	}
+
+	CONS_Alert(CONS_WARNING, M_GetText("Consistency report for player %d (%s) at tic %u:\n"),
+		netconsole+1, player_names[netconsole], tic);
+
+	for (i = 0; i < NUMCONSISTENCY; i++)
+	{
+		if (ours->category[i] == (UINT32)LONG(theirs->category[i]))
+			continue;
+		same = false;
+
+		if (i == CONSISTENCY_PLAYERS)
+		{
+			for (j = 0; j < MAXPLAYERS; j++)
+				if (ours->player[j] != (UINT32)LONG(theirs->player[j]))
+					break;
+			if (j < MAXPLAYERS)
+			{
+				CONS_Printf(M_GetText("  %s differ, first is player %d (%s)\n"),
+					consistencynames[i], j+1, playeringame[j] ? player_names[j] : "not in game");
+				continue;
+			}
+		}
+		else if (i == CONSISTENCY_MOBJS)
+		{
+			askmore = ReportMobjConsistency(ours, theirs);
+			continue;
+		}
+		else if (i == CONSISTENCY_LUA)
+		{
+			ReportLuaConsistency(ours, theirs);
+			continue;
+		}
+
+		CONS_Printf(M_GetText("  %s differ\n"), consistencynames[i]);
+	}
+
+	if (same)
+		CONS_Printf(M_GetText("  nothing differs beyond the basic check\n"));
+
+	// Overwrites the report
+	if (askmore)
+		SV_AskConsistencyReport(node, tic, askmore);
+}
+
 static void PT_WillResendGamestate(void)
 {
 	char tmpsave[264];
@@ -4925,9 +6557,11 @@ static void PT_WillResendGamestate(void)
 		return;
 
 	// Send back a PT_CANRECEIVEGAMESTATE packet to the server
-	// so they know they can start sending the game state
+	// so they know they can start sending the game state,
+	// along with what it could be sent as a delta against
 	netbuffer->packettype = PT_CANRECEIVEGAMESTATE;
-	if (!HSendPacket(servernode, true, 0, 0))
+	netbuffer->u.gamestatebase = LONG(cl_gamestatebasesum);
+	if (!HSendPacket(servernode, true, 0, sizeof (UINT32)))
 		return;
 
 	CONS_Printf(M_GetText("Reloading game state...\n"));
@@ -4947,6 +6581,12 @@ static void PT_CanReceiveGamestate(SINT8 node)
 	if (client || sendingsavegame[node])
 		return;
 
+	// Older clients don't say what they have
+	if ((size_t)doomcom->datalength >= BASEPACKETSIZE + sizeof (UINT32))
+		clientgamestatebase[node] = (UINT32)LONG(netbuffer->u.gamestatebase);
+	else
+		clientgamestatebase[node] = 0;
+
 	CONS_Printf(M_GetText("Resending game state to %s...\n"), player_names[nodetoplayer[node]]);
 
 	SV_SendSaveGame(node, true); // Resend a complete game state
@@ -5006,7 +6646,7 @@ static void HandlePacketFromAwayNode(SINT8 node)
 			break;
 
 		case PT_TELLFILESNEEDED:
-			if (server && serverrunning)
+			if ((server && serverrunning) || (relay && cl_mode == CL_CONNECTED))
 			{
 				UINT8 *p;
 				INT32 firstfile = netbuffer->u.filesneedednum;
@@ -5039,7 +6679,7 @@ static void HandlePacketFromAwayNode(SINT8 node)
 			break;
 
 		case PT_ASKINFO:
-			if (server && serverrunning)
+			if ((server && serverrunning) || (relay && cl_mode == CL_CONNECTED))
 			{
 				SV_SendServerInfo(node, (tic_t)LONG(netbuffer->u.askinfo.time));
 				SV_SendPlayerInfo(node); // Send extra info
@@ -5113,6 +6753,7 @@ static void HandlePacketFromAwayNode(SINT8 node)
 			if (client)
 			{
 				maketic = gametic = neededtic = (tic_t)LONG(netbuffer->u.servercfg.gametic);
+				tictoclear = gametic;
 				if ((gametype = netbuffer->u.servercfg.gametype) >= NUMGAMETYPES)
 					I_Error("Bad gametype in cliserv!");
 				modifiedgame = netbuffer->u.servercfg.modifiedgame;
@@ -5185,7 +6826,7 @@ static void HandlePacketFromAwayNode(SINT8 node)
 			break;
 
 		case PT_REQUESTFILE:
-			if (server)
+			if (server || (relay && cl_mode == CL_CONNECTED))
 			{
 				if (!cv_downloading.value || !Got_RequestFilePak(node))
 					Net_CloseConnection(node); // close connection if one of the requested files could not be sent, or you disabled downloading anyway
@@ -5194,55 +6835,239 @@ static void HandlePacketFromAwayNode(SINT8 node)
 				Net_CloseConnection(node); // nope
 			break;
 
-		case PT_NODETIMEOUT:
-		case PT_CLIENTQUIT:
-			if (server)
-				Net_CloseConnection(node);
-			break;
+		case PT_NODETIMEOUT:
+		case PT_CLIENTQUIT:
+			if (server)
+				Net_CloseConnection(node);
+			break;
+
+		case PT_CLIENTCMD:
+			break; // This is not an "unknown packet"
+
+		case PT_SERVERTICS:
+#ifdef SATURNSYNCH
+		case PT_SERVERDELTATICS:
+#endif
+			// Do not remove my own server (we have just get a out of order packet)
+			if (node == servernode)
+				break;
+			/* FALLTHRU */
+
+		default:
+			DEBFILE(va("unknown packet received (%d) from unknown host\n",netbuffer->packettype));
+			Net_CloseConnection(node);
+			break; // Ignore it
+
+	}
+#undef SERVERONLY
+}
+
+/** Checks ticcmd for "speed hacks"
+  *
+  * \param p Which player
+  * \return True if player is hacking
+  * \sa HandlePacketFromPlayer
+  *
+  */
+static boolean CheckTiccmdForSpeedHacks(UINT8 p, const ticcmd_t *cmd)
+{
+	if (cmd->forwardmove > MAXPLMOVE || cmd->forwardmove < -MAXPLMOVE
+		|| cmd->sidemove > MAXPLMOVE || cmd->sidemove < -MAXPLMOVE
+		|| cmd->driftturn > KART_FULLTURN || cmd->driftturn < -KART_FULLTURN)
+	{
+		char buf[2];
+		CONS_Alert(CONS_WARNING, M_GetText("Illegal movement value received from node %d\n"), playernode[p]);
+		//D_Clearticcmd(k);
+
+		buf[0] = (char)p;
+		buf[1] = KICK_MSG_CON_FAIL;
+		SendNetXCmd(XD_KICK, &buf, 2);
+		return true;
+	}
+
+	return false;
+}
+
+static inline boolean CheckForSpeedHacks(UINT8 p)
+{
+	return CheckTiccmdForSpeedHacks(p, &netcmds[maketic%TICQUEUE][p]);
+}
+
+#ifdef SATURNSYNCH
+/** Tracks how unevenly cmd packets from a node arrive, for SV_AdviseTicBatch
+  */
+static void SV_MeasureCmdArrival(INT32 node)
+{
+	nodecmdqueue_t *q = &nodecmdqueue[node];
+	const tic_t now = I_GetTime();
+	INT32 expected = max(q->batch, 1);
+	fixed_t deviation;
+
+	if (q->lastarrival)
+	{
+		deviation = abs((INT32)(now - q->lastarrival) - expected)<<FRACBITS;
+		q->jitter += (deviation - q->jitter) / 16;
+	}
+	q->lastarrival = now;
+}
+
+/** Empties a node's cmd queue, so nothing is fed from it until it sends
+  * batches again
+  */
+static void SV_ResetCmdQueue(nodecmdqueue_t *q)
+{
+	q->head = q->count = 0;
+	q->seq = 0;
+	q->started = q->primed = false;
+}
+
+/** Queues the tics of a PT_CLIENTBATCHCMD the node has not sent before
+  *
+  * Batches that arrive after the node was told to stop batching are
+  * dropped, as it sends its cmds every tic again.
+  *
+  * \return true if the node got kicked for sending bad cmds
+  */
+static boolean SV_QueueCmdBatch(INT32 node)
+{
+	nodecmdqueue_t *q = &nodecmdqueue[node];
+	clientbatchcmd_pak *pak = &netbuffer->u.clientbatchpak;
+	const SINT8 nodeplayers[MAXSPLITSCREENPLAYERS] = {nodetoplayer[node], nodetoplayer2[node], nodetoplayer3[node], nodetoplayer4[node]};
+	const UINT16 newest = (UINT16)SHORT(pak->seq);
+	const UINT8 numplayers = min(pak->numplayers, MAXSPLITSCREENPLAYERS);
+	UINT8 i, j;
+
+	if (!q->batch)
+		return false;
 
-		case PT_CLIENTCMD:
-			break; // This is not an "unknown packet"
+	for (i = 0; i < pak->numtics; i++)
+	{
+		const UINT16 seq = (UINT16)(newest - pak->numtics + 1 + i);
+		ticcmd_t *cmds;
 
-		case PT_SERVERTICS:
-			// Do not remove my own server (we have just get a out of order packet)
-			if (node == servernode)
-				break;
-			/* FALLTHRU */
+		if (q->started && (INT16)(seq - q->seq) <= 0)
+			continue; // Already queued by an earlier packet
 
-		default:
-			DEBFILE(va("unknown packet received (%d) from unknown host\n",netbuffer->packettype));
-			Net_CloseConnection(node);
-			break; // Ignore it
+		// Nothing is draining the queue, so the oldest tics are stale anyway
+		if (q->count == NODECMDQUEUE)
+		{
+			q->head = (q->head + 1) % NODECMDQUEUE;
+			q->count--;
+		}
 
+		cmds = q->cmds[(q->head + q->count) % NODECMDQUEUE];
+		G_MoveTiccmd(cmds, &pak->cmds[i*pak->numplayers], numplayers);
+
+		for (j = 0; j < numplayers; j++)
+			if (nodeplayers[j] >= 0 && CheckTiccmdForSpeedHacks((UINT8)nodeplayers[j], &cmds[j]))
+				return true;
+
+		q->count++;
+		q->seq = seq;
+		q->started = true;
 	}
-#undef SERVERONLY
+
+	return false;
 }
 
-/** Checks ticcmd for "speed hacks"
+/** Hands the next queued tic of a batching node to maketic
   *
-  * \param p Which player
-  * \return True if player is hacking
-  * \sa HandlePacketFromPlayer
+  * Nothing is fed until the queue holds more than the lead, so the
+  * node can send late without the server repeating its cmds.
+  */
+static void SV_FeedQueuedCmds(INT32 node)
+{
+	nodecmdqueue_t *q = &nodecmdqueue[node];
+	const SINT8 nodeplayers[MAXSPLITSCREENPLAYERS] = {nodetoplayer[node], nodetoplayer2[node], nodetoplayer3[node], nodetoplayer4[node]};
+	INT32 i;
+
+	if (!q->started)
+		return;
+
+	if (!q->batch)
+	{
+		// Told to stop, so whatever was left would only repeat old tics
+		SV_ResetCmdQueue(q);
+		return;
+	}
+
+	if (!q->primed)
+	{
+		if (q->count <= q->lead)
+			return;
+		q->primed = true;
+	}
+
+	if (!q->count)
+	{
+		// Ran dry, SV_Maketic repeats the last tic while we buffer up again
+		q->primed = false;
+		return;
+	}
+
+	// Don't let a burst leave the node further behind than the lead calls for
+	if (q->count > q->lead + q->batch)
+	{
+		q->head = (q->head + 1) % NODECMDQUEUE;
+		q->count--;
+	}
+
+	for (i = 0; i < playerpernode[node] && i < MAXSPLITSCREENPLAYERS; i++)
+		if (nodeplayers[i] >= 0)
+			netcmds[maketic%TICQUEUE][nodeplayers[i]] = q->cmds[q->head][i];
+
+	q->head = (q->head + 1) % NODECMDQUEUE;
+	q->count--;
+}
+
+/** Picks how many tics a node should bundle per packet, and how far
+  * behind to run its cmds, from its ping and jitter
   *
+  * Bundling adds up to batch-1 tics of input delay, so it only kicks in
+  * once that is small next to the round trip.
   */
-static boolean CheckForSpeedHacks(UINT8 p)
+static void SV_AdviseTicBatch(INT32 node)
 {
-	if (netcmds[maketic%TICQUEUE][p].forwardmove > MAXPLMOVE || netcmds[maketic%TICQUEUE][p].forwardmove < -MAXPLMOVE
-		|| netcmds[maketic%TICQUEUE][p].sidemove > MAXPLMOVE || netcmds[maketic%TICQUEUE][p].sidemove < -MAXPLMOVE
-		|| netcmds[maketic%TICQUEUE][p].driftturn > KART_FULLTURN || netcmds[maketic%TICQUEUE][p].driftturn < -KART_FULLTURN)
+	nodecmdqueue_t *q = &nodecmdqueue[node];
+	UINT8 batch = 0, lead = 0;
+
+	if (cv_adaptivetics.value && nodetoplayer[node] != -1)
 	{
-		char buf[2];
-		CONS_Alert(CONS_WARNING, M_GetText("Illegal movement value received from node %d\n"), playernode[p]);
-		//D_Clearticcmd(k);
+		tic_t rtt = playerpingtable[(UINT8)nodetoplayer[node]];
+		tic_t jitter = (tic_t)((q->jitter + FRACUNIT - 1)>>FRACBITS);
 
-		buf[0] = (char)p;
-		buf[1] = KICK_MSG_CON_FAIL;
-		SendNetXCmd(XD_KICK, &buf, 2);
-		return true;
+		// A batching node only acks every batch tics, which shows up as lag
+		if (q->batch > 1)
+			rtt -= min(rtt, (tic_t)(q->batch - 1)/2);
+
+		batch = (UINT8)max(min(rtt/4, (tic_t)cv_adaptivetics_maxbatch.value), 1);
+		lead = (UINT8)max(min(batch - 1 + 2*jitter, (tic_t)cv_adaptivetics_maxlead.value), (tic_t)(batch - 1));
 	}
 
-	return false;
+	q->lead = lead;
+
+	if (batch == q->batch)
+		return;
+
+	netbuffer->packettype = PT_TICBATCH;
+	netbuffer->u.ticbatch = batch;
+	if (!HSendPacket(node, true, 0, 1))
+		return;
+
+	q->batch = batch;
+	if (!batch)
+		SV_ResetCmdQueue(q);
+}
+
+static void PT_TicBatch(void)
+{
+	if (server)
+		return;
+
+	cl_ticbatch = min(netbuffer->u.ticbatch, MAXTICBATCH);
+	cl_cmdsunsent = 0;
 }
+#endif
 
 /** Handles a packet received from a node that is in game
   *
@@ -5287,6 +7112,10 @@ static void HandlePacketFromPlayer(SINT8 node)
 		case PT_CLIENT4MIS:
 		case PT_NODEKEEPALIVE:
 		case PT_NODEKEEPALIVEMIS:
+#ifdef SATURNSYNCH
+		case PT_CLIENTBATCHCMD:
+		case PT_CLIENTBATCHMIS:
+#endif
 			if (client)
 				break;
 
@@ -5294,6 +7123,20 @@ static void HandlePacketFromPlayer(SINT8 node)
 			if (resynch_inprogress[node])
 				break;
 
+#ifdef SATURNSYNCH
+			if (netbuffer->packettype == PT_CLIENTBATCHCMD || netbuffer->packettype == PT_CLIENTBATCHMIS)
+			{
+				clientbatchcmd_pak *batchpak = &netbuffer->u.clientbatchpak;
+				if ((size_t)doomcom->datalength < BASEPACKETSIZE + offsetof(clientbatchcmd_pak, cmds)
+					|| batchpak->numtics > 2*MAXTICBATCH || batchpak->numplayers > MAXSPLITSCREENPLAYERS
+					|| (size_t)doomcom->datalength < BASEPACKETSIZE + offsetof(clientbatchcmd_pak, cmds) + batchpak->numtics*batchpak->numplayers*sizeof (ticcmd_t))
+					break;
+			}
+
+			if (netbuffer->packettype != PT_NODEKEEPALIVE && netbuffer->packettype != PT_NODEKEEPALIVEMIS)
+				SV_MeasureCmdArrival(node);
+#endif
+
 			// To save bytes, only the low byte of tic numbers are sent
 			// Use ExpandTics to figure out what the rest of the bytes are
 			realstart = ExpandTics(netbuffer->u.clientpak.client_tic, nettics[node]);
@@ -5302,6 +7145,9 @@ static void HandlePacketFromPlayer(SINT8 node)
 			if (netbuffer->packettype == PT_CLIENTMIS || netbuffer->packettype == PT_CLIENT2MIS
 				|| netbuffer->packettype == PT_CLIENT3MIS || netbuffer->packettype == PT_CLIENT4MIS
 				|| netbuffer->packettype == PT_NODEKEEPALIVEMIS
+#ifdef SATURNSYNCH
+				|| netbuffer->packettype == PT_CLIENTBATCHMIS
+#endif
 				|| supposedtics[node] < realend)
 			{
 				supposedtics[node] = realend;
@@ -5317,7 +7163,8 @@ static void HandlePacketFromPlayer(SINT8 node)
 			nettics[node] = realend;
 
 			// This should probably still timeout though, as the node should always have a player 1 number
-			if (netconsole == -1)
+			// A relay never gets one, but keeps itself alive all the same
+			if (netconsole == -1 && !nodeisviewer[node])
 				break;
 
 			// If a client sends a ticcmd it should mean they are done receiving the savegame
@@ -5330,15 +7177,27 @@ static void HandlePacketFromPlayer(SINT8 node)
 			// Don't do anything for packets of type NODEKEEPALIVE?
 			// Sryder 2018/07/01: Update the freezetimeout still!
 			if (netbuffer->packettype == PT_NODEKEEPALIVE
-				|| netbuffer->packettype == PT_NODEKEEPALIVEMIS)
+				|| netbuffer->packettype == PT_NODEKEEPALIVEMIS
+				|| netconsole == -1)
 				break;
 
-			// Copy ticcmd
-			G_MoveTiccmd(&netcmds[maketic%TICQUEUE][netconsole], &netbuffer->u.clientpak.cmd, 1);
+#ifdef SATURNSYNCH
+			// Batched cmds are handed to maketic one tic at a time by SV_FeedQueuedCmds
+			if (netbuffer->packettype == PT_CLIENTBATCHCMD || netbuffer->packettype == PT_CLIENTBATCHMIS)
+			{
+				if (SV_QueueCmdBatch(node))
+					break;
+			}
+			else
+#endif
+			{
+				// Copy ticcmd
+				G_MoveTiccmd(&netcmds[maketic%TICQUEUE][netconsole], &netbuffer->u.clientpak.cmd, 1);
 
-			// Check ticcmd for "speed hacks"
-			if (CheckForSpeedHacks((UINT8)netconsole))
-				break;
+				// Check ticcmd for "speed hacks"
+				if (CheckForSpeedHacks((UINT8)netconsole))
+					break;
+			}
 
 			// Splitscreen cmd
 			if (((netbuffer->packettype == PT_CLIENT2CMD || netbuffer->packettype == PT_CLIENT2MIS)
@@ -5397,6 +7256,8 @@ static void HandlePacketFromPlayer(SINT8 node)
 				&& !resendingsavegame[node] && savegameresendcooldown[node] <= I_GetTime()
 				&& !SV_ResendingSavegameToAnyone()))
 			{
+				SV_AskConsistencyReport(node, realstart, 0);
+
 //#ifndef SATURNPAK  // lug: keep this behaviour for v7.1 atleast
 				// we need to send this so the client can tell us if it can receive the savegame
 				netbuffer->packettype = PT_WILLRESENDGAMESTATE;
@@ -5503,7 +7364,8 @@ static void HandlePacketFromPlayer(SINT8 node)
 				break;
 
 			// This should probably still timeout though, as the node should always have a player 1 number
-			if (netconsole == -1)
+			// A relay never gets one, but keeps itself alive all the same
+			if (netconsole == -1 && !nodeisviewer[node])
 				break;
 
 			// If a client sends this it should mean they are done receiving the savegame
@@ -5607,6 +7469,7 @@ static void HandlePacketFromPlayer(SINT8 node)
 			}
 			Net_CloseConnection(node);
 			nodeingame[node] = false;
+			nodeisviewer[node] = false;
 #ifdef SATURNPAK
 			is_client_saturn[node] = false;
 #endif
@@ -5641,10 +7504,13 @@ static void HandlePacketFromPlayer(SINT8 node)
 
 			break;
 		case PT_SERVERTICS:
+#ifdef SATURNSYNCH
+		case PT_SERVERDELTATICS:
+#endif
 			// Only accept PT_SERVERTICS from the server.
 			if (node != servernode)
 			{
-				CONS_Alert(CONS_WARNING, M_GetText("%s received from non-host %d\n"), "PT_SERVERTICS", node);
+				CONS_Alert(CONS_WARNING, M_GetText("%s received from non-host %d\n"), Net_GetPacketName(netbuffer->packettype), node);
 
 				if (server)
 				{
@@ -5660,9 +7526,30 @@ static void HandlePacketFromPlayer(SINT8 node)
 			realstart = ExpandTics(netbuffer->u.serverpak.starttic, maketic);
 			realend = realstart + netbuffer->u.serverpak.numtics;
 
+			// A relay passes on every slot it is sent, even for players it hasn't added yet
+			if (relay && netbuffer->u.serverpak.numslots > doomcom->numslots
+				&& netbuffer->u.serverpak.numslots <= MAXPLAYERS)
+				doomcom->numslots = netbuffer->u.serverpak.numslots;
+
+#ifdef SATURNSYNCH
+			if (netbuffer->packettype == PT_SERVERDELTATICS)
+			{
+				txtpak = CL_ReadDeltaTics((UINT8 *)&netbuffer->u.serverpak.cmds,
+					(UINT8 *)netbuffer + doomcom->datalength, realstart,
+					netbuffer->u.serverpak.numtics, netbuffer->u.serverpak.numslots);
+				if (!txtpak)
+				{
+					DEBFILE(va("Can't decode PT_SERVERDELTATICS from node %d\n", node));
+					break;
+				}
+			}
+#endif
 			if (!txtpak)
 				txtpak = (UINT8 *)&netbuffer->u.serverpak.cmds[netbuffer->u.serverpak.numslots
 					* netbuffer->u.serverpak.numtics];
+			Net_CountTicCmds(node, true, netbuffer->u.serverpak.numtics,
+				txtpak - (UINT8 *)&netbuffer->u.serverpak.cmds,
+				netbuffer->u.serverpak.numtics * netbuffer->u.serverpak.numslots * sizeof (ticcmd_t));
 
 			if (realend > gametic + BACKUPTICS)
 				realend = gametic + BACKUPTICS;
@@ -5679,8 +7566,18 @@ static void HandlePacketFromPlayer(SINT8 node)
 					D_Clearticcmd(i);
 
 					// copy the tics
+#ifdef SATURNSYNCH
+					if (netbuffer->packettype == PT_SERVERDELTATICS)
+						M_Memcpy(netcmds[i%TICQUEUE],
+							&ticdeltacmds[(i - realstart) * netbuffer->u.serverpak.numslots],
+							netbuffer->u.serverpak.numslots*sizeof (ticcmd_t));
+					else
+#endif
 					pak = G_ScpyTiccmd(netcmds[i%TICQUEUE], pak,
 						netbuffer->u.serverpak.numslots*sizeof (ticcmd_t));
+#ifdef SATURNSYNCH
+					CL_RecordDeltaBase(i, netbuffer->u.serverpak.numslots);
+#endif
 
 					// copy the textcmds
 					numtxtpak = *txtpak++;
@@ -5789,6 +7686,17 @@ static void HandlePacketFromPlayer(SINT8 node)
 		case PT_WILLRESENDGAMESTATE:
 			PT_WillResendGamestate();
 			break;
+		case PT_ASKCONSISTENCY:
+			PT_AskConsistency();
+			break;
+		case PT_CONSISTENCYREPORT:
+			PT_ConsistencyReport(node);
+			break;
+		case PT_TICBATCH:
+			if (node != servernode)
+				break;
+			PT_TicBatch();
+			break;
 #endif
 #ifdef SATURNPAK
 		case PT_ISSATURN:
@@ -5803,6 +7711,102 @@ static void HandlePacketFromPlayer(SINT8 node)
 	} // end switch
 }
 
+/** Handles a packet from a viewer of this relay. Viewers are read-only:
+  * only what they say about the tics they have is used.
+  *
+  * \param node The packet sender
+  * \sa RL_SendTics
+  *
+  */
+static void RL_HandlePacketFromViewer(SINT8 node)
+{
+	tic_t realend;
+
+	switch (netbuffer->packettype)
+	{
+		case PT_CLIENTCMD:
+		case PT_CLIENT2CMD:
+		case PT_CLIENT3CMD:
+		case PT_CLIENT4CMD:
+		case PT_CLIENTMIS:
+		case PT_CLIENT2MIS:
+		case PT_CLIENT3MIS:
+		case PT_CLIENT4MIS:
+		case PT_NODEKEEPALIVE:
+		case PT_NODEKEEPALIVEMIS:
+#ifdef SATURNSYNCH
+		case PT_CLIENTBATCHCMD:
+		case PT_CLIENTBATCHMIS:
+#endif
+			realend = ExpandTics(netbuffer->u.clientpak.resendfrom, nettics[node]);
+
+			if (netbuffer->packettype == PT_CLIENTMIS || netbuffer->packettype == PT_CLIENT2MIS
+				|| netbuffer->packettype == PT_CLIENT3MIS || netbuffer->packettype == PT_CLIENT4MIS
+				|| netbuffer->packettype == PT_NODEKEEPALIVEMIS
+#ifdef SATURNSYNCH
+				|| netbuffer->packettype == PT_CLIENTBATCHMIS
+#endif
+				|| supposedtics[node] < realend)
+			{
+				supposedtics[node] = realend;
+			}
+			if (nettics[node] > realend)
+				break; // Out of order
+
+			nettics[node] = realend;
+			sendingsavegame[node] = false;
+			freezetimeout[node] = I_GetTime() + connectiontimeout;
+			break;
+		case PT_BASICKEEPALIVE:
+			sendingsavegame[node] = false;
+			freezetimeout[node] = I_GetTime() + connectiontimeout;
+			break;
+		case PT_NODETIMEOUT:
+		case PT_CLIENTQUIT:
+			Net_CloseConnection(node);
+			ResetNode(node);
+			break;
+		default:
+			break; // Chat and the like stay with the viewer
+	}
+}
+
+static void SV_SendTics(void);
+
+/** Passes the tics received from the real server on to this relay's
+  * viewers, and forgets the textcmds once every viewer has them.
+  *
+  * \sa SV_SendTics
+  *
+  */
+static void RL_SendTics(void)
+{
+	INT32 i;
+
+	firstticstosend = gametic;
+	for (i = 1; i < MAXNETNODES; i++)
+	{
+		if (!nodeingame[i] || i == servernode)
+			continue;
+
+		// Anything older has been written over by newer tics
+		if (neededtic - nettics[i] >= TICQUEUE - BACKUPTICS)
+		{
+			Net_ConnectionTimeout(i);
+			continue;
+		}
+
+		if (nettics[i] < firstticstosend)
+			firstticstosend = nettics[i];
+	}
+
+	for (; tictoclear < firstticstosend; tictoclear++)
+		D_FreeTextcmd(tictoclear);
+
+	maketic = neededtic;
+	SV_SendTics();
+}
+
 /**	Handles all received packets, if any
   *
   * \todo Add details to this description (lol)
@@ -5818,7 +7822,7 @@ static void GetPackets(void)
 	{
 		node = (SINT8)doomcom->remotenode;
 
-		if (netbuffer->packettype == PT_CLIENTJOIN && server)
+		if (netbuffer->packettype == PT_CLIENTJOIN && (server || (relay && cl_mode == CL_CONNECTED)))
 		{
 			if (!levelloading) // Otherwise just ignore
 			{
@@ -5856,7 +7860,9 @@ static void GetPackets(void)
 			++packetstat[netbuffer->packettype];
 
 		// Packet received from someone already playing
-		if (nodeingame[node])
+		if (nodeingame[node] && relay && node && node != servernode)
+			RL_HandlePacketFromViewer(node);
+		else if (nodeingame[node])
 			HandlePacketFromPlayer(node);
 		// Packet received from someone not playing
 		else
@@ -5883,6 +7889,17 @@ static INT16 Consistancy(void)
 
 	DEBFILE(va("TIC %u ", gametic));
 
+#ifdef SATURNSYNCH
+	if (cv_consistencyreport.value)
+	{
+		PS_START_TIMING(ps_consistency_time);
+		RecordConsistency();
+		PS_STOP_TIMING(ps_consistency_time);
+	}
+	else
+		ps_consistency_time.value.p = 0;
+#endif
+
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
 		if (!playeringame[i])
@@ -6047,6 +8064,48 @@ static void SV_SendServerKeepAlive(void)
 	}
 }
 
+#ifdef SATURNSYNCH
+/** Remembers this tic's cmds, and sends the last two batches' worth once
+  * the batch the server asked for is full
+  */
+static void CL_SendClientBatchCmd(boolean mis)
+{
+	clientbatchcmd_pak *pak = &netbuffer->u.clientbatchpak;
+	ticcmd_t *cmds;
+	UINT8 numplayers = 1, numtics, i;
+
+	if (splitscreen || botingame)
+		numplayers = (UINT8)(max(splitscreen, 1) + 1);
+
+	cmds = cl_cmdhistory[++cl_cmdseq % (2*MAXTICBATCH)];
+	cmds[0] = localcmds;
+	cmds[1] = localcmds2;
+	cmds[2] = localcmds3;
+	cmds[3] = localcmds4;
+
+	if (cl_cmdsqueued < 2*MAXTICBATCH)
+		cl_cmdsqueued++;
+
+	// A missed packet means the server needs our ack now
+	if (++cl_cmdsunsent < cl_ticbatch && !mis)
+		return;
+	cl_cmdsunsent = 0;
+
+	numtics = (UINT8)min(2*cl_ticbatch, cl_cmdsqueued);
+
+	netbuffer->packettype = (mis ? PT_CLIENTBATCHMIS : PT_CLIENTBATCHCMD);
+	pak->consistancy = SHORT(consistancy[gametic%TICQUEUE]);
+	pak->seq = (UINT16)SHORT(cl_cmdseq);
+	pak->numtics = numtics;
+	pak->numplayers = numplayers;
+
+	for (i = 0; i < numtics; i++)
+		G_MoveTiccmd(&pak->cmds[i*numplayers], cl_cmdhistory[(UINT16)(cl_cmdseq - numtics + 1 + i) % (2*MAXTICBATCH)], numplayers);
+
+	HSendPacket(servernode, false, 0, offsetof(clientbatchcmd_pak, cmds) + numtics*numplayers*sizeof (ticcmd_t));
+}
+#endif
+
 // send the client packet to the server
 static void CL_SendClientCmd(void)
 {
@@ -6064,13 +8123,17 @@ static void CL_SendClientCmd(void)
 	netbuffer->u.clientpak.resendfrom = (UINT8)(neededtic & UINT8_MAX);
 	netbuffer->u.clientpak.client_tic = (UINT8)(gametic & UINT8_MAX);
 
-	if (gamestate == GS_WAITINGPLAYERS)
+	if (gamestate == GS_WAITINGPLAYERS || viewonly)
 	{
 		// Send PT_NODEKEEPALIVE packet
 		netbuffer->packettype = (mis ? PT_NODEKEEPALIVEMIS : PT_NODEKEEPALIVE);
 		packetsize = sizeof (clientcmd_pak) - sizeof (ticcmd_t) - sizeof (INT16);
 		HSendPacket(servernode, false, 0, packetsize);
 	}
+#ifdef SATURNSYNCH
+	else if (cl_ticbatch && gamestate != GS_NULL)
+		CL_SendClientBatchCmd(mis);
+#endif
 	else if (gamestate != GS_NULL)
 	{
 		packetsize = sizeof (clientcmd_pak);
@@ -6101,7 +8164,7 @@ static void CL_SendClientCmd(void)
 		HSendPacket(servernode, false, 0, packetsize);
 	}
 
-	if (cl_mode == CL_CONNECTED || dedicated)
+	if ((cl_mode == CL_CONNECTED || dedicated) && !relay)
 	{
 		// Send extra data if needed
 		if (localtextcmd[0])
@@ -6153,6 +8216,10 @@ static void SV_SendTics(void)
 	UINT32 n;
 	INT32 j;
 	size_t packsize;
+#ifdef SATURNSYNCH
+	size_t deltasize;
+	boolean resend;
+#endif
 	UINT8 *bufpos;
 	UINT8 *ntextcmd;
 
@@ -6160,11 +8227,14 @@ static void SV_SendTics(void)
 	// for each node create a packet with x tics and send it
 	// x is computed using supposedtics[n], max packet size and maketic
 	for (n = 1; n < MAXNETNODES; n++)
-		if (nodeingame[n])
+		if (nodeingame[n] && (INT32)n != servernode) // On a relay, that's where the tics come from
 		{
 			// assert supposedtics[n]>=nettics[n]
 			realfirsttic = supposedtics[n];
 			lasttictosend = maketic;
+#ifdef SATURNSYNCH
+			resend = false;
+#endif
 
 			if (lasttictosend - nettics[n] >= BACKUPTICS)
 				lasttictosend = nettics[n] + BACKUPTICS-1;
@@ -6182,6 +8252,10 @@ static void SV_SendTics(void)
 					// all tic are ok
 					continue;
 				DEBFILE(va("Sent %d anyway\n", realfirsttic));
+#ifdef SATURNSYNCH
+				// The client may be stuck without the base it acked, e.g. after a gamestate
+				resend = true;
+#endif
 			}
 			if (realfirsttic < firstticstosend)
 				realfirsttic = firstticstosend;
@@ -6226,10 +8300,30 @@ static void SV_SendTics(void)
 			netbuffer->u.serverpak.numslots = (UINT8)SHORT(doomcom->numslots);
 			bufpos = (UINT8 *)&netbuffer->u.serverpak.cmds;
 
+#ifdef SATURNSYNCH
+			// Delta-encode for nodes that can read it, unless it comes out larger
+			if (can_receive_ticdelta[n]
+				&& (deltasize = SV_WriteDeltaTics(n, realfirsttic, lasttictosend, doomcom->numslots, resend))
+				< (lasttictosend - realfirsttic) * doomcom->numslots * sizeof (ticcmd_t))
+			{
+				netbuffer->packettype = PT_SERVERDELTATICS;
+				M_Memcpy(bufpos, ticdeltabuf, deltasize);
+				bufpos += deltasize;
+			}
+			else
+#endif
 			for (i = realfirsttic; i < lasttictosend; i++)
 			{
 				bufpos = G_DcpyTiccmd(bufpos, netcmds[i%TICQUEUE], doomcom->numslots * sizeof (ticcmd_t));
 			}
+			Net_CountTicCmds(n, false, lasttictosend - realfirsttic,
+				bufpos - (UINT8 *)&netbuffer->u.serverpak.cmds,
+				(lasttictosend - realfirsttic) * doomcom->numslots * sizeof (ticcmd_t));
+#ifdef SATURNSYNCH
+			if (ticdeltasent[n])
+				for (i = realfirsttic; i < lasttictosend; i++)
+					SV_RecordDeltaBase(n, i, doomcom->numslots);
+#endif
 
 			// add textcmds
 			for (i = realfirsttic; i < lasttictosend; i++)
@@ -6329,6 +8423,9 @@ static void SV_Maketic(void)
 		if (playerpernode[j])
 		{
 			INT32 player = nodetoplayer[j];
+#ifdef SATURNSYNCH
+			SV_FeedQueuedCmds(j);
+#endif
 			if ((netcmds[maketic%TICQUEUE][player].angleturn & TICCMD_RECEIVED) == 0)
 			{ // we didn't receive this tic
 				INT32 i;
@@ -6558,6 +8655,13 @@ static inline void PingUpdate(void)
 			HSendPacket(i, true, 0, sizeof(INT32) * (MAXPLAYERS+1));
 
 	pingmeasurecount = 0; //Reset count
+
+#ifdef SATURNSYNCH
+	// Now that the ping is fresh, tell each node how to send its tics
+	for (i = 1; i < MAXNETNODES; i++)
+		if (nodeingame[i])
+			SV_AdviseTicBatch(i);
+#endif
 }
 
 #undef PINGKICK_DANGER
@@ -6602,9 +8706,9 @@ static void RenewHolePunch(void)
 static void HandleNodeTimeouts(void)
 {
 	INT32 i;
-	if (server)
+	if (server || relay)
 		for (i = 1; i < MAXNETNODES; i++)
-			if (nodeingame[i] && freezetimeout[i] < I_GetTime())
+			if (nodeingame[i] && i != servernode && freezetimeout[i] < I_GetTime())
 				Net_ConnectionTimeout(i);
 }
 
@@ -6654,6 +8758,25 @@ void NetKeepAlive(void)
 	Net_AckTicker();
 	HandleNodeTimeouts();
 	SV_FileSendTicker();
+
+	if (I_NetFlush)
+		I_NetFlush();
+}
+
+/** Handles packets that arrived between tics, without making a tic
+  *
+  * A dedicated server woken up by a packet calls this, so acks and
+  * replies go out straight away rather than on the next tic.
+  */
+void NetUpdatePackets(void)
+{
+	if (!netgame)
+		return;
+
+	GetPackets();
+
+	if (I_NetFlush)
+		I_NetFlush();
 }
 
 // If a tree falls in the forest but nobody is around to hear it, does it make a tic?
@@ -6666,6 +8789,10 @@ void NetUpdate(void)
 	INT32 i;
 	INT32 realtics;
 
+	// Send anything queued since the last update (menus, keepalives...)
+	if (I_NetFlush)
+		I_NetFlush();
+
 	nowtime = I_GetTime();
 	realtics = nowtime - gametime;
 
@@ -6766,6 +8893,9 @@ void NetUpdate(void)
 		if (!resynch_local_inprogress)
 			CL_SendClientCmd(); // Send tic cmd
 
+		if (relay && cl_mode == CL_CONNECTED)
+			RL_SendTics();
+
 		hu_resynching = resynch_local_inprogress;
 #ifdef SATURNSYNCH
 		hu_redownloadinggamestate = cl_redownloadinggamestate;
@@ -6776,6 +8906,9 @@ void NetUpdate(void)
 		if (!demo.playback && realtics > 0)
 		{
 			INT32 counts;
+#ifdef PARANOIA
+			UINT32 textcmdallocsbefore, gamestateallocsbefore;
+#endif
 
 			hu_resynching = false;
 #ifdef SATURNSYNCH
@@ -6790,6 +8923,13 @@ void NetUpdate(void)
 			// Don't erase tics not acknowledged
 			counts = realtics;
 
+#ifdef PARANOIA
+			// A server tic only sends what is already queued: gamestates go out
+			// from the packet handlers, and textcmds are made as they arrive
+			textcmdallocsbefore = textcmdallocs;
+			gamestateallocsbefore = gamestateallocs;
+#endif
+
 			for (i = 0; i < MAXNETNODES; ++i)
 				if (resynch_inprogress[i])
 				{
@@ -6816,6 +8956,12 @@ void NetUpdate(void)
 			}
 			else
 				hu_resynching = true;
+
+#ifdef PARANOIA
+			if (textcmdallocs != textcmdallocsbefore || gamestateallocs != gamestateallocsbefore)
+				I_Error("Server tic allocated %u textcmd entries and %u gamestate buffers",
+					textcmdallocs - textcmdallocsbefore, gamestateallocs - gamestateallocsbefore);
+#endif
 		}
 	}
 	Net_AckTicker();
@@ -6833,6 +8979,13 @@ void NetUpdate(void)
 		CON_Ticker();
 	}
 	SV_FileSendTicker();
+
+	// Transfers hold their own references to it
+	if (savegamecache.raw && savegamecache.tic != gametic)
+		SV_ReleaseSaveGameCache();
+
+	if (I_NetFlush)
+		I_NetFlush();
 }
 
 /** Returns the number of players playing.
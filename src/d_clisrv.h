@@ -106,6 +106,15 @@ typedef enum
 
 	// we will reserve this for now even if unused, so order wont get mangled
 	PT_ISSATURN, 			// Saturn specific identifier packet
+
+	PT_ASKCONSISTENCY,    // Server, to client: "what did each part of your game look like on this tic?"
+	PT_CONSISTENCYREPORT, // Client, to server: "like this."
+
+	PT_TICBATCH,          // Server, to client: "bundle this many tics per packet."
+	PT_CLIENTBATCHCMD,    // Several tics of cmds, see cv_adaptivetics
+	PT_CLIENTBATCHMIS,    // Same as above with but saying resend from
+
+	PT_SERVERDELTATICS,   // PT_SERVERTICS with the cmds delta-encoded, see TICDELTA_VERSION
 #endif
 
 	NUMPACKETTYPE
@@ -114,10 +123,33 @@ typedef enum
 #ifdef PACKETDROP
 void Command_Drop(void);
 void Command_Droprate(void);
+void Command_NetSim(void);
 #endif
 #ifdef _DEBUG
 void Command_Numnodes(void);
 #endif
+void Command_Netstress(void);
+
+#ifdef SATURNSYNCH
+// Parts of the game hashed separately when cv_consistencyreport is on
+typedef enum
+{
+	CONSISTENCY_RNG,
+	CONSISTENCY_PLAYERS,
+	CONSISTENCY_MOBJS,
+	CONSISTENCY_THINKERS,
+	CONSISTENCY_POLYOBJS,
+	CONSISTENCY_LUA,
+	NUMCONSISTENCY
+} consistencycategory_t;
+
+#define CONSISTENCYHISTORY (2*TICRATE) // Tics of records kept for answering reports
+#define CONSISTENCYMOBJBLOCKS 128 // Mobjs are compared in blocks, in thinker order...
+#define CONSISTENCYMOBJBLOCKSIZE 32 // ...of this many; the last block takes the rest
+#define CONSISTENCYLUAVARS 32 // Lua variable names compared one by one
+
+#define MAXTICBATCH 8 // Most tics a client may be asked to bundle in one packet
+#endif
 
 #if defined(_MSC_VER)
 #pragma pack(1)
@@ -162,6 +194,21 @@ typedef struct
 	ticcmd_t cmd, cmd2, cmd3, cmd4;
 } ATTRPACK client4cmd_pak;
 
+#ifdef SATURNSYNCH
+// Batched client to server packet
+// WARNING: must start with the same fields as clientcmd_pak
+typedef struct
+{
+	UINT8 client_tic;
+	UINT8 resendfrom;
+	INT16 consistancy;
+	UINT16 seq; // Sequence number of the newest tic
+	UINT8 numtics;
+	UINT8 numplayers;
+	ticcmd_t cmds[2*MAXTICBATCH*4]; // Oldest tic first, numplayers (up to 4P) cmds per tic
+} ATTRPACK clientbatchcmd_pak;
+#endif
+
 #ifdef _MSC_VER
 #pragma warning(disable :  4200)
 #endif
@@ -364,6 +411,11 @@ typedef struct {
 
 #define MAXAPPLICATION 16
 
+#ifdef SATURNSYNCH
+// Bump when the PT_SERVERDELTATICS encoding changes
+#define TICDELTA_VERSION 2
+#endif
+
 typedef struct
 {
 	UINT8 _255;/* see serverinfo_pak */
@@ -376,6 +428,11 @@ typedef struct
 #ifdef SATURNJOIN
 	UINT8 issaturn;
 #endif
+	UINT8 compression; // NETCOMPRESS_* methods this client can decompress; older clients leave it out
+#ifdef SATURNSYNCH
+	UINT8 ticdelta; // TICDELTA_VERSION if this client reads PT_SERVERDELTATICS; older clients leave it out
+#endif
+	UINT8 viewer; // Joins only to watch, see -viewer; older clients leave it out
 } ATTRPACK clientconfig_pak;
 
 #define SV_SPEEDMASK 0x03		// used to send kartspeed
@@ -466,6 +523,40 @@ typedef struct
 	UINT8 files[MAXFILENEEDED]; // is filled with writexxx (byteptr.h)
 } ATTRPACK filesneededconfig_pak;
 
+#ifdef SATURNSYNCH
+// One mobj as seen on one tic
+typedef struct
+{
+	UINT32 hash;
+	UINT16 type;
+	fixed_t x, y, z;
+} ATTRPACK consistencymobj_t;
+
+// The server's mobj hashes for one tic, so the client can find the first block that differs
+typedef struct
+{
+	tic_t tic;
+	UINT16 firstmobj; // Where the first block starts
+	UINT32 mobjblock[CONSISTENCYMOBJBLOCKS];
+} ATTRPACK askconsistency_pak;
+
+// Per-subsystem hashes for one tic, and the client's side of what differs
+typedef struct
+{
+	tic_t tic;
+	UINT32 category[NUMCONSISTENCY];
+	UINT32 player[MAXPLAYERS];
+	UINT16 nummobjs;
+	UINT16 askedmobj; // firstmobj of the question; other than 0, only the mobjs are of interest
+	UINT16 firstmobj; // Index of mobj[0], or UINT16_MAX if every block matched
+	UINT8 nummobjentries;
+	consistencymobj_t mobj[CONSISTENCYMOBJBLOCKSIZE];
+	UINT8 numluavars;
+	UINT32 luaname[CONSISTENCYLUAVARS]; // Sorted name hashes...
+	UINT32 luavalue[CONSISTENCYLUAVARS]; // ...and the values under that name, all objects summed
+} ATTRPACK consistencyreport_pak;
+#endif
+
 //
 // Network packet data
 //
@@ -483,11 +574,20 @@ typedef struct
 		client2cmd_pak client2pak;          //         202 bytes
 		client3cmd_pak client3pak;          //         258 bytes(?)
 		client4cmd_pak client4pak;          //         316 bytes(?)
+#ifdef SATURNSYNCH
+		clientbatchcmd_pak clientbatchpak;  //         712 bytes
+		UINT8 ticbatch;                     //           1 byte
+#endif
 		servertics_pak serverpak;           //      132495 bytes (more around 360, no?)
 		serverconfig_pak servercfg;         //         773 bytes
 		resynchend_pak resynchend;          //
 		resynch_pak resynchpak;             //
 		UINT8 resynchgot;                   //
+		UINT32 gamestatebase;               //           4 bytes
+#ifdef SATURNSYNCH
+		askconsistency_pak askconsistency;  //         518 bytes
+		consistencyreport_pak consistencyreport; //    932 bytes
+#endif
 		UINT8 textcmd[MAXTEXTCMD+1];        //       66049 bytes (wut??? 64k??? More like 257 bytes...)
 		filetx_pak filetxpak;               //         139 bytes
 		clientconfig_pak clientcfg;         //         153 bytes
@@ -507,10 +607,13 @@ typedef struct
 #pragma pack()
 #endif
 
-#define MAXSERVERLIST (MAXNETNODES-1)
+// Servers from the master server don't take up nodes until one is
+// picked (see CL_ServerListNode), so the list isn't bound by MAXNETNODES.
+#define MAXSERVERLIST 512
 typedef struct
 {
-	SINT8 node;
+	SINT8 node; // -1 if it hasn't been given one yet
+	INT16 query; // query socket slot it answered on, -1 if it answered a node
 	serverinfo_pak info;
 } serverelem_t;
 
@@ -523,6 +626,7 @@ extern INT32 mapchangepending;
 extern doomdata_t *netbuffer;
 extern consvar_t cv_stunserver;
 extern consvar_t cv_httpsource;
+extern consvar_t cv_httpdownloads;
 extern consvar_t cv_kicktime;
 
 extern consvar_t cv_showjoinaddress;
@@ -563,12 +667,15 @@ extern boolean server;
 extern boolean serverrunning;
 #define client (!server)
 extern boolean dedicated; // For dedicated server
+extern boolean relay;
+extern boolean viewonly;
 extern UINT16 software_MAXPACKETLENGTH;
 extern boolean acceptnewnode;
 extern SINT8 servernode;
 extern char connectedservername[MAXSERVERNAME+1];
 
 void Command_Ping_f(void);
+void Command_NetStat(void);
 extern tic_t connectiontimeout;
 extern tic_t jointimeout;
 extern UINT16 pingmeasurecount;
@@ -580,18 +687,22 @@ extern consvar_t
 #ifdef VANILLAJOINNEXTROUND
 	cv_joinnextround,
 #endif
-	cv_netticbuffer, cv_allownewplayer,
+	cv_netticbuffer, cv_allownewplayer, cv_allowrelays,
 #ifdef SATURNJOIN
 	cv_allownewsaturnplayer,
 #endif
 	cv_joinrefusemessage, cv_maxplayers, cv_resynchattempts,
 #ifdef SATURNSYNCH
-	cv_resynchcooldown, cv_gamestateattempts,
+	cv_resynchcooldown, cv_gamestateattempts, cv_consistencyreport,
+	cv_adaptivetics, cv_adaptivetics_maxbatch, cv_adaptivetics_maxlead,
 #endif
-	cv_blamecfail, cv_maxsend, cv_noticedownload, cv_downloadspeed;
+	cv_blamecfail, cv_maxsend, cv_noticedownload, cv_downloadspeed,
+	cv_netcompression, cv_netcompressionlevel;
 
 extern consvar_t cv_connectawaittime;
 
+extern consvar_t cv_netmetrics_file, cv_netmetrics_interval;
+
 extern consvar_t cv_discordinvites;
 
 // Used in d_net, the only dependence
@@ -608,6 +719,7 @@ void SendNetXCmd4(netxcmd_t id, const void *param, size_t nparam); // splitsreen
 // Create any new ticcmds and broadcast to other players.
 void NetKeepAlive(void);
 void NetUpdate(void);
+void NetUpdatePackets(void);
 
 void SV_StartSinglePlayerServer(void);
 boolean SV_SpawnServer(void);
@@ -622,6 +734,7 @@ void CL_RemovePlayer(INT32 playernum, INT32 reason);
 void CL_QueryServerList(msg_server_t *list);
 void CL_UpdateServerList(void);
 void CL_TimeoutServerList(void);
+SINT8 CL_ServerListNode(UINT32 i);
 // Is there a game running
 boolean Playing(void);
 
@@ -42,6 +42,7 @@
 #include "i_sound.h"
 #include "i_system.h"
 #include "i_time.h"
+#include "i_net.h" // I_NetWait
 #include "i_threads.h"
 #include "i_video.h"
 #include "m_argv.h"
@@ -150,6 +151,8 @@ event_t events[MAXEVENTS];
 INT32 eventhead, eventtail;
 
 boolean dedicated = false;
+INT32 serverinstance = 0;
+static INT32 numserverinstances = 1;
 
 boolean loaded_config = false;
 
@@ -713,6 +716,13 @@ void D_SRB2Loop(void)
 
 		I_UpdateTime(cv_timescale.value);
 
+		// benchdemo runs game logic flat out; no frames, no frame cap
+		if (demo.benchmark)
+		{
+			G_BenchmarkTicker();
+			continue;
+		}
+
 		if (lastwipetic)
 		{
 			oldentertics = lastwipetic;
@@ -895,7 +905,14 @@ void D_SRB2Loop(void)
 			// in the case of "match refresh rate" + vsync, don't sleep at all
 			const boolean vsync_with_match_refresh = cv_vidwait.value && cv_fpscap.value == 0;
 
-			if (elapsed > 0 && (INT64)capbudget > elapsed && !vsync_with_match_refresh)
+			if (dedicated && I_NetWait)
+			{
+				// Sleep on the sockets until the next tic is due, and deal
+				// with anything that arrives in the meantime right away
+				if (I_NetWait(I_GetTimeUntilNextTic(cv_timescale.value)))
+					NetUpdatePackets();
+			}
+			else if (elapsed > 0 && (INT64)capbudget > elapsed && !vsync_with_match_refresh)
 			{
 				I_SleepDuration(capbudget - (finishprecise - enterprecise));
 			}
@@ -1401,7 +1418,15 @@ void D_SRB2Main(void)
 #endif
 
 	// for dedicated server
+#ifdef DEDICATED
+	dedicated = true; // headless build, there is nothing else to run
+#else
 	dedicated = M_CheckParm("-dedicated") != 0;
+#endif
+
+	// A relay is a client of the real server, even when it's headless
+	relay = M_CheckParm("-relay") != 0;
+	viewonly = relay || M_CheckParm("-viewer");
 
 	strcpy(title, "SRB2Kart");
 	strcpy(srb2, "SRB2Kart");
@@ -1519,7 +1544,7 @@ void D_SRB2Main(void)
 
 	// get map from parms
 
-	if (M_CheckParm("-server") || dedicated)
+	if ((M_CheckParm("-server") || dedicated) && !relay)
 		netgame = server = true;
 
 	CONS_Printf("Z_Init(): Init zone memory allocation daemon. \n");
@@ -1882,6 +1907,18 @@ void D_SRB2Main(void)
 		}
 	}
 
+	// Split into several dedicated servers now that the addons are loaded,
+	// so the lumps, caches and Lua loaded so far are only in memory once
+	if (dedicated && M_CheckParm("-instances") && M_IsNextParm())
+	{
+		numserverinstances = min(max(atoi(M_GetNextParm()), 1), MAXNETNODES);
+		if (numserverinstances > 1)
+		{
+			serverinstance = I_ForkInstances(numserverinstances);
+			CONS_Printf("Running as server instance %d of %d.\n", serverinstance+1, numserverinstances);
+		}
+	}
+
 	// init all NETWORK
 	CONS_Printf("D_CheckNetGame(): Checking network game status.\n");
 	if (D_CheckNetGame())
@@ -1905,7 +1942,11 @@ void D_SRB2Main(void)
 
 	// user settings come before "+" parameters.
 	if (dedicated)
+	{
 		COM_ImmedExecute(va("exec \"%s"PATHSEP"kartserv.cfg\"\n", srb2home));
+		if (numserverinstances > 1)
+			COM_ImmedExecute(va("exec \"%s"PATHSEP"kartserv%d.cfg\" -noerror\n", srb2home, serverinstance+1));
+	}
 	else
 		COM_ImmedExecute(va("exec \"%s"PATHSEP"kartexec.cfg\" -noerror\n", srb2home));
 
@@ -1916,6 +1957,8 @@ void D_SRB2Main(void)
 	p = M_CheckParm("-playdemo");
 	if (!p)
 		p = M_CheckParm("-timedemo");
+	if (!p)
+		p = M_CheckParm("-benchdemo");
 	if (p && M_IsNextParm())
 	{
 		char tmp[MAX_WADPATH];
@@ -1940,6 +1983,11 @@ void D_SRB2Main(void)
 			demo.quitafterplaying = true; // quit after one demo
 			G_DeferedPlayDemo(tmp);
 		}
+		else if (M_CheckParm("-benchdemo"))
+		{
+			demo.quitafterplaying = true; // print the report and quit
+			G_BenchDemo(tmp);
+		}
 		else
 			G_TimeDemo(tmp);
 
@@ -2069,7 +2117,7 @@ void D_SRB2Main(void)
 
 	CON_ToggleOff();
 
-	if (dedicated && server)
+	if (dedicated && server && !relay)
 	{
 		pagename = "TITLESKY";
 		levelstarttic = gametic;
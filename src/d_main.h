@@ -22,6 +22,8 @@ extern tic_t rendergametic;
 
 extern boolean loaded_config;
 
+extern INT32 serverinstance; // Which of the -instances servers this process is, from 0
+
 extern char srb2home[256]; //Alam: My Home
 extern boolean usehome; //Alam: which path?
 extern const char *pandf; //Alam: how to path?
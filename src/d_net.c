@@ -71,6 +71,8 @@ boolean (*I_NetGet)(void) = NULL;
 void (*I_NetSend)(void) = NULL;
 boolean (*I_NetCanSend)(void) = NULL;
 boolean (*I_NetCanGet)(void) = NULL;
+void (*I_NetFlush)(void) = NULL;
+boolean (*I_NetWait)(precise_t timeout) = NULL;
 void (*I_NetCloseSocket)(void) = NULL;
 void (*I_NetFreeNodenum)(INT32 nodenum) = NULL;
 SINT8 (*I_NetMakeNodewPort)(const char *address, const char* port) = NULL;
@@ -79,6 +81,12 @@ void (*I_NetRequestHolePunch)(INT32 node) = NULL;
 void (*I_NetRegisterHolePunch)(void) = NULL;
 #endif
 boolean (*I_NetOpenSocket)(void) = NULL;
+boolean (*I_NetQueryAddress)(INT32 slot, const char *address, const char *port) = NULL;
+void (*I_NetQuerySend)(INT32 slot) = NULL;
+INT32 (*I_NetQueryGet)(void) = NULL;
+#ifdef HOLEPUNCH
+void (*I_NetQueryHolePunch)(INT32 slot) = NULL;
+#endif
 boolean (*I_Ban) (INT32 node) = NULL;
 void (*I_ClearBans)(void) = NULL;
 const char *(*I_GetNodeAddress) (INT32 node) = NULL;
@@ -141,6 +149,407 @@ boolean Net_GetNetStat(void)
 	return 0;
 }
 
+// -----------------------------------------------------------------
+// Per-node telemetry, kept in one second samples so that "netstat"
+// can show recent history, and optionally exported for scraping
+// -----------------------------------------------------------------
+#define NETSTATHISTORY 60 // Seconds of samples kept per node
+#define NETSTATRECENT 10 // Seconds averaged for the netstat summary
+
+enum
+{
+	NETSTAT_IN,
+	NETSTAT_OUT,
+	NUMNETSTATDIRS
+};
+
+typedef struct
+{
+	UINT32 bytes[NUMNETSTATDIRS];
+	UINT32 rttsum; // In milliseconds, over rttcount acks
+	UINT16 rttcount;
+	UINT16 retransmits;
+} netstatsample_t;
+
+typedef struct
+{
+	boolean active; // Has sent or received anything since the node was reset
+
+	UINT64 bytes[NUMNETSTATDIRS];
+	UINT32 packets[NUMNETSTATDIRS];
+	UINT64 textcmdbytes[NUMNETSTATDIRS];
+	UINT64 filebytes[NUMNETSTATDIRS];
+	UINT64 ticcmdbytes[NUMNETSTATDIRS]; // As sent, delta-encoded or not
+	UINT64 ticcmdplainbytes[NUMNETSTATDIRS]; // What they would take without delta-encoding
+	UINT32 ticcmdtics[NUMNETSTATDIRS];
+	UINT32 retransmits, duplicates;
+	UINT64 rttsum; // In milliseconds, over rttcount acks
+	UINT32 rttcount, rttmax;
+
+	netstatsample_t current; // The second being counted
+	netstatsample_t history[NETSTATHISTORY];
+	UINT8 historyhead, historylen;
+} netnodestat_t;
+
+static netnodestat_t netnodestats[MAXNETNODES];
+static UINT64 netstattypebytes[NUMPACKETTYPE][NUMNETSTATDIRS];
+static UINT32 netstattypepackets[NUMPACKETTYPE][NUMNETSTATDIRS];
+static tic_t netstatsampletic, netmetricstic;
+
+static void NetStat_Count(INT32 node, UINT8 packettype, size_t length, INT32 dir)
+{
+	netnodestat_t *stat;
+
+	if (packettype < NUMPACKETTYPE)
+	{
+		netstattypebytes[packettype][dir] += length;
+		netstattypepackets[packettype][dir]++;
+	}
+
+	if (node < 0 || node >= MAXNETNODES) // Broadcasts
+		return;
+
+	stat = &netnodestats[node];
+	stat->active = true;
+	stat->bytes[dir] += length;
+	stat->packets[dir]++;
+	stat->current.bytes[dir] += (UINT32)length;
+
+	if (packettype >= PT_TEXTCMD && packettype <= PT_TEXTCMD4)
+		stat->textcmdbytes[dir] += length;
+	else if (packettype == PT_FILEFRAGMENT)
+		stat->filebytes[dir] += length;
+}
+
+void Net_CountTicCmds(INT32 node, boolean incoming, tic_t numtics, size_t length, size_t plainlength)
+{
+	netnodestat_t *stat = &netnodestats[node];
+	const INT32 dir = incoming ? NETSTAT_IN : NETSTAT_OUT;
+
+	stat->ticcmdbytes[dir] += length;
+	stat->ticcmdplainbytes[dir] += plainlength;
+	stat->ticcmdtics[dir] += numtics;
+}
+
+static void NetStat_CountAck(INT32 node, precise_t senttime)
+{
+	netnodestat_t *stat = &netnodestats[node];
+	const UINT32 ms = (UINT32)((I_GetPreciseTime() - senttime) * 1000 / I_GetPrecisePrecision());
+
+	stat->rttsum += ms;
+	stat->rttcount++;
+	if (ms > stat->rttmax)
+		stat->rttmax = ms;
+
+	stat->current.rttsum += ms;
+	if (stat->current.rttcount < UINT16_MAX)
+		stat->current.rttcount++;
+}
+
+static void NetStat_CountRetransmit(INT32 node)
+{
+	netnodestats[node].retransmits++;
+	if (netnodestats[node].current.retransmits < UINT16_MAX)
+		netnodestats[node].current.retransmits++;
+}
+
+static void NetStat_ResetNode(INT32 node)
+{
+	memset(&netnodestats[node], 0, sizeof (netnodestats[node]));
+}
+
+// Sums up to the last count seconds of a node's samples
+static INT32 NetStat_SumRecent(INT32 node, INT32 count, netstatsample_t *sum)
+{
+	const netnodestat_t *stat = &netnodestats[node];
+	INT32 i, n;
+
+	memset(sum, 0, sizeof (*sum));
+	n = min(count, stat->historylen);
+	for (i = 0; i < n; i++)
+	{
+		const netstatsample_t *s = &stat->history[(stat->historyhead + NETSTATHISTORY - 1 - i) % NETSTATHISTORY];
+		sum->bytes[NETSTAT_IN] += s->bytes[NETSTAT_IN];
+		sum->bytes[NETSTAT_OUT] += s->bytes[NETSTAT_OUT];
+		sum->rttsum += s->rttsum;
+		sum->rttcount += s->rttcount;
+		sum->retransmits += s->retransmits;
+	}
+	return n;
+}
+
+static const char *NetStat_NodeName(INT32 node)
+{
+	if (nodetoplayer[node] >= 0 && nodetoplayer[node] < MAXPLAYERS && playeringame[nodetoplayer[node]])
+		return player_names[nodetoplayer[node]];
+	return (node == servernode && !server) ? "(server)" : "-";
+}
+
+/** Opens the metrics file for writing, beside where it will end up
+  * so that scrapers never see it half written
+  */
+static FILE *NetStat_OpenMetrics(char path[MAX_WADPATH], char tmppath[MAX_WADPATH+4])
+{
+	const size_t len = MAX_WADPATH;
+	const char *ext = strrchr(cv_netmetrics_file.string, '.');
+
+	// Each -instances server gets its own file
+	if (serverinstance && ext)
+		snprintf(path, len, "%s" PATHSEP "%.*s-%d%s", srb2home,
+			(int)(ext - cv_netmetrics_file.string), cv_netmetrics_file.string, serverinstance+1, ext);
+	else if (serverinstance)
+		snprintf(path, len, "%s" PATHSEP "%s-%d", srb2home, cv_netmetrics_file.string, serverinstance+1);
+	else
+		snprintf(path, len, "%s" PATHSEP "%s", srb2home, cv_netmetrics_file.string);
+	snprintf(tmppath, MAX_WADPATH+4, "%s.tmp", path);
+
+	return fopen(tmppath, "w");
+}
+
+static void NetStat_WriteFamily(FILE *f, const char *name, const char *type, const char *help)
+{
+	fprintf(f, "# HELP srb2kart_%s %s\n# TYPE srb2kart_%s %s\n", name, help, name, type);
+}
+
+static void NetStat_WriteNodeCounter(FILE *f, const char *name, const char *help, size_t offset, boolean perdir)
+{
+	static const char *dirnames[NUMNETSTATDIRS] = {"in", "out"};
+	INT32 node, dir;
+
+	NetStat_WriteFamily(f, name, "counter", help);
+	for (node = 0; node < MAXNETNODES; node++)
+	{
+		const UINT8 *stat = (const UINT8 *)&netnodestats[node];
+
+		if (!netnodestats[node].active)
+			continue;
+
+		if (!perdir)
+		{
+			fprintf(f, "srb2kart_%s{server=\"%d\",node=\"%d\"} %u\n", name, serverinstance+1, node,
+				*(const UINT32 *)(stat + offset));
+			continue;
+		}
+
+		for (dir = 0; dir < NUMNETSTATDIRS; dir++)
+			fprintf(f, "srb2kart_%s{server=\"%d\",node=\"%d\",direction=\"%s\"} %s\n", name, serverinstance+1, node,
+				dirnames[dir], sizeu1((size_t)((const UINT64 *)(stat + offset))[dir]));
+	}
+}
+
+static void NetStat_WriteMetrics(void)
+{
+	static const char *dirnames[NUMNETSTATDIRS] = {"in", "out"};
+	char path[MAX_WADPATH], tmppath[MAX_WADPATH+4];
+	FILE *f = NetStat_OpenMetrics(path, tmppath);
+	INT32 node, type, dir, numactive = 0;
+
+	if (!f)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Couldn't write network metrics to %s, turning netmetrics_file off\n"), path);
+		CV_StealthSet(&cv_netmetrics_file, "");
+		return;
+	}
+
+	for (node = 0; node < MAXNETNODES; node++)
+		if (netnodestats[node].active)
+			numactive++;
+
+	NetStat_WriteFamily(f, "net_nodes", "gauge", "Nodes that have sent or received anything since connecting.");
+	fprintf(f, "srb2kart_net_nodes{server=\"%d\"} %d\n", serverinstance+1, numactive);
+
+	NetStat_WriteNodeCounter(f, "net_node_bytes_total", "Bytes sent to and received from a node, headers included.",
+		offsetof(netnodestat_t, bytes), true);
+	NetStat_WriteNodeCounter(f, "net_node_textcmd_bytes_total", "Bytes of text command packets.",
+		offsetof(netnodestat_t, textcmdbytes), true);
+	NetStat_WriteNodeCounter(f, "net_node_file_bytes_total", "Bytes of file transfer fragments.",
+		offsetof(netnodestat_t, filebytes), true);
+	NetStat_WriteNodeCounter(f, "net_node_retransmits_total", "Reliable packets resent to a node for lack of an ack.",
+		offsetof(netnodestat_t, retransmits), false);
+	NetStat_WriteNodeCounter(f, "net_node_duplicates_total", "Reliable packets received from a node more than once.",
+		offsetof(netnodestat_t, duplicates), false);
+
+	NetStat_WriteFamily(f, "net_node_packets_total", "counter", "Packets sent to and received from a node.");
+	for (node = 0; node < MAXNETNODES; node++)
+		if (netnodestats[node].active)
+			for (dir = 0; dir < NUMNETSTATDIRS; dir++)
+				fprintf(f, "srb2kart_net_node_packets_total{server=\"%d\",node=\"%d\",direction=\"%s\"} %u\n",
+					serverinstance+1, node, dirnames[dir], netnodestats[node].packets[dir]);
+
+	// Acks that had to be resent are left out, since it's unknown which send they answer
+	NetStat_WriteFamily(f, "net_node_ack_rtt_seconds", "summary", "Time from sending a reliable packet to getting its ack back.");
+	for (node = 0; node < MAXNETNODES; node++)
+		if (netnodestats[node].active)
+		{
+			fprintf(f, "srb2kart_net_node_ack_rtt_seconds_sum{server=\"%d\",node=\"%d\"} %.3f\n",
+				serverinstance+1, node, netnodestats[node].rttsum / 1000.0);
+			fprintf(f, "srb2kart_net_node_ack_rtt_seconds_count{server=\"%d\",node=\"%d\"} %u\n",
+				serverinstance+1, node, netnodestats[node].rttcount);
+		}
+
+	NetStat_WriteFamily(f, "net_packet_bytes_total", "counter", "Bytes sent and received by packet type, headers included.");
+	for (type = 0; type < NUMPACKETTYPE; type++)
+		for (dir = 0; dir < NUMNETSTATDIRS; dir++)
+			if (netstattypepackets[type][dir])
+				fprintf(f, "srb2kart_net_packet_bytes_total{server=\"%d\",type=\"%s\",direction=\"%s\"} %s\n",
+					serverinstance+1, Net_GetPacketName((UINT8)type), dirnames[dir], sizeu1((size_t)netstattypebytes[type][dir]));
+
+	NetStat_WriteFamily(f, "net_packets_total", "counter", "Packets sent and received by packet type.");
+	for (type = 0; type < NUMPACKETTYPE; type++)
+		for (dir = 0; dir < NUMNETSTATDIRS; dir++)
+			if (netstattypepackets[type][dir])
+				fprintf(f, "srb2kart_net_packets_total{server=\"%d\",type=\"%s\",direction=\"%s\"} %u\n",
+					serverinstance+1, Net_GetPacketName((UINT8)type), dirnames[dir], netstattypepackets[type][dir]);
+
+	fclose(f);
+#ifdef _WIN32
+	remove(path); // rename won't replace it here
+#endif
+	if (rename(tmppath, path) != 0)
+		remove(tmppath);
+}
+
+// Closes off a second of samples every second, and writes the metrics file when due
+static void NetStat_Ticker(void)
+{
+	const tic_t t = I_GetTime();
+	INT32 node;
+
+	if (t - netstatsampletic < TICRATE)
+		return;
+	netstatsampletic = t;
+
+	for (node = 0; node < MAXNETNODES; node++)
+	{
+		netnodestat_t *stat = &netnodestats[node];
+
+		if (!stat->active)
+			continue;
+
+		stat->history[stat->historyhead] = stat->current;
+		stat->historyhead = (UINT8)((stat->historyhead + 1) % NETSTATHISTORY);
+		if (stat->historylen < NETSTATHISTORY)
+			stat->historylen++;
+		memset(&stat->current, 0, sizeof (stat->current));
+	}
+
+	if (cv_netmetrics_file.string[0]
+		&& t - netmetricstic >= (tic_t)cv_netmetrics_interval.value * TICRATE)
+	{
+		netmetricstic = t;
+		NetStat_WriteMetrics();
+	}
+}
+
+static double NetStat_PerTic(UINT64 bytes, UINT32 tics)
+{
+	return tics ? (double)bytes / tics : 0.0;
+}
+
+static void Command_NetStat_Node(INT32 node)
+{
+	const netnodestat_t *stat = &netnodestats[node];
+	INT32 i;
+
+	CONS_Printf(M_GetText("Node %d (%s), last %d seconds, newest first:\n"), node, NetStat_NodeName(node), stat->historylen);
+	CONS_Printf("  In B/s  Out B/s  RTT ms  Resent\n");
+	for (i = 0; i < stat->historylen; i++)
+	{
+		const netstatsample_t *s = &stat->history[(stat->historyhead + NETSTATHISTORY - 1 - i) % NETSTATHISTORY];
+
+		if (s->rttcount)
+			CONS_Printf("%8u %8u %7u %7u\n", s->bytes[NETSTAT_IN], s->bytes[NETSTAT_OUT], s->rttsum / s->rttcount, s->retransmits);
+		else
+			CONS_Printf("%8u %8u %7s %7u\n", s->bytes[NETSTAT_IN], s->bytes[NETSTAT_OUT], "-", s->retransmits);
+	}
+
+	CONS_Printf(M_GetText("Totals: %s bytes in, %s out, %u packets in, %u out\n"),
+		sizeu1((size_t)stat->bytes[NETSTAT_IN]), sizeu2((size_t)stat->bytes[NETSTAT_OUT]),
+		stat->packets[NETSTAT_IN], stat->packets[NETSTAT_OUT]);
+	CONS_Printf(M_GetText("Text commands: %s bytes in, %s out\n"),
+		sizeu1((size_t)stat->textcmdbytes[NETSTAT_IN]), sizeu2((size_t)stat->textcmdbytes[NETSTAT_OUT]));
+	CONS_Printf(M_GetText("Files: %s bytes in, %s out\n"),
+		sizeu1((size_t)stat->filebytes[NETSTAT_IN]), sizeu2((size_t)stat->filebytes[NETSTAT_OUT]));
+	CONS_Printf(M_GetText("Tic commands: %.1f bytes per tic in, %.1f out; %.1f and %.1f without deltas\n"),
+		NetStat_PerTic(stat->ticcmdbytes[NETSTAT_IN], stat->ticcmdtics[NETSTAT_IN]),
+		NetStat_PerTic(stat->ticcmdbytes[NETSTAT_OUT], stat->ticcmdtics[NETSTAT_OUT]),
+		NetStat_PerTic(stat->ticcmdplainbytes[NETSTAT_IN], stat->ticcmdtics[NETSTAT_IN]),
+		NetStat_PerTic(stat->ticcmdplainbytes[NETSTAT_OUT], stat->ticcmdtics[NETSTAT_OUT]));
+	CONS_Printf(M_GetText("%u resent, %u duplicates, ack RTT %u ms mean, %u ms max\n"),
+		stat->retransmits, stat->duplicates,
+		stat->rttcount ? (UINT32)(stat->rttsum / stat->rttcount) : 0, stat->rttmax);
+}
+
+static void Command_NetStat_Types(void)
+{
+	INT32 type;
+
+	CONS_Printf("%-20s %10s %12s %10s %12s\n", "Packet", "In", "In bytes", "Out", "Out bytes");
+	for (type = 0; type < NUMPACKETTYPE; type++)
+	{
+		if (!netstattypepackets[type][NETSTAT_IN] && !netstattypepackets[type][NETSTAT_OUT])
+			continue;
+		CONS_Printf("%-20s %10u %12s %10u %12s\n", Net_GetPacketName((UINT8)type),
+			netstattypepackets[type][NETSTAT_IN], sizeu1((size_t)netstattypebytes[type][NETSTAT_IN]),
+			netstattypepackets[type][NETSTAT_OUT], sizeu2((size_t)netstattypebytes[type][NETSTAT_OUT]));
+	}
+}
+
+void Command_NetStat(void)
+{
+	INT32 node;
+	boolean any = false;
+
+	if (COM_Argc() > 1)
+	{
+		const char *arg = COM_Argv(1);
+
+		if (!stricmp(arg, "types"))
+			Command_NetStat_Types();
+		else if (!stricmp(arg, "reset"))
+		{
+			for (node = 0; node < MAXNETNODES; node++)
+				NetStat_ResetNode(node);
+			memset(netstattypebytes, 0, sizeof (netstattypebytes));
+			memset(netstattypepackets, 0, sizeof (netstattypepackets));
+		}
+		else
+		{
+			node = atoi(arg);
+			if (node < 0 || node >= MAXNETNODES || !netnodestats[node].active)
+				CONS_Printf(M_GetText("netstat [<node>|types|reset]: shows network traffic per node, or per packet type\n"));
+			else
+				Command_NetStat_Node(node);
+		}
+		return;
+	}
+
+	CONS_Printf(M_GetText("Averaged over the last %d seconds:\n"), NETSTATRECENT);
+	CONS_Printf("Node %-16s %8s %8s %7s %6s %6s %10s %10s\n",
+		"Player", "In B/s", "Out B/s", "RTT ms", "Resent", "Dupes", "Cmd bytes", "File bytes");
+	for (node = 0; node < MAXNETNODES; node++)
+	{
+		const netnodestat_t *stat = &netnodestats[node];
+		netstatsample_t sum;
+		INT32 n;
+
+		if (!stat->active)
+			continue;
+
+		n = max(NetStat_SumRecent(node, NETSTATRECENT, &sum), 1);
+		CONS_Printf("%4d %-16.16s %8u %8u %7s %6u %6u %10s %10s\n", node, NetStat_NodeName(node),
+			sum.bytes[NETSTAT_IN] / n, sum.bytes[NETSTAT_OUT] / n,
+			sum.rttcount ? va("%u", sum.rttsum / sum.rttcount) : "-",
+			stat->retransmits, stat->duplicates,
+			sizeu1((size_t)(stat->textcmdbytes[NETSTAT_IN] + stat->textcmdbytes[NETSTAT_OUT])),
+			sizeu2((size_t)(stat->filebytes[NETSTAT_IN] + stat->filebytes[NETSTAT_OUT])));
+		any = true;
+	}
+
+	if (!any)
+		CONS_Printf(M_GetText("No network traffic yet.\n"));
+}
+
 // -----------------------------------------------------------------
 // Some structs and functions for acknowledgement of packets
 // -----------------------------------------------------------------
@@ -156,6 +565,7 @@ typedef struct
 	UINT8 nextacknum;
 	UINT8 destinationnode; // The node to send the ack to
 	tic_t senttime; // The time when the ack was sent
+	precise_t sentprecise; // The same, for measuring the round trip
 	UINT16 length; // The packet size
 	UINT16 resentnum; // The number of times the ack has been resent
 	union {
@@ -197,6 +607,8 @@ typedef struct
 	UINT8 nextacknum;
 
 	UINT8 flags;
+
+	UINT16 resends; // Packets resent since Net_TakeNodeResends last looked
 } node_t;
 
 static node_t nodes[MAXNETNODES];
@@ -260,6 +672,7 @@ static boolean GetFreeAcknum(UINT8 *freeack, boolean lowtimer)
 			else
 			{
 				ackpak[i].senttime = I_GetTime();
+				ackpak[i].sentprecise = I_GetPreciseTime();
 				ackpak[i].resentnum = 0;
 			}
 			M_Memcpy(ackpak[i].pak.raw, netbuffer, ackpak[i].length);
@@ -342,6 +755,9 @@ static boolean Processackpak(void)
 			if (ackpak[i].acknum && ackpak[i].destinationnode == node - nodes
 				&& cmpack(ackpak[i].acknum, netbuffer->ackreturn) <= 0)
 			{
+				// A resent packet's ack could answer either send, so don't time it
+				if (!ackpak[i].resentnum)
+					NetStat_CountAck(ackpak[i].destinationnode, ackpak[i].sentprecise);
 				RemoveAck(i);
 			}
 	}
@@ -355,6 +771,7 @@ static boolean Processackpak(void)
 		{
 			DEBFILE(va("Discard(1) ack %d (duplicated)\n", ack));
 			duppacket++;
+			netnodestats[node - nodes].duplicates++;
 			goodpacket = false; // Discard packet (duplicate)
 		}
 		else
@@ -365,6 +782,7 @@ static boolean Processackpak(void)
 				{
 					DEBFILE(va("Discard(2) ack %d (duplicated)\n", ack));
 					duppacket++;
+					netnodestats[node - nodes].duplicates++;
 					goodpacket = false; // Discard packet (duplicate)
 					break;
 				}
@@ -451,6 +869,41 @@ void Net_SendAcks(INT32 node)
 #endif
 }
 
+/** Counts the packets sent to a node that it hasn't acknowledged yet
+  *
+  * \param node The node to check
+  * \return The number of packets waiting on an ack from it
+  *
+  */
+INT32 Net_GetNodeUnacked(INT32 node)
+{
+#ifdef NONET
+	(void)node;
+	return 0;
+#else
+	INT32 i, n = 0;
+
+	for (i = 0; i < MAXACKPACKETS; i++)
+		if (ackpak[i].acknum && ackpak[i].destinationnode == node)
+			n++;
+
+	return n;
+#endif
+}
+
+/** Tells how many packets had to be resent to a node since the last call
+  *
+  * \param node The node to check
+  * \return The number of resends, which is then reset to 0
+  *
+  */
+INT32 Net_TakeNodeResends(INT32 node)
+{
+	INT32 n = nodes[node].resends;
+	nodes[node].resends = 0;
+	return n;
+}
+
 #ifndef NONET
 static void GotAcks(void)
 {
@@ -523,8 +976,11 @@ void Net_AckTicker(void)
 			M_Memcpy(netbuffer, ackpak[i].pak.raw, ackpak[i].length);
 			ackpak[i].senttime = I_GetTime();
 			ackpak[i].resentnum++;
+			if (node->resends < UINT16_MAX)
+				node->resends++;
 			ackpak[i].nextacknum = node->nextacknum;
 			retransmit++; // For stat
+			NetStat_CountRetransmit(nodei);
 			HSendPacket((INT32)(node - nodes), false, ackpak[i].acknum,
 				(size_t)(ackpak[i].length - BASEPACKETSIZE));
 		}
@@ -547,6 +1003,8 @@ void Net_AckTicker(void)
 			}
 		}
 	}
+
+	NetStat_Ticker();
 #endif
 }
 
@@ -639,6 +1097,7 @@ void Net_WaitAllAckReceived(UINT32 timeout)
 
 static void InitNode(node_t *node)
 {
+	NetStat_ResetNode((INT32)(node - nodes));
 	node->acktosend_head = node->acktosend_tail = 0;
 	node->firstacktosend = 0;
 	node->nextacknum = 1;
@@ -841,7 +1300,16 @@ const char *packettypename[NUMPACKETTYPE] =
 	"RECEIVEDGAMESTATE",
 
 	// we will reserve this for now even if unused, so order wont get mangled
-	"ISSATURN"
+	"ISSATURN",
+
+	"ASKCONSISTENCY",
+	"CONSISTENCYREPORT",
+
+	"TICBATCH",
+	"CLIENTBATCHCMD",
+	"CLIENTBATCHMIS",
+
+	"SERVERDELTATICS"
 #endif
 };
 
@@ -888,6 +1356,13 @@ static void DebugPrintpacket(const char *header)
 			fprintf(debugfile, "\n");*/
 			break;
 		}
+#ifdef SATURNSYNCH
+		case PT_SERVERDELTATICS:
+			fprintf(debugfile, "    firsttic %u ply %d tics %d\n",
+				(UINT32)netbuffer->u.serverpak.starttic, netbuffer->u.serverpak.numslots,
+				netbuffer->u.serverpak.numtics);
+			break;
+#endif
 		case PT_CLIENTCMD:
 		case PT_CLIENT2CMD:
 		case PT_CLIENT3CMD:
@@ -1028,6 +1503,311 @@ static boolean ShouldDropPacket(void)
 		|| (packetdroprate != 0 && rand() < (((double)RAND_MAX) * (packetdroprate / 100.f))) || packetdroprate == 100;
 }
 #endif
+
+// Per-node link emulation, set up with the netsim command.
+// Packets to and from a simulated node are held back here until the
+// link would have delivered them.
+typedef struct
+{
+	INT32 latency; // Added round trip in milliseconds, half each way
+	INT32 jitter; // Up to this many milliseconds either way, per packet
+	INT32 loss, reorder, duplicate; // Percentages
+	INT32 bandwidth; // Bytes per second each way, 0 for no cap
+	precise_t busyuntil[2]; // When each direction of the link is free again
+	precise_t lastdue[2]; // Keeps packets in order unless they are reordered
+} netsim_t;
+
+#define MAXNETSIMPACKETS 128
+
+typedef struct
+{
+	boolean used;
+	boolean inbound;
+	INT16 node;
+	INT16 length;
+	precise_t due;
+	UINT8 data[MAXPACKETLENGTH];
+} netsimpacket_t;
+
+static netsim_t netsim[MAXNETNODES];
+static netsimpacket_t netsimpackets[MAXNETSIMPACKETS];
+static INT32 netsimheld = 0;
+static UINT32 netsimseed = 1;
+static UINT32 netsimrandom = 1;
+static UINT32 netsimstats[4]; // Held, lost, duplicated, overflowed
+
+static boolean NetSim_Active(const netsim_t *sim)
+{
+	return sim->latency || sim->jitter || sim->loss || sim->reorder || sim->duplicate || sim->bandwidth;
+}
+
+// Own generator, so a seed gives the same run every time
+static UINT32 NetSim_Random(void)
+{
+	netsimrandom ^= netsimrandom << 13;
+	netsimrandom ^= netsimrandom >> 17;
+	netsimrandom ^= netsimrandom << 5;
+	return netsimrandom;
+}
+
+static boolean NetSim_Chance(INT32 percent)
+{
+	return percent > 0 && (INT32)(NetSim_Random() % 100) < percent;
+}
+
+static void Command_NetSim_Print(INT32 node)
+{
+	const netsim_t *sim = &netsim[node];
+	CONS_Printf("Node %2d: latency %d ms, jitter %d ms, loss %d%%, reorder %d%%, duplicate %d%%, bandwidth %d B/s\n",
+		node, sim->latency, sim->jitter, sim->loss, sim->reorder, sim->duplicate, sim->bandwidth);
+}
+
+void Command_NetSim(void)
+{
+	INT32 first, last, node;
+	size_t i;
+
+	if (COM_Argc() < 2)
+	{
+		CONS_Printf("netsim <node|all> [latency <ms>] [jitter <ms>] [loss <%%>] [reorder <%%>] [duplicate <%%>] [bandwidth <bytes/s>]: emulate a bad link\n"
+					"netsim <node|all> reset: stop emulating\n"
+					"netsim seed <number>: restart the random sequence\n"
+					"netsim list: show the current settings\n");
+		return;
+	}
+
+	if (!stricmp(COM_Argv(1), "list"))
+	{
+		for (node = 0; node < MAXNETNODES; node++)
+			if (NetSim_Active(&netsim[node]))
+				Command_NetSim_Print(node);
+		CONS_Printf("%d packets held now; %u held, %u lost, %u duplicated, %u overflowed in total\n",
+			netsimheld, netsimstats[0], netsimstats[1], netsimstats[2], netsimstats[3]);
+		return;
+	}
+
+	if (!stricmp(COM_Argv(1), "seed"))
+	{
+		if (COM_Argc() >= 3)
+			netsimseed = (UINT32)atoi(COM_Argv(2));
+		netsimrandom = netsimseed ? netsimseed : 1;
+		CONS_Printf("Network simulator seed: %u\n", netsimseed);
+		return;
+	}
+
+	if (!(stricmp(COM_Argv(1), "all") && stricmp(COM_Argv(1), "any")))
+	{
+		first = 1;
+		last = MAXNETNODES - 1;
+	}
+	else
+	{
+		first = last = atoi(COM_Argv(1));
+		if (first <= 0 || first >= MAXNETNODES)
+		{
+			CONS_Printf("Invalid node\n");
+			return;
+		}
+	}
+
+	for (i = 2; i < COM_Argc(); i++)
+	{
+		const char *setting = COM_Argv(i);
+		INT32 value;
+
+		if (!(stricmp(setting, "reset") && stricmp(setting, "cancel") && stricmp(setting, "stop")))
+		{
+			for (node = first; node <= last; node++)
+				memset(&netsim[node], 0, sizeof (netsim_t));
+			continue;
+		}
+
+		if (i + 1 >= COM_Argc())
+		{
+			CONS_Printf("Missing value for %s\n", setting);
+			return;
+		}
+		value = max(atoi(COM_Argv(++i)), 0);
+
+		for (node = first; node <= last; node++)
+		{
+			netsim_t *sim = &netsim[node];
+
+			if (!stricmp(setting, "latency"))
+				sim->latency = value;
+			else if (!stricmp(setting, "jitter"))
+				sim->jitter = value;
+			else if (!stricmp(setting, "loss"))
+				sim->loss = min(value, 100);
+			else if (!stricmp(setting, "reorder"))
+				sim->reorder = min(value, 100);
+			else if (!stricmp(setting, "duplicate"))
+				sim->duplicate = min(value, 100);
+			else if (!stricmp(setting, "bandwidth"))
+				sim->bandwidth = value;
+			else
+			{
+				CONS_Printf("Unknown setting %s\n", setting);
+				return;
+			}
+		}
+	}
+
+	for (node = first; node <= last; node++)
+		if (first == last || NetSim_Active(&netsim[node]))
+			Command_NetSim_Print(node);
+}
+
+#ifndef NONET
+/** Works out when the link would deliver the packet in doomcom, and
+  * keeps a copy until then
+  */
+static void NetSim_Queue(netsim_t *sim, boolean inbound, precise_t now)
+{
+	const UINT64 precision = I_GetPrecisePrecision();
+	netsimpacket_t *p = NULL;
+	precise_t due = now + (precise_t)(sim->latency/2) * precision / 1000;
+	INT32 i;
+
+	if (sim->jitter)
+	{
+		const INT32 offset = (INT32)(NetSim_Random() % (UINT32)(2*sim->jitter + 1)) - sim->jitter;
+		if (offset >= 0)
+			due += (precise_t)offset * precision / 1000;
+		else
+			due -= min((precise_t)(-offset) * precision / 1000, due - now);
+	}
+
+	if (sim->bandwidth)
+	{
+		if ((INT64)(sim->busyuntil[inbound] - now) < 0)
+			sim->busyuntil[inbound] = now;
+		sim->busyuntil[inbound] += (precise_t)doomcom->datalength * precision / sim->bandwidth;
+		if ((INT64)(sim->busyuntil[inbound] - due) > 0)
+			due = sim->busyuntil[inbound];
+	}
+
+	// A reordered packet skips the queue, everything else stays in order
+	if (NetSim_Chance(sim->reorder))
+		due = now;
+	else
+	{
+		if ((INT64)(sim->lastdue[inbound] - due) > 0)
+			due = sim->lastdue[inbound];
+		sim->lastdue[inbound] = due;
+	}
+
+	for (i = 0; i < MAXNETSIMPACKETS; i++)
+		if (!netsimpackets[i].used)
+		{
+			p = &netsimpackets[i];
+			break;
+		}
+
+	if (!p)
+	{
+		netsimstats[3]++;
+		DEBFILE("NetSim: out of room, packet lost\n");
+		return;
+	}
+
+	p->used = true;
+	p->inbound = inbound;
+	p->node = doomcom->remotenode;
+	p->length = doomcom->datalength;
+	p->due = due;
+	M_Memcpy(p->data, netbuffer, doomcom->datalength);
+	netsimheld++;
+	netsimstats[0]++;
+}
+
+/** Holds back the packet in doomcom if its node has a simulated link
+  *
+  * \return true if the packet was taken (held or lost)
+  */
+static boolean NetSim_Hold(boolean inbound)
+{
+	const INT32 node = doomcom->remotenode;
+	netsim_t *sim;
+	precise_t now;
+
+	if (node <= 0 || node >= MAXNETNODES || !NetSim_Active(&netsim[node]))
+		return false;
+
+	sim = &netsim[node];
+	if (NetSim_Chance(sim->loss))
+	{
+		netsimstats[1]++;
+		DEBFILE(va("NetSim: lost %s packet %s node %d\n", inbound ? "incoming" : "outgoing", inbound ? "from" : "to", node));
+		return true;
+	}
+
+	now = I_GetPreciseTime();
+	NetSim_Queue(sim, inbound, now);
+	if (NetSim_Chance(sim->duplicate))
+	{
+		netsimstats[2]++;
+		NetSim_Queue(sim, inbound, now);
+	}
+	return true;
+}
+
+/** Puts the earliest held packet that is due into doomcom
+  */
+static boolean NetSim_Release(boolean inbound)
+{
+	const precise_t now = I_GetPreciseTime();
+	netsimpacket_t *p = NULL;
+	INT32 i;
+
+	if (!netsimheld)
+		return false;
+
+	for (i = 0; i < MAXNETSIMPACKETS; i++)
+	{
+		netsimpacket_t *q = &netsimpackets[i];
+		if (q->used && q->inbound == inbound && (INT64)(now - q->due) >= 0
+			&& (!p || (INT64)(p->due - q->due) > 0))
+			p = q;
+	}
+
+	if (!p)
+		return false;
+
+	doomcom->remotenode = p->node;
+	doomcom->datalength = p->length;
+	M_Memcpy(netbuffer, p->data, p->length);
+	p->used = false;
+	netsimheld--;
+	return true;
+}
+
+/** Sends held outgoing packets whose time has come
+  *
+  * This clobbers netbuffer, so only call it when nothing is being built in there.
+  */
+static void NetSim_Flush(void)
+{
+	while (NetSim_Release(false))
+		I_NetSend();
+}
+
+static void NetSim_Send(void)
+{
+	if (!NetSim_Hold(false))
+		I_NetSend();
+}
+
+static void NetSim_Get(void)
+{
+	while (!NetSim_Release(true))
+	{
+		I_NetGet();
+		if (doomcom->remotenode == -1 || !NetSim_Hold(true))
+			return;
+	}
+}
+#endif
 #endif
 
 //
@@ -1103,6 +1883,7 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 
 	netbuffer->checksum = NetbufferChecksum();
 	sendbytes += packetheaderlength + doomcom->datalength; // For stat
+	NetStat_Count(node, netbuffer->packettype, packetheaderlength + doomcom->datalength, NETSTAT_OUT);
 
 #ifdef PACKETDROP
 	// Simulate internet :)
@@ -1114,7 +1895,11 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 		if (debugfile)
 			DebugPrintpacket("SENT");
 #endif
+#ifdef PACKETDROP
+		NetSim_Send();
+#else
 		I_NetSend();
+#endif
 #ifdef PACKETDROP
 	}
 	else
@@ -1165,10 +1950,18 @@ boolean HGetPacket(void)
 
 #ifndef NONET
 
+#ifdef PACKETDROP
+	NetSim_Flush();
+#endif
+
 	while(true)
 	{
 		//nodejustjoined = I_NetGet();
+#ifdef PACKETDROP
+		NetSim_Get();
+#else
 		I_NetGet();
+#endif
 
 		if (doomcom->remotenode == -1) // No packet received
 			return false;
@@ -1191,6 +1984,8 @@ boolean HGetPacket(void)
 			continue;
 		}
 
+		NetStat_Count(doomcom->remotenode, netbuffer->packettype, packetheaderlength + doomcom->datalength, NETSTAT_IN);
+
 #ifdef DEBUGFILE
 		if (debugfile)
 			DebugPrintpacket("GET");
@@ -1228,6 +2023,49 @@ boolean HGetPacket(void)
 	return true;
 }
 
+#ifndef NONET
+/** Sends the packet in netbuffer to a server list query slot. Queries
+  * don't belong to a node, so there's no ack; the caller asks again if
+  * nothing comes back.
+  */
+void HSendQuery(INT32 slot, size_t packetlength)
+{
+	if (!I_NetQuerySend)
+		return;
+
+	doomcom->datalength = (INT16)(packetlength + BASEPACKETSIZE);
+	netbuffer->ack = netbuffer->ackreturn = 0;
+	netbuffer->checksum = NetbufferChecksum();
+	sendbytes += packetheaderlength + doomcom->datalength; // For stat
+
+	I_NetQuerySend(slot);
+}
+
+/** Gets the next good packet from the query socket into netbuffer.
+  *
+  * \return The query slot it came from, or -1 if there are none left
+  */
+INT32 HGetQuery(void)
+{
+	INT32 slot;
+
+	if (!I_NetQueryGet)
+		return -1;
+
+	while ((slot = I_NetQueryGet()) != -1)
+	{
+		getbytes += packetheaderlength + doomcom->datalength; // For stat
+
+		if (netbuffer->checksum == NetbufferChecksum())
+			return slot;
+
+		DEBFILE("Bad query packet checksum\n");
+	}
+
+	return -1;
+}
+#endif
+
 static boolean Internal_Get(void)
 {
 	doomcom->remotenode = -1;
@@ -1293,6 +2131,8 @@ boolean D_CheckNetGame(void)
 	I_NetGet = Internal_Get;
 	I_NetSend = Internal_Send;
 	I_NetCanSend = NULL;
+	I_NetFlush = NULL;
+	I_NetWait = NULL;
 	I_NetCloseSocket = NULL;
 	I_NetFreeNodenum = Internal_FreeNodenum;
 	I_NetMakeNodewPort = NULL;
@@ -1492,6 +2332,8 @@ void D_CloseConnection(void)
 		I_NetGet = Internal_Get;
 		I_NetSend = Internal_Send;
 		I_NetCanSend = NULL;
+		I_NetFlush = NULL;
+		I_NetWait = NULL;
 		I_NetCloseSocket = NULL;
 		I_NetFreeNodenum = Internal_FreeNodenum;
 		I_NetMakeNodewPort = NULL;
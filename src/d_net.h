@@ -46,6 +46,8 @@ extern boolean nodeingame[MAXNETNODES]; // Set false as nodes leave game
 extern boolean serverrunning;
 
 INT32 Net_GetFreeAcks(boolean urgent);
+INT32 Net_GetNodeUnacked(INT32 node);
+INT32 Net_TakeNodeResends(INT32 node);
 void Net_AckTicker(void);
 
 // If reliable return true if packet sent, 0 else
@@ -54,6 +56,8 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum,
 boolean HGetPacket(void);
 void D_SetDoomcom(void);
 #ifndef NONET
+void HSendQuery(INT32 slot, size_t packetlength);
+INT32 HGetQuery(void);
 void D_SaveBan(void);
 void D_LoadBan(boolean warning);
 #endif
@@ -66,5 +70,6 @@ void Net_AbortPacketType(UINT8 packettype);
 void Net_SendAcks(INT32 node);
 void Net_WaitAllAckReceived(UINT32 timeout);
 const char *Net_GetPacketName(UINT8 packettype);
+void Net_CountTicCmds(INT32 node, boolean incoming, tic_t numtics, size_t length, size_t plainlength);
 
 #endif
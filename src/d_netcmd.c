@@ -127,6 +127,7 @@ static void Fishcake_OnChange(void);
 
 static void Command_Playdemo_f(void);
 static void Command_Timedemo_f(void);
+static void Command_Benchdemo_f(void);
 static void Command_Stopdemo_f(void);
 static void Command_StartMovie_f(void);
 static void Command_StopMovie_f(void);
@@ -793,14 +794,24 @@ void D_RegisterServerCommands(void)
 #ifdef SATURNSYNCH
 	CV_RegisterVar(&cv_gamestateattempts);
 	CV_RegisterVar(&cv_resynchcooldown);
+	CV_RegisterVar(&cv_consistencyreport);
+	CV_RegisterVar(&cv_adaptivetics);
+	CV_RegisterVar(&cv_adaptivetics_maxbatch);
+	CV_RegisterVar(&cv_adaptivetics_maxlead);
 #endif
 	CV_RegisterVar(&cv_maxsend);
 	CV_RegisterVar(&cv_noticedownload);
 	CV_RegisterVar(&cv_downloadspeed);
+	CV_RegisterVar(&cv_netcompression);
+	CV_RegisterVar(&cv_netcompressionlevel);
     CV_RegisterVar(&cv_connectawaittime);
+	CV_RegisterVar(&cv_netmetrics_file);
+	CV_RegisterVar(&cv_netmetrics_interval);
 	CV_RegisterVar(&cv_httpsource);
+	CV_RegisterVar(&cv_httpdownloads);
 #ifndef NONET
 	CV_RegisterVar(&cv_allownewplayer);
+	CV_RegisterVar(&cv_allowrelays);
 #ifdef SATURNJOIN
 	CV_RegisterVar(&cv_allownewsaturnplayer);
 #endif
@@ -880,6 +891,7 @@ void D_RegisterClientCommands(void)
 
 	COM_AddCommand("playdemo", Command_Playdemo_f);
 	COM_AddCommand("timedemo", Command_Timedemo_f);
+	COM_AddCommand("benchdemo", Command_Benchdemo_f);
 	COM_AddCommand("stopdemo", Command_Stopdemo_f);
 	COM_AddCommand("playintro", Command_Playintro_f);
 
@@ -1183,6 +1195,10 @@ void D_RegisterClientCommands(void)
 	CV_RegisterVar(&cv_ps_samplesize);
 	CV_RegisterVar(&cv_ps_descriptor);
 
+#ifdef HAVE_THREADS
+	CV_RegisterVar(&cv_scenerythreads);
+#endif
+
 	//Value used to store last server player has joined
 	CV_RegisterVar(&cv_lastserver);
 
@@ -2575,6 +2591,34 @@ static void Command_Timedemo_f(void)
 	G_TimeDemo(name);
 }
 
+static void Command_Benchdemo_f(void)
+{
+	char name[256];
+
+	if (COM_Argc() != 2)
+	{
+		CONS_Printf(M_GetText("benchdemo <demoname>: run a demo's game logic as fast as possible and report where the time went\n"));
+		return;
+	}
+
+	if (netgame)
+	{
+		CONS_Printf(M_GetText("You can't play a demo while in a netgame.\n"));
+		return;
+	}
+
+	if (demo.playback)
+		G_StopDemo();
+	if (metalplayback)
+		G_StopMetalDemo();
+
+	strcpy(name, COM_Argv(1));
+
+	CONS_Printf(M_GetText("Benchmarking demo '%s'.\n"), name);
+
+	G_BenchDemo(name);
+}
+
 // stop current demo
 static void Command_Stopdemo_f(void)
 {
@@ -203,6 +203,10 @@ extern consvar_t cv_ps_thinkframe_page;
 extern consvar_t cv_ps_samplesize;
 extern consvar_t cv_ps_descriptor;
 
+#ifdef HAVE_THREADS
+extern consvar_t cv_scenerythreads;
+#endif
+
 extern consvar_t cv_director, cv_kartdebugdirector, cv_showdirectorhud;
 
 extern consvar_t cv_showtrackaddon;
@@ -34,6 +34,11 @@
 #include <sys/utime.h>
 #endif
 
+#if (defined (__unix__) || defined (__APPLE__) || defined (UNIXCOMMON)) && !defined (__CYGWIN__)
+#include <sys/mman.h>
+#define FILEMMAP
+#endif
+
 #ifdef HAVE_CURL
 #include "curl/curl.h"
 #endif
@@ -56,6 +61,12 @@
 #include "m_menu.h"
 #include "md5.h"
 #include "filesrch.h"
+#include "lzf.h"
+#include "i_threads.h"
+
+#ifdef HAVE_ZLIB
+#include "zlib.h"
+#endif
 
 #include <errno.h>
 
@@ -72,6 +83,10 @@ static int curlprogress_callback(void *clientp, double dltotal, double dlnow, do
 #endif
 #endif
 
+// Most ranges a node can ask to have resent; anything past the last one is
+// sent again in full
+#define MAXRESUMERANGES 4
+
 // Sender structure
 typedef struct filetx_s
 {
@@ -82,8 +97,17 @@ typedef struct filetx_s
 	} id;
 	UINT32 size; // Size of the file
 	UINT8 fileid;
+	struct fileused_s *used; // What an SF_FILE is sent from, once opened
+	boolean compressed; // It's sent from compressedFiles[fileid]
 	INT32 node; // Destination
 	struct filetx_s *next; // Next file in the list
+
+	// Set when the node already has part of the file from an earlier attempt
+	UINT8 resumetag; // The stream it has: 0 for the file itself, or a compression tag
+	UINT32 resumesize; // The stream's size, or 0 if the node doesn't know it
+	UINT8 numranges; // How many ranges it is missing, 0 to send everything
+	UINT32 rangestart[MAXRESUMERANGES];
+	UINT32 rangeend[MAXRESUMERANGES];
 } filetx_t;
 
 // Current transfers (one for each node)
@@ -92,6 +116,8 @@ typedef struct filetran_s
 	filetx_t *txlist; // Linked list of all files for the node
 	UINT32 position; // The current position in the file
 	boolean init; // false if we want to reset position / open a new file
+	UINT8 range; // Which of the missing ranges is being sent
+	INT32 window; // How many fragments may be unacknowledged at once
 } filetran_t;
 static filetran_t transfer[MAXNETNODES];
 
@@ -99,12 +125,70 @@ static filetran_t transfer[MAXNETNODES];
 typedef struct fileused_s
 {
 	FILE *file;
+	UINT8 *map; // The whole file, if it could be mapped; file is NULL then
+	UINT32 mapsize;
 	UINT8 count;
 	UINT32 position;
 } fileused_t;
 
 static fileused_t transferFiles[UINT8_MAX + 1];
 
+// Files are compressed by a worker thread the first time a node starts on
+// them, into a cache file next to the config, then sent from there until
+// there's nothing left to send. The stream starts with the magic, the tag
+// and the uncompressed size. The tag is the method, and for deflate the
+// level in the high bits, so a node resuming a download can tell whether
+// the server would still send it the same stream. Then come the blocks of
+// FILECOMPRESSBLOCK bytes of the file each, the last one shorter, every one
+// behind its compressed size, with the top bit set if it is stored as is.
+// That way the receiver can unpack each one as soon as it has arrived.
+#define FILECOMPRESSMAGIC "SRBZ"
+#define FILECOMPRESSHEADER (4 + 1 + 4)
+#define FILECOMPRESSBLOCK (64*1024)
+#define FILECOMPRESSSTORED 0x80000000
+
+typedef enum
+{
+	FC_NONE,
+	FC_COMPRESSING,
+	FC_READY,
+	FC_FAILED // Didn't get any smaller, or couldn't be written
+} filecompressstate_t;
+
+typedef struct
+{
+	filecompressstate_t state; // Locked by compress_mutex
+	boolean cancel; // Nobody wants it anymore, so the worker should stop
+	char path[MAX_WADPATH + 32]; // The cache
+	char *source; // The file, freed by the worker
+	UINT8 method;
+	UINT8 tag; // What went in the header after the magic
+	INT32 level;
+	UINT32 filesize;
+	UINT32 length; // Of the cache
+	fileused_t used; // The transfers sending the cache
+} compressedfile_t;
+
+static compressedfile_t compressedFiles[UINT8_MAX + 1];
+
+#ifdef HAVE_THREADS
+static I_mutex compress_mutex;
+#  define Lock_compress()   I_lock_mutex(&compress_mutex)
+#  define Unlock_compress() I_unlock_mutex(compress_mutex)
+#else
+#  define Lock_compress()
+#  define Unlock_compress()
+#endif
+
+UINT8 netcompression[MAXNETNODES]; // What each node said it can decompress
+
+static struct
+{
+	UINT32 count;
+	UINT64 before;
+	UINT64 after;
+} compressionstats[2][NETCOMPRESS_DEFLATE + 1]; // received, sent
+
 // Read time of file: stat _stmtime
 // Write time of file: utime
 
@@ -113,6 +197,42 @@ INT32 fileneedednum; // Number of files needed to join the server
 fileneeded_t fileneeded[MAX_WADFILES]; // List of needed files
 char downloaddir[512] = "DOWNLOAD";
 
+// A download that hasn't finished is kept as <file>.part, and the ranges
+// of it that arrived are listed in <file>.part.map, so the next attempt
+// only has to ask for what's missing. The map starts with the magic, the
+// file's md5, the tag of the stream, whether its size is known and the
+// size, then the number of ranges and the ranges. A compressed download is
+// unpacked into <file>.part.out, which is started over on each attempt.
+#define PARTMAPMAGIC "SRBP"
+#define PARTMAPHEADER (4 + 16 + 1 + 1 + 4 + 1)
+#define PARTPATHLEN (MAX_WADPATH + 16)
+#define MAXPARTRANGES 32
+#define PARTSAVEFRAGMENTS 256 // Update the map this often while downloading
+#define UNPACKBLOCKS 2 // Most a compressed download catches up per fragment
+
+typedef struct
+{
+	boolean resumable; // Requested by CL_SendRequestFile, not a gamestate
+	boolean resumed; // Some of it came from an earlier attempt
+	boolean sizeknown; // The totalsize is that of the stream being sent
+	UINT8 tag; // 0 if the stream is the file itself, or its compression tag
+	UINT32 filesize; // The totalsize from the server info
+	UINT16 unsaved; // Fragments since the map was last written
+	UINT8 numranges;
+	UINT32 start[MAXPARTRANGES];
+	UINT32 end[MAXPARTRANGES];
+	UINT32 unmapped; // Bytes that arrived while the map was full, not in currentsize
+
+	// A compressed stream is unpacked into <file>.part.out as it arrives
+	FILE *unpackfile;
+	UINT32 unpacked; // How far into the stream that got
+	UINT32 unpackedsize; // How much of the file came out
+	UINT32 rawsize; // The file's size, from the stream's header
+	boolean badstream; // Something didn't unpack, so it fails once it's done
+} partfile_t;
+
+static partfile_t partfiles[MAX_WADFILES];
+
 #ifdef CLIENT_LOADINGSCREEN
 // for cl loading screen
 INT32 lastfilenum = -1;
@@ -123,20 +243,44 @@ UINT32 totalfilesrequestedsize = 0;
 #endif
 
 #ifdef HAVE_CURL
-static CURL *http_handle;
-static CURLM *multi_handle;
+#define MAXHTTPDOWNLOADS 16
+
+// Everything about a download is worked out by CURLPrepareFile on the main
+// thread, so the download thread only has to hand it to curl.
+typedef struct
+{
+	CURL *handle; // NULL if the slot is free
+	INT32 filenum;
+	char url[MAX_MIRROR_LENGTH + MAX_WADPATH + 2];
+	char *auth; // From curl_logins, or NULL
+	UINT32 resumefrom; // What was kept from an earlier attempt
+	UINT32 origfilesize;
+	UINT32 origtotalfilesize;
+} httptransfer_t;
+
+static CURLM *multi_handle; // Only touched by the download thread
+static httptransfer_t curl_active[MAXHTTPDOWNLOADS];
+static httptransfer_t curl_pending[MAX_WADFILES]; // Files waiting for a free slot
+static INT32 curl_numpending = 0;
+static boolean curl_thread = false; // Is the download thread running?
+static time_t curl_starttime;
+static UINT64 curl_received;
 boolean curl_running = false;
 boolean curl_failedwebdownload = false;
-static double curl_dlnow;
-static double curl_dltotal;
-static time_t curl_starttime;
-INT32 curl_transfers = 0;
-static int curl_runninghandles = 0;
-static UINT32 curl_origfilesize;
-static UINT32 curl_origtotalfilesize;
-static char *curl_realname = NULL;
-fileneeded_t *curl_curfile = NULL;
+INT32 curl_transfers = 0; // Files queued, downloading or being checked
+UINT32 curl_getbps = 0;
 HTTP_login *curl_logins;
+
+#ifdef HAVE_THREADS
+static I_mutex curl_mutex;
+#  define Lock_curl()   I_lock_mutex(&curl_mutex)
+#  define Unlock_curl() I_unlock_mutex(curl_mutex)
+#else
+#  define Lock_curl()
+#  define Unlock_curl()
+#endif
+
+static void CL_KeepHTTPPartial(httptransfer_t *t);
 #endif
 
 /** Fills a serverinfo packet with information about wad files loaded.
@@ -238,6 +382,8 @@ void CL_PrepareDownloadSaveGame(const char *tmpsave)
 	fileneeded[0].file = NULL;
 	memset(fileneeded[0].md5sum, 0, 16);
 	strcpy(fileneeded[0].filename, tmpsave);
+	partfiles[0].resumable = false; // Never worth keeping
+
 }
 
 /** Checks the server to see if we CAN download all the files,
@@ -306,6 +452,441 @@ boolean CL_CheckDownloadable(void)
 	return false;
 }
 
+static void CL_PartPath(char *path, INT32 i, const char *suffix)
+{
+	snprintf(path, PARTPATHLEN, "%s.part%s", fileneeded[i].filename, suffix);
+	path[PARTPATHLEN - 1] = '\0';
+}
+
+/** Closes and deletes what was unpacked of a compressed download
+  *
+  * \param i The file
+  *
+  */
+static void CL_StopUnpacking(INT32 i)
+{
+	partfile_t *part = &partfiles[i];
+	char path[PARTPATHLEN];
+
+	if (part->unpackfile)
+		fclose(part->unpackfile);
+	part->unpackfile = NULL;
+	CL_PartPath(path, i, ".out");
+	remove(path);
+
+	part->unpacked = part->unpackedsize = part->rawsize = 0;
+	part->badstream = false;
+}
+
+/** Unpacks the blocks of a compressed download that have arrived
+  *
+  * Only what arrived in one piece from the start can be unpacked, so it
+  * catches up as the gaps get filled in.
+  *
+  * \param i The file, open for reading and writing
+  * \param finish Unpack everything left, instead of a few blocks
+  * \return False if the stream is bad
+  *
+  */
+static boolean CL_UnpackPartial(INT32 i, boolean finish)
+{
+	static UINT8 packed[FILECOMPRESSBLOCK], raw[FILECOMPRESSBLOCK];
+	fileneeded_t *file = &fileneeded[i];
+	partfile_t *part = &partfiles[i];
+	UINT32 arrived, length, rawlength;
+	INT32 blocks = 0;
+	UINT8 *p;
+
+	if (part->badstream)
+		return false;
+	if (!part->numranges || part->start[0] != 0)
+		return true; // Nothing to go on yet
+	arrived = part->end[0];
+	if (finish && part->unmapped)
+		arrived = file->totalsize; // Some of it never made the map, so go by what was written
+
+	if (!part->unpackfile)
+	{
+		char path[PARTPATHLEN];
+
+		if (arrived < FILECOMPRESSHEADER)
+			return true;
+
+		fseek(file->file, 0, SEEK_SET);
+		if (fread(packed, 1, FILECOMPRESSHEADER, file->file) != FILECOMPRESSHEADER)
+			return false;
+		p = packed + 4 + 1; // The magic and tag were checked as they arrived
+		part->rawsize = READUINT32(p);
+		if (part->rawsize != part->filesize)
+			return false;
+
+		CL_PartPath(path, i, ".out");
+		part->unpackfile = fopen(path, "wb");
+		if (!part->unpackfile)
+			return false;
+		part->unpacked = FILECOMPRESSHEADER;
+	}
+
+	while (part->unpackedsize < part->rawsize && part->unpacked + 4 <= arrived
+		&& (finish || blocks < UNPACKBLOCKS))
+	{
+		boolean stored;
+
+		fseek(file->file, part->unpacked, SEEK_SET);
+		if (fread(packed, 1, 4, file->file) != 4)
+			return false;
+		p = packed;
+		length = READUINT32(p);
+		stored = (length & FILECOMPRESSSTORED) ? true : false;
+		length &= ~FILECOMPRESSSTORED;
+		rawlength = min(part->rawsize - part->unpackedsize, FILECOMPRESSBLOCK);
+		if (!length || length > rawlength || (stored && length != rawlength))
+			return false;
+
+		if (part->unpacked + 4 + length > arrived)
+			break; // Not all there yet
+		if (fread(packed, 1, length, file->file) != length)
+			return false;
+
+		if (stored)
+			p = packed;
+		else if (Net_Decompress(part->tag & 0x0F, packed, length, raw, rawlength)) // The level doesn't matter here
+			p = raw;
+		else
+			return false;
+
+		if (fwrite(p, 1, rawlength, part->unpackfile) != rawlength)
+			return false;
+
+		part->unpacked += 4 + length;
+		part->unpackedsize += rawlength;
+		blocks++;
+	}
+
+	return true;
+}
+
+/** Forgets about part of a file downloaded before and deletes it
+  *
+  * \param i The file
+  *
+  */
+static void CL_DropPartial(INT32 i)
+{
+	partfile_t *part = &partfiles[i];
+	char path[PARTPATHLEN];
+
+	CL_StopUnpacking(i);
+	CL_PartPath(path, i, "");
+	remove(path);
+	CL_PartPath(path, i, ".map");
+	remove(path);
+
+	part->resumed = part->sizeknown = false;
+	part->tag = 0;
+	part->numranges = 0;
+	part->unmapped = 0;
+	fileneeded[i].totalsize = part->filesize;
+}
+
+/** Notes down that a range of a file has arrived
+  *
+  * \param part The file
+  * \param start Where the range starts
+  * \param end Where it stops
+  * \return How many of its bytes weren't there already, 0 if the map is
+  *         full and it couldn't be noted down
+  *
+  */
+static UINT32 CL_AddPartRange(partfile_t *part, UINT32 start, UINT32 end)
+{
+	UINT32 added = end - start;
+	UINT8 i, j;
+
+	// Skip the ranges that stop before this one starts
+	for (i = 0; i < part->numranges && part->end[i] < start; i++)
+		;
+
+	// Merge with every range it touches
+	for (j = i; j < part->numranges && part->start[j] <= end; j++)
+	{
+		UINT32 lo = max(start, part->start[j]);
+		UINT32 hi = min(end, part->end[j]);
+		if (hi > lo)
+			added -= hi - lo;
+	}
+
+	if (j > i)
+	{
+		start = min(start, part->start[i]);
+		end = max(end, part->end[j - 1]);
+		memmove(&part->start[i + 1], &part->start[j], (part->numranges - j) * sizeof (UINT32));
+		memmove(&part->end[i + 1], &part->end[j], (part->numranges - j) * sizeof (UINT32));
+		part->numranges = (UINT8)(part->numranges - (j - i - 1));
+	}
+	else if (part->numranges < MAXPARTRANGES)
+	{
+		memmove(&part->start[i + 1], &part->start[i], (part->numranges - i) * sizeof (UINT32));
+		memmove(&part->end[i + 1], &part->end[i], (part->numranges - i) * sizeof (UINT32));
+		part->numranges++;
+	}
+	else
+	{
+		// No room to note it down, so it isn't counted as there; the
+		// next attempt asks for it again if this one doesn't finish
+		part->unmapped += added;
+		return 0;
+	}
+
+	part->start[i] = start;
+	part->end[i] = end;
+	return added;
+}
+
+/** Writes the map of what has arrived of a file so far
+  *
+  * \param i The file
+  *
+  */
+static void CL_SavePartial(INT32 i)
+{
+	partfile_t *part = &partfiles[i];
+	char path[PARTPATHLEN];
+	UINT8 buf[PARTMAPHEADER + MAXPARTRANGES*8];
+	UINT8 *p = buf;
+	UINT8 n;
+
+	// The map mustn't claim anything that is still only in a buffer
+	if (fileneeded[i].file)
+		fflush(fileneeded[i].file);
+
+	WRITEMEM(p, PARTMAPMAGIC, 4);
+	WRITEMEM(p, fileneeded[i].md5sum, 16);
+	WRITEUINT8(p, part->tag);
+	WRITEUINT8(p, part->sizeknown);
+	WRITEUINT32(p, part->sizeknown ? fileneeded[i].totalsize : 0);
+	WRITEUINT8(p, part->numranges);
+	for (n = 0; n < part->numranges; n++)
+	{
+		WRITEUINT32(p, part->start[n]);
+		WRITEUINT32(p, part->end[n]);
+	}
+
+	CL_PartPath(path, i, ".map");
+	if (!FIL_WriteFile(path, buf, p - buf))
+		DEBFILE(va("Can't write %s\n", path));
+	part->unsaved = 0;
+}
+
+/** Picks up where an earlier download of a file left off, if it can
+  *
+  * \param i The file, with its path in the download directory
+  * \return True if part of it is there already
+  *
+  */
+static boolean CL_LoadPartial(INT32 i)
+{
+	partfile_t *part = &partfiles[i];
+	char path[PARTPATHLEN];
+	UINT8 *buf = NULL, *p;
+	UINT32 size = 0;
+	size_t length;
+	FILE *handle;
+	long partsize = -1;
+	UINT8 n;
+
+	memset(part, 0, sizeof (*part));
+	part->resumable = true;
+	part->filesize = fileneeded[i].totalsize;
+
+	CL_PartPath(path, i, ".map");
+	length = FIL_ReadFile(path, &buf);
+	if (!length)
+		return false;
+
+	p = buf;
+	if (length >= PARTMAPHEADER && !memcmp(p, PARTMAPMAGIC, 4)
+		&& !memcmp(p + 4, fileneeded[i].md5sum, 16)) // Still the same file
+	{
+		p += 4 + 16;
+		part->tag = READUINT8(p);
+		part->sizeknown = READUINT8(p) ? true : false;
+		size = READUINT32(p);
+		n = READUINT8(p);
+		if (n <= MAXPARTRANGES && length >= PARTMAPHEADER + n*8u)
+		{
+			for (part->numranges = 0; part->numranges < n; part->numranges++)
+			{
+				part->start[part->numranges] = READUINT32(p);
+				part->end[part->numranges] = READUINT32(p);
+			}
+		}
+	}
+	Z_Free(buf);
+
+	CL_PartPath(path, i, "");
+	handle = fopen(path, "rb");
+	if (handle)
+	{
+		fseek(handle, 0, SEEK_END);
+		partsize = ftell(handle);
+		fclose(handle);
+	}
+
+	// It has to start at the beginning, where the stream's header is
+	n = part->numranges;
+	if (!n || part->start[0] != 0 || partsize < (long)part->end[n - 1]
+		|| (part->sizeknown && (part->end[n - 1] > size || (n == 1 && part->end[0] == size))))
+	{
+		CL_DropPartial(i);
+		return false;
+	}
+
+	while (--n)
+	{
+		if (part->start[n] <= part->end[n - 1] || part->start[n] >= part->end[n])
+		{
+			CL_DropPartial(i);
+			return false;
+		}
+	}
+
+	if (part->sizeknown)
+		fileneeded[i].totalsize = size;
+	part->resumed = true;
+	return true;
+}
+
+/** Writes the parts of the files being requested that are still missing,
+  * for the ones partly downloaded before
+  *
+  * \param p Where to write, in the PT_REQUESTFILE
+  * \param ids The files requested in it
+  * \param numids How many there are
+  * \return Where the list ends
+  *
+  */
+static char *CL_WriteResumeInfo(char *p, const UINT8 *ids, INT32 numids)
+{
+	char *end = (char *)netbuffer->u.textcmd + MAXTEXTCMD;
+	INT32 k;
+
+	for (k = 0; k < numids; k++)
+	{
+		partfile_t *part = &partfiles[ids[k]];
+		boolean tailheld;
+		UINT8 n, gaps, numgaps;
+
+		if (!part->numranges)
+			continue;
+
+		// The gaps between ranges, and everything after the last one
+		// unless that reaches the end. If not all of them fit, the last
+		// one asked for covers the rest of the file.
+		tailheld = (part->sizeknown && part->end[part->numranges - 1] == fileneeded[ids[k]].totalsize);
+		gaps = (UINT8)(part->numranges - tailheld);
+		numgaps = min(gaps, MAXRESUMERANGES);
+		while (numgaps > 1 && p + 7 + numgaps*8 + 1 > end)
+			numgaps--;
+		if (p + 7 + numgaps*8 + 1 > end)
+			break;
+
+		WRITEUINT8(p, ids[k]);
+		WRITEUINT8(p, part->tag);
+		WRITEUINT32(p, part->sizeknown ? fileneeded[ids[k]].totalsize : 0);
+		WRITEUINT8(p, numgaps);
+		for (n = 0; n < numgaps; n++)
+		{
+			WRITEUINT32(p, part->end[n]);
+			if (n + 1 < numgaps || (numgaps == gaps && tailheld))
+				WRITEUINT32(p, part->start[n + 1]);
+			else
+				WRITEUINT32(p, UINT32_MAX);
+		}
+	}
+
+	if (p < end)
+		WRITEUINT8(p, 0xFF);
+	return p;
+}
+
+/** Opens the .part file a download is written to
+  *
+  * \param i The file
+  *
+  */
+static void CL_OpenPartial(INT32 i)
+{
+	fileneeded_t *file = &fileneeded[i];
+	partfile_t *part = &partfiles[i];
+	char path[PARTPATHLEN];
+	UINT8 n;
+
+	CL_PartPath(path, i, "");
+	file->file = NULL;
+	if (part->numranges)
+		file->file = fopen(path, "r+b");
+	if (!file->file)
+	{
+		part->numranges = 0;
+		part->resumed = false;
+		file->file = fopen(path, "w+b"); // Read back when unpacking
+	}
+
+	file->currentsize = 0;
+	for (n = 0; n < part->numranges; n++)
+		file->currentsize += part->end[n] - part->start[n];
+	part->unmapped = 0;
+	part->unsaved = 0;
+	CL_StopUnpacking(i);
+}
+
+/** Throws away what was kept of a download once the server starts it over,
+  * because it couldn't send the same stream again
+  *
+  * \param i The file
+  *
+  */
+static void CL_RestartPartial(INT32 i)
+{
+	fileneeded_t *file = &fileneeded[i];
+	char path[PARTPATHLEN];
+
+	DEBFILE(va("Server restarted %s, dropping what we had\n", file->filename));
+	fclose(file->file);
+	CL_DropPartial(i);
+
+	CL_PartPath(path, i, "");
+	file->file = fopen(path, "w+b");
+	if (!file->file)
+		I_Error("Can't create file %s: %s", path, strerror(errno));
+	file->currentsize = 0;
+}
+
+/** Moves a finished download from its .part file, or what was unpacked
+  * of it, to where it belongs
+  *
+  * \param i The file, which has been closed
+  *
+  */
+static void CL_FinishPartial(INT32 i)
+{
+	char path[PARTPATHLEN];
+
+	CL_PartPath(path, i, ".map");
+	remove(path);
+	CL_PartPath(path, i, "");
+	if (partfiles[i].tag)
+	{
+		remove(path);
+		CL_PartPath(path, i, ".out");
+	}
+	remove(fileneeded[i].filename);
+	if (rename(path, fileneeded[i].filename))
+		I_Error("Can't rename %s to %s: %s", path, fileneeded[i].filename, strerror(errno));
+	partfiles[i].resumable = false;
+}
+
 // The following was written and, against all odds, works.
 #define MORELEGACYDOWNLOADER
 
@@ -322,6 +903,8 @@ boolean CL_SendRequestFile(void)
 	INT32 i;
 	INT64 totalfreespaceneeded = 0, availablefreespace;
 	INT32 skippedafile = -1;
+	UINT8 ids[MAXTEXTCMD/2]; // Files in this request
+	INT32 numids;
 #ifdef MORELEGACYDOWNLOADER
 	boolean firstloop = true;
 #endif
@@ -371,6 +954,7 @@ tryagain:
 
 	netbuffer->packettype = PT_REQUESTFILE;
 	p = (char *)netbuffer->u.textcmd;
+	numids = 0;
 
 	for (i = 0; i < fileneedednum; i++)
 	{
@@ -400,6 +984,8 @@ tryagain:
 			// put it in download dir
 			strcatbf(fileneeded[i].filename, downloaddir, "/");
 			fileneeded[i].status = FS_REQUESTED;
+			CL_LoadPartial(i);
+			ids[numids++] = (UINT8)i;
 		}
 	}
 
@@ -428,6 +1014,8 @@ tryagain:
 	}
 
 	WRITEUINT8(p, 0xFF); // terminator
+	WRITEUINT8(p, NETCOMPRESS_SUPPORTED); // older servers stop reading at the terminator
+	p = CL_WriteResumeInfo(p, ids, numids);
 	if (!HSendPacket(servernode, true, 0, p - (char *)netbuffer->u.textcmd))
 	{
 		CONS_Printf("Direct download - unable to send packet.\n");
@@ -449,6 +1037,60 @@ tryagain:
 	return true;
 }
 
+/** Reads which parts of the requested files a node is still missing,
+  * for the ones it had started downloading before
+  *
+  * \param node The node asking
+  * \param p Where the list starts in its PT_REQUESTFILE
+  *
+  */
+static void SV_ReadResumeInfo(INT32 node, UINT8 *p)
+{
+	UINT8 *end = (UINT8 *)netbuffer + doomcom->datalength;
+	UINT8 id, tag, numranges, i;
+	UINT32 size;
+	filetx_t *f;
+
+	if (end > netbuffer->u.textcmd + MAXTEXTCMD)
+		end = netbuffer->u.textcmd + MAXTEXTCMD;
+
+	// fileid, tag, size, number of ranges, then the ranges
+	while (p + 7 <= end)
+	{
+		id = READUINT8(p);
+		if (id == 0xFF)
+			break;
+		tag = READUINT8(p);
+		size = READUINT32(p);
+		numranges = READUINT8(p);
+		if (!numranges || numranges > MAXRESUMERANGES || p + numranges*8 > end)
+			break;
+
+		for (f = transfer[node].txlist; f; f = f->next)
+			if (f->fileid == id && f->ram == SF_FILE)
+				break;
+
+		for (i = 0; i < numranges; i++)
+		{
+			UINT32 start = READUINT32(p);
+			UINT32 stop = READUINT32(p);
+			if (f)
+			{
+				f->rangestart[i] = start;
+				f->rangeend[i] = stop;
+			}
+		}
+
+		if (f)
+		{
+			f->resumetag = tag;
+			f->resumesize = size;
+			f->numranges = numranges;
+			DEBFILE(va("Node %d resuming file id %d\n", node, id));
+		}
+	}
+}
+
 // get request filepak and put it on the send queue
 // returns false if a requested file was not found or cannot be sent
 boolean Got_RequestFilePak(INT32 node)
@@ -456,11 +1098,20 @@ boolean Got_RequestFilePak(INT32 node)
 	char wad[MAX_WADPATH+1];
 	UINT8 *p = netbuffer->u.textcmd;
 	UINT8 id;
+
+	netcompression[node] = NETCOMPRESS_NONE;
+
 	while (p < netbuffer->u.textcmd + MAXTEXTCMD) // Don't allow hacked client to overflow
 	{
 		id = READUINT8(p);
 		if (id == 0xFF)
+		{
+			// Followed by the compression methods it understands, if any
+			if (p < (UINT8 *)netbuffer + doomcom->datalength)
+				netcompression[node] = READUINT8(p) & NETCOMPRESS_SUPPORTED;
+			SV_ReadResumeInfo(node, p);
 			break;
+		}
 		READSTRINGN(p, wad, MAX_WADPATH);
 		if (p >= netbuffer->u.textcmd + MAXTEXTCMD || !SV_SendFile(node, wad, id))
 		{
@@ -722,72 +1373,224 @@ static boolean SV_SendFile(INT32 node, const char *filename, UINT8 fileid)
 	return true;
 }
 
-/** Adds a memory block to the file list for a node
+/** Picks how to compress something for a node
   *
-  * \param node The node to send the memory block to
-  * \param data The memory block to send
-  * \param size The size of the block in bytes
-  * \param freemethod How to free the block after it has been sent
-  * \param fileid ???
-  * \sa SV_SendFile
+  * \param node The node it's going to
+  * \return The method from cv_netcompression if the node can take it,
+  *         NETCOMPRESS_LZF or NETCOMPRESS_NONE otherwise
   *
   */
-void SV_SendRam(INT32 node, void *data, size_t size, freemethod_t freemethod, UINT8 fileid)
+UINT8 SV_PickCompression(INT32 node)
 {
-	filetx_t **q; // A pointer to the "next" field of the last file in the list
-	filetx_t *p; // The new file request
-
-	// Find the last file in the list and set a pointer to its "next" field
-	q = &transfer[node].txlist;
-	while (*q)
-		q = &((*q)->next);
-
-	// Allocate a file request and append it to the file list
-	p = *q = (filetx_t *)malloc(sizeof (filetx_t));
-	if (!p)
-		I_Error("SV_SendRam: No more memory\n");
-
-	// Initialise with zeros
-	memset(p, 0, sizeof (filetx_t));
-
-	p->ram = freemethod; // Remember how to free the memory block for when we're done sending it
-	p->id.ram = data;
-	p->size = (UINT32)size;
-	p->fileid = fileid;
-	p->next = NULL; // End of list
-
-	DEBFILE(va("Sending ram %p(size:%u) to %d (id=%u)\n",p->id.ram,p->size,node,fileid));
+	UINT8 method = (UINT8)cv_netcompression.value;
 
-	filestosend++;
+	if (netcompression[node] & method & NETCOMPRESS_SUPPORTED)
+		return method;
+	if (netcompression[node] & NETCOMPRESS_LZF)
+		return NETCOMPRESS_LZF;
+	return NETCOMPRESS_NONE;
 }
 
-/** Stops sending a file for a node, and removes the file request from the list,
-  * either because the file has been fully sent or because the node was disconnected
+/** Compresses a block of memory at a given deflate level, without
+  * touching anything but the C library, so worker threads can use it
   *
-  * \param node The destination
+  * \return The compressed size, or 0 if it didn't fit in outlen bytes
   *
   */
-static void SV_EndFileSend(INT32 node)
+static size_t Net_CompressLevel(UINT8 method, INT32 level, const void *in, size_t inlen, void *out, size_t outlen)
 {
-	filetx_t *p = transfer[node].txlist;
-
-	// Free the file request according to the freemethod parameter used with SV_SendFile/Ram
-	switch (p->ram)
+#ifndef HAVE_ZLIB
+	(void)level;
+#endif
+	switch (method)
 	{
-		case SF_FILE: // It's a file, close it and free its filename
-			if (cv_noticedownload.value)
-				CONS_Printf("Ending file transfer (id %d) for node %d\n", p->fileid, node);
-			if (transferFiles[p->fileid].file)
-			{
-				if (transferFiles[p->fileid].count > 0)
-				{
-					transferFiles[p->fileid].count--;
+		case NETCOMPRESS_LZF:
+			return lzf_compress(in, (unsigned int)inlen, out, (unsigned int)outlen);
+#ifdef HAVE_ZLIB
+		case NETCOMPRESS_DEFLATE:
+		{
+			uLongf destlen = (uLongf)outlen;
+			if (compress2(out, &destlen, in, (uLong)inlen, level) != Z_OK)
+				return 0;
+			return destlen;
+		}
+#endif
+		default:
+			return 0;
+	}
+}
+
+/** Compresses a block of memory
+  *
+  * \return The compressed size, or 0 if it didn't fit in outlen bytes
+  *
+  */
+size_t Net_Compress(UINT8 method, const void *in, size_t inlen, void *out, size_t outlen)
+{
+	return Net_CompressLevel(method, cv_netcompressionlevel.value, in, inlen, out, outlen);
+}
+
+/** Decompresses a block of memory
+  *
+  * \return True if it decompressed to exactly outlen bytes
+  *
+  */
+boolean Net_Decompress(UINT8 method, const void *in, size_t inlen, void *out, size_t outlen)
+{
+	switch (method)
+	{
+		case NETCOMPRESS_LZF:
+			return lzf_decompress(in, (unsigned int)inlen, out, (unsigned int)outlen) == outlen;
+#ifdef HAVE_ZLIB
+		case NETCOMPRESS_DEFLATE:
+		{
+			uLongf destlen = (uLongf)outlen;
+			return uncompress(out, &destlen, in, (uLong)inlen) == Z_OK && destlen == outlen;
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+void Net_CountCompression(UINT8 method, size_t before, size_t after, boolean sent)
+{
+	if (method > NETCOMPRESS_DEFLATE)
+		return;
+	compressionstats[sent][method].count++;
+	compressionstats[sent][method].before += before;
+	compressionstats[sent][method].after += after;
+}
+
+void Command_NetCompression_f(void)
+{
+	const char *names[NETCOMPRESS_DEFLATE + 1] = {"none", "LZF", "deflate"};
+	INT32 i, j;
+
+	for (i = 1; i >= 0; i--)
+	{
+		CONS_Printf(i ? M_GetText("Sent:\n") : M_GetText("Received:\n"));
+		for (j = 0; j <= NETCOMPRESS_DEFLATE; j++)
+		{
+			if (!compressionstats[i][j].count)
+				continue;
+			CONS_Printf(M_GetText(" %-8s %u transfers, %s KB as %s KB (%d%%)\n"), names[j],
+				compressionstats[i][j].count,
+				sizeu1((size_t)(compressionstats[i][j].before>>10)),
+				sizeu2((size_t)(compressionstats[i][j].after>>10)),
+				compressionstats[i][j].before ? (INT32)(compressionstats[i][j].after*100/compressionstats[i][j].before) : 100);
+		}
+	}
+}
+
+// Header in front of SF_SHARED_RAM blocks. Whoever allocates one holds the
+// first reference, each SV_SendRam adds one, and each finished or aborted
+// transfer drops one.
+typedef union
+{
+	size_t refcount;
+	UINT64 align;
+} sharedram_t;
+
+void *SV_AllocSharedRam(size_t size)
+{
+	sharedram_t *block = malloc(sizeof (sharedram_t) + size);
+
+	if (!block)
+		return NULL;
+
+	block->refcount = 1;
+	return block + 1;
+}
+
+void *SV_RetainSharedRam(void *data)
+{
+	((sharedram_t *)data - 1)->refcount++;
+	return data;
+}
+
+void SV_ReleaseSharedRam(void *data)
+{
+	sharedram_t *block = (sharedram_t *)data - 1;
+
+	if (!--block->refcount)
+		free(block);
+}
+
+/** Adds a memory block to the file list for a node
+  *
+  * \param node The node to send the memory block to
+  * \param data The memory block to send
+  * \param size The size of the block in bytes
+  * \param freemethod How to free the block after it has been sent
+  * \param fileid ???
+  * \sa SV_SendFile
+  *
+  */
+void SV_SendRam(INT32 node, void *data, size_t size, freemethod_t freemethod, UINT8 fileid)
+{
+	filetx_t **q; // A pointer to the "next" field of the last file in the list
+	filetx_t *p; // The new file request
+
+	// Find the last file in the list and set a pointer to its "next" field
+	q = &transfer[node].txlist;
+	while (*q)
+		q = &((*q)->next);
+
+	// Allocate a file request and append it to the file list
+	p = *q = (filetx_t *)malloc(sizeof (filetx_t));
+	if (!p)
+		I_Error("SV_SendRam: No more memory\n");
+
+	// Initialise with zeros
+	memset(p, 0, sizeof (filetx_t));
+
+	p->ram = freemethod; // Remember how to free the memory block for when we're done sending it
+	p->id.ram = data;
+	if (freemethod == SF_SHARED_RAM)
+		SV_RetainSharedRam(data);
+	p->size = (UINT32)size;
+	p->fileid = fileid;
+	p->next = NULL; // End of list
+
+	DEBFILE(va("Sending ram %p(size:%u) to %d (id=%u)\n",p->id.ram,p->size,node,fileid));
+
+	filestosend++;
+}
+
+/** Stops sending a file for a node, and removes the file request from the list,
+  * either because the file has been fully sent or because the node was disconnected
+  *
+  * \param node The destination
+  *
+  */
+static void SV_EndFileSend(INT32 node)
+{
+	filetx_t *p = transfer[node].txlist;
+
+	// Free the file request according to the freemethod parameter used with SV_SendFile/Ram
+	switch (p->ram)
+	{
+		case SF_FILE: // It's a file, close it and free its filename
+			if (cv_noticedownload.value)
+				CONS_Printf("Ending file transfer (id %d) for node %d\n", p->fileid, node);
+			if (p->used && (p->used->file || p->used->map))
+			{
+				if (p->used->count > 0)
+				{
+					p->used->count--;
 				}
 
-				if (transferFiles[p->fileid].count == 0)
+				if (p->used->count == 0)
 				{
-					fclose(transferFiles[p->fileid].file);
-					transferFiles[p->fileid].file = NULL;
+#ifdef FILEMMAP
+					if (p->used->map)
+						munmap(p->used->map, p->used->mapsize);
+					p->used->map = NULL;
+#endif
+					if (p->used->file)
+						fclose(p->used->file);
+					p->used->file = NULL;
 				}
 			}
 			free(p->id.filename);
@@ -799,6 +1602,9 @@ static void SV_EndFileSend(INT32 node)
 			free(p->id.ram);
 		case SF_NOFREERAM: // Nothing to free
 			break;
+		case SF_SHARED_RAM: // Other nodes may still be sending it
+			SV_ReleaseSharedRam(p->id.ram);
+			break;
 	}
 
 	// Remove the file request from the list
@@ -807,149 +1613,468 @@ static void SV_EndFileSend(INT32 node)
 
 	// Indicate that the transmission is over
 	transfer[node].init = false;
+	if (!transfer[node].txlist)
+		transfer[node].window = 0; // Start slow again next time
 
 	filestosend--;
+
+	// Nobody is waiting on them anymore
+	if (!filestosend)
+	{
+		INT32 i;
+
+		Lock_compress();
+		for (i = 0; i <= UINT8_MAX; i++)
+		{
+			compressedfile_t *c = &compressedFiles[i];
+
+			if (c->state == FC_COMPRESSING)
+				c->cancel = true; // The worker cleans up after itself
+			else if (c->state != FC_NONE)
+			{
+				remove(c->path);
+				c->state = FC_NONE;
+			}
+		}
+		Unlock_compress();
+	}
 }
 
-/** Handles file transmission
+/** Compresses a file into its cache, one block at a time
   *
-  * \todo Use an acknowledging method more adapted to file transmission
-  *       The current download speed suffers from lack of ack packets,
-  *       especially when the one downloading has high latency
+  * Runs on its own thread, so it may only use the C library.
+  *
+  * \param userdata The compressedfile_t
   *
   */
-void SV_FileSendTicker(void)
+static void SV_CompressFileWorker(void *userdata)
 {
-	static INT32 currentnode = 0;
-	filetx_pak *p;
-	size_t size;
-	filetx_t *f;
-	INT32 packetsent, ram, i, j;
-
-	if (!filestosend) // No file to send
-		return;
-
-	packetsent = cv_downloadspeed.value;
+	compressedfile_t *c = userdata;
+	FILE *in = fopen(c->source, "rb");
+	FILE *out = fopen(c->path, "wb");
+	UINT8 *raw = malloc(FILECOMPRESSBLOCK);
+	UINT8 *packed = malloc(FILECOMPRESSHEADER + FILECOMPRESSBLOCK);
+	UINT32 done = 0, length = FILECOMPRESSHEADER;
+	boolean ok = (in && out && raw && packed);
+	boolean cancel = false;
+	UINT8 *p;
 
-	netbuffer->packettype = PT_FILEFRAGMENT;
+	if (ok)
+	{
+		p = packed;
+		WRITEMEM(p, FILECOMPRESSMAGIC, 4);
+		WRITEUINT8(p, c->tag);
+		WRITEUINT32(p, c->filesize);
+		ok = (fwrite(packed, 1, FILECOMPRESSHEADER, out) == FILECOMPRESSHEADER);
+	}
 
-	while (packetsent-- && filestosend != 0)
+	while (ok && !cancel && done < c->filesize)
 	{
-		for (i = currentnode, j = 0; j < MAXNETNODES;
-			i = (i+1) % MAXNETNODES, j++)
+		UINT32 rawlength = min(c->filesize - done, FILECOMPRESSBLOCK);
+		UINT32 blocklength;
+
+		if (fread(raw, 1, rawlength, in) != rawlength)
 		{
-			if (transfer[i].txlist)
-				goto found;
+			ok = false;
+			break;
 		}
-		// no transfer to do
-		I_Error("filestosend=%d but no file to send found\n", filestosend);
-	found:
-		currentnode = (i+1) % MAXNETNODES;
-		f = transfer[i].txlist;
-		ram = f->ram;
-
-		// Open the file if it isn't open yet, or
-		if (transfer[i].init == false)
+
+		// A block that doesn't get smaller is stored as it is
+		blocklength = (UINT32)Net_CompressLevel(c->method, c->level, raw, rawlength, packed + 4, rawlength - 1);
+		p = packed;
+		if (blocklength)
+			WRITEUINT32(p, blocklength);
+		else
 		{
-			if (!ram) // Sending a file
-			{
-				long filesize;
+			blocklength = rawlength;
+			WRITEUINT32(p, blocklength | FILECOMPRESSSTORED);
+			memcpy(packed + 4, raw, rawlength);
+		}
 
-				if (transferFiles[f->fileid].count == 0)
-				{
-					// It needs opened.
-					transferFiles[f->fileid].file =
-						fopen(f->id.filename, "rb");
-
-					if (!transferFiles[f->fileid].file)
-					{
-						I_Error("Can't open file %s: %s",
-							f->id.filename, strerror(errno));
-					}
-				}
+		if (fwrite(packed, 1, 4 + blocklength, out) != 4 + blocklength)
+			ok = false;
 
-				// Increment number of nodes using this file.
-				I_Assert(transferFiles[f->fileid].count < UINT8_MAX);
-				transferFiles[f->fileid].count++;
+		done += rawlength;
+		length += 4 + blocklength;
 
-				fseek(transferFiles[f->fileid].file, 0, SEEK_END);
-				filesize = ftell(transferFiles[f->fileid].file);
+		Lock_compress();
+		cancel = c->cancel;
+		Unlock_compress();
+	}
 
-				// Nobody wants to transfer a file bigger
-				// than 4GB!
-				if (filesize >= LONG_MAX)
-					I_Error("filesize of %s is too large", f->id.filename);
-				if (filesize == -1)
-					I_Error("Error getting filesize of %s", f->id.filename);
+	// Must come out smaller than the file, header included
+	if (ok && length >= c->filesize)
+		ok = false;
+
+	if (out && fclose(out))
+		ok = false;
+	if (in)
+		fclose(in);
+	free(raw);
+	free(packed);
+	free(c->source);
+	c->source = NULL;
+
+	Lock_compress();
+	if (c->cancel || !ok)
+		remove(c->path);
+	c->length = length;
+	c->state = c->cancel ? FC_NONE : (ok ? FC_READY : FC_FAILED);
+	c->cancel = false;
+	Unlock_compress();
+}
 
-				f->size = transferFiles[f->fileid].position = (UINT32)filesize;
-			}
+/** Starts compressing a file for a transfer, or checks on it
+  *
+  * Until the cache is ready, the transfer waits. A node that can't take
+  * the method it is being compressed with gets the file as it is.
+  *
+  * \param node The node the file is going to
+  * \param f The transfer, which hasn't started yet
+  * \return FC_READY to send the cache, FC_COMPRESSING to wait,
+  *         or FC_FAILED to send the file itself
+  *
+  */
+static filecompressstate_t SV_CompressFileTransfer(INT32 node, filetx_t *f)
+{
+	compressedfile_t *c = &compressedFiles[f->fileid];
+	UINT8 method = SV_PickCompression(node);
+	filecompressstate_t state;
+	long filesize;
+	FILE *handle;
+
+	if (method == NETCOMPRESS_NONE)
+		return FC_FAILED;
+
+	Lock_compress();
+	state = c->state;
+	Unlock_compress();
+
+	if (state == FC_COMPRESSING)
+		return FC_COMPRESSING;
+	if (state != FC_NONE)
+		return (state == FC_READY && c->method == method) ? FC_READY : FC_FAILED;
+
+	handle = fopen(f->id.filename, "rb");
+	if (!handle)
+		return FC_FAILED;
+	fseek(handle, 0, SEEK_END);
+	filesize = ftell(handle);
+	fclose(handle);
+	if (filesize <= FILECOMPRESSHEADER || filesize >= LONG_MAX)
+		return FC_FAILED;
+
+	c->source = strdup(f->id.filename);
+	if (!c->source)
+		return FC_FAILED;
+	snprintf(c->path, sizeof c->path, "%s" PATHSEP "netfile%d-%d.tmp", srb2home, serverinstance + 1, f->fileid);
+	c->method = method;
+	c->level = cv_netcompressionlevel.value;
+	c->tag = (UINT8)(method == NETCOMPRESS_DEFLATE ? method | (c->level << 4) : method);
+	c->filesize = (UINT32)filesize;
+	c->cancel = false;
+	c->state = FC_COMPRESSING;
+	DEBFILE(va("Compressing %s into %s\n", f->id.filename, c->path));
+
+#ifdef HAVE_THREADS
+	I_spawn_thread("file-compress", SV_CompressFileWorker, c);
+	return FC_COMPRESSING;
+#else
+	SV_CompressFileWorker(c);
+	return SV_CompressFileTransfer(node, f);
+#endif
+}
+
+/** Opens a file for sending, or joins the nodes already sending it
+  *
+  * Every transfer of the same file id shares one mapping of the whole file
+  * where the platform allows it, or one FILE otherwise. The same goes for
+  * its compressed cache.
+  *
+  * \param f The transfer, which hasn't started yet
+  * \param compressed Whether to send the cache from compressedFiles
+  *
+  */
+static void SV_OpenFileTransfer(filetx_t *f, boolean compressed)
+{
+	fileused_t *used = compressed ? &compressedFiles[f->fileid].used : &transferFiles[f->fileid];
+	const char *path = compressed ? compressedFiles[f->fileid].path : f->id.filename;
+	long filesize;
+
+	if (used->count == 0)
+	{
+		// It needs opened.
+		FILE *handle = fopen(path, "rb");
 
-			transfer[i].position = 0;
-			transfer[i].init = true; // Indicate that it is open
+		if (!handle)
+		{
+			I_Error("Can't open file %s: %s",
+				path, strerror(errno));
 		}
 
-		if (!ram)
+		fseek(handle, 0, SEEK_END);
+		filesize = ftell(handle);
+
+		// Nobody wants to transfer a file bigger
+		// than 4GB!
+		if (filesize >= LONG_MAX)
+			I_Error("filesize of %s is too large", path);
+		if (filesize == -1)
+			I_Error("Error getting filesize of %s", path);
+
+		used->file = handle;
+		used->map = NULL;
+		used->mapsize = (UINT32)filesize;
+		used->position = (UINT32)filesize;
+
+#ifdef FILEMMAP
+		if (filesize > 0)
 		{
-			// Seek to the right position if we aren't already there.
-			if (transferFiles[f->fileid].position != transfer[i].position)
+			void *map = mmap(NULL, (size_t)filesize, PROT_READ, MAP_SHARED, fileno(handle), 0);
+
+			if (map != MAP_FAILED)
 			{
-				fseek(transferFiles[f->fileid].file, transfer[i].position, SEEK_SET);
+				// Fragments go out in order, so have the kernel read ahead
+				madvise(map, (size_t)filesize, MADV_SEQUENTIAL);
+				used->map = map;
+				used->file = NULL;
+				fclose(handle);
 			}
 		}
+#endif
+	}
+
+	// Increment number of nodes using this file.
+	I_Assert(used->count < UINT8_MAX);
+	used->count++;
+
+	f->used = used;
+	f->compressed = compressed;
+	f->size = used->mapsize;
+	if (compressed)
+		Net_CountCompression(compressedFiles[f->fileid].method, compressedFiles[f->fileid].filesize, f->size, true);
+}
+
+/** Checks that a node resuming a transfer has part of what is being sent,
+  * or makes it start over if not
+  *
+  * \param f The transfer, opened but not started
+  *
+  */
+static void SV_CheckResume(filetx_t *f)
+{
+	UINT8 tag = 0;
+	UINT8 i;
+
+	if (!f->numranges)
+		return;
+
+	if (f->compressed)
+		tag = compressedFiles[f->fileid].tag;
+
+	if (tag != f->resumetag || (f->resumesize && f->resumesize != f->size))
+	{
+		DEBFILE(va("Can't resume file id %d, sending it again\n", f->fileid));
+		f->numranges = 0;
+		return;
+	}
+
+	for (i = 0; i < f->numranges; i++)
+	{
+		if (f->rangeend[i] > f->size)
+			f->rangeend[i] = f->size;
+
+		if (f->rangestart[i] >= f->rangeend[i]
+			|| (i && f->rangestart[i] < f->rangeend[i - 1]))
+		{
+			DEBFILE(va("Bad ranges to resume file id %d, sending it again\n", f->fileid));
+			f->numranges = 0;
+			return;
+		}
+	}
+}
 
-		// Build a packet containing a file fragment
-		p = &netbuffer->u.filetxpak;
-		size = software_MAXPACKETLENGTH - (FILETXHEADER + BASEPACKETSIZE);
+/** Sends a node the next fragment of its current transfer
+  *
+  * \param node The node to send to
+  * \return False if it couldn't be sent right now
+  *
+  */
+static boolean SV_SendFileFragment(INT32 node)
+{
+	filetx_pak *p;
+	size_t size;
+	UINT32 end;
+	filetx_t *f = transfer[node].txlist;
+	INT32 ram = f->ram;
+	fileused_t *used;
 
-		if (f->size - transfer[i].position < size)
+	// Open the file if it isn't open yet, or
+	if (transfer[node].init == false)
+	{
+		if (!ram) // Sending a file
 		{
-			size = f->size - transfer[i].position;
+			filecompressstate_t state = FC_FAILED;
+
+			// A node resuming the file as it is can't take it compressed
+			if (!(f->numranges && !f->resumetag))
+				state = SV_CompressFileTransfer(node, f);
+			if (state == FC_COMPRESSING)
+				return false; // Wait for it
+
+			SV_OpenFileTransfer(f, state == FC_READY);
 		}
 
-		if (ram)
+		SV_CheckResume(f);
+		transfer[node].position = f->numranges ? f->rangestart[0] : 0;
+		transfer[node].range = 0;
+		transfer[node].init = true; // Indicate that it is open
+	}
+	used = f->used;
+
+	// Build a packet containing a file fragment
+	netbuffer->packettype = PT_FILEFRAGMENT;
+	p = &netbuffer->u.filetxpak;
+	size = software_MAXPACKETLENGTH - (FILETXHEADER + BASEPACKETSIZE);
+	end = f->numranges ? f->rangeend[transfer[node].range] : f->size;
+
+	if (end - transfer[node].position < size)
+	{
+		size = end - transfer[node].position;
+	}
+
+	if (ram)
+	{
+		M_Memcpy(p->data, &f->id.ram[transfer[node].position], size);
+	}
+	else if (used->map)
+	{
+		M_Memcpy(p->data, &used->map[transfer[node].position], size);
+	}
+	else
+	{
+		// Seek to the right position if we aren't already there.
+		if (used->position != transfer[node].position)
 		{
-			M_Memcpy(p->data, &f->id.ram[transfer[i].position], size);
+			fseek(used->file, transfer[node].position, SEEK_SET);
 		}
-		else if (fread(p->data, 1, size, transferFiles[f->fileid].file) != size)
+
+		if (fread(p->data, 1, size, used->file) != size)
 		{
 			I_Error("SV_FileSendTicker: can't read %s byte on %s at %d because %s",
-				sizeu1(size), f->id.filename, transfer[i].position, M_FileError(transferFiles[f->fileid].file));
-
-			transferFiles[f->fileid].position = (UINT32)(transferFiles[f->fileid].position + size);
+				sizeu1(size), f->id.filename, transfer[node].position, M_FileError(used->file));
 		}
 
-		p->position = LONG(transfer[i].position);
-		// Put flag so receiver knows the total size
-		if (transfer[i].position + size == f->size)
-			p->position |= LONG(0x80000000);
-		p->fileid = f->fileid;
-		p->size = SHORT((UINT16)size);
+		used->position = (UINT32)(transfer[node].position + size);
+	}
+
+	p->position = LONG(transfer[node].position);
+	// Put flag so receiver knows the total size
+	if (transfer[node].position + size == f->size)
+		p->position |= LONG(0x80000000);
+	p->fileid = f->fileid;
+	p->size = SHORT((UINT16)size);
+
+	// Send the packet
+	if (!HSendPacket(node, true, 0, FILETXHEADER + size)) // Reliable SEND
+		return false; // Not sent for some odd reason, retry at next call
 
-		// Send the packet
-		if (HSendPacket(i, true, 0, FILETXHEADER + size)) // Reliable SEND
+	// Success
+	transfer[node].position = (UINT32)(transfer[node].position + size);
+
+	// Skip to the next range the node is missing
+	if (f->numranges && transfer[node].position == end)
+	{
+		if (++transfer[node].range < f->numranges)
+			transfer[node].position = f->rangestart[transfer[node].range];
+		else
+			transfer[node].position = f->size;
+	}
+
+	if (transfer[node].position == f->size) // Finish?
+	{
+		SV_EndFileSend(node);
+	}
+	return true;
+}
+
+#define MINSENDWINDOW 2
+
+/** Adjusts how many fragments a node may have unacknowledged
+  *
+  * Grows by one each tic the node keeps up and halves when fragments
+  * have to be resent, up to cv_downloadspeed.
+  *
+  * \param node The node being sent to
+  * \return How many more fragments can be sent to it this tic
+  *
+  */
+static INT32 SV_UpdateSendWindow(INT32 node)
+{
+	filetran_t *t = &transfer[node];
+	INT32 unacked = Net_GetNodeUnacked(node);
+
+	if (!t->window)
+		t->window = MINSENDWINDOW*2;
+
+	if (Net_TakeNodeResends(node))
+		t->window = max(t->window / 2, MINSENDWINDOW);
+	else if (unacked < t->window / 2)
+		t->window++;
+
+	if (t->window > cv_downloadspeed.value)
+		t->window = max(cv_downloadspeed.value, MINSENDWINDOW);
+
+	return t->window - unacked;
+}
+
+/** Handles file transmission
+  *
+  * Each node gets its own window of unacknowledged fragments; nodes take
+  * turns sending one fragment at a time so a fast one can't use up every
+  * free ack slot.
+  *
+  */
+void SV_FileSendTicker(void)
+{
+	static INT32 currentnode = 0;
+	INT32 budget[MAXNETNODES];
+	INT32 i, j;
+	boolean sent;
+
+	if (!filestosend) // No file to send
+		return;
+
+	for (i = 0; i < MAXNETNODES; i++)
+		budget[i] = transfer[i].txlist ? SV_UpdateSendWindow(i) : 0;
+
+	do
+	{
+		sent = false;
+		for (j = 0; j < MAXNETNODES && filestosend != 0; j++)
 		{
-			// Success
-			transfer[i].position = (UINT32)(transfer[i].position + size);
+			i = (currentnode + j) % MAXNETNODES;
+			if (budget[i] <= 0 || !transfer[i].txlist)
+				continue;
 
-			if (transfer[i].position == f->size) // Finish?
+			if (SV_SendFileFragment(i))
 			{
-				SV_EndFileSend(i);
+				budget[i]--;
+				sent = true;
 			}
+			else
+				budget[i] = 0; // can't send this one so why should i send the next?
 		}
-		else
-		{
-			// Not sent for some odd reason, retry at next call
-			// Exit the while (can't send this one so why should i send the next?)
-			break;
-		}
-	}
+	} while (sent && filestosend != 0);
+
+	currentnode = (currentnode + 1) % MAXNETNODES;
 }
 
 void Got_Filetxpak(void)
 {
 	INT32 filenum = netbuffer->u.filetxpak.fileid;
 	fileneeded_t *file = &fileneeded[filenum];
+	partfile_t *part = &partfiles[filenum];
 	char *filename = file->filename;
 	static INT32 filetime = 0;
 
@@ -978,11 +2103,17 @@ void Got_Filetxpak(void)
 	{
 		if (file->file)
 			I_Error("Got_Filetxpak: already open file\n");
-		file->file = fopen(filename, "wb");
+		if (part->resumable)
+			CL_OpenPartial(filenum);
+		else
+		{
+			file->file = fopen(filename, "wb");
+			file->currentsize = 0;
+			part->unmapped = 0;
+		}
 		if (!file->file)
 			I_Error("Can't create file %s: %s", filename, strerror(errno));
 		CONS_Printf("\r%s...\n",filename);
-		file->currentsize = 0;
 		file->status = FS_DOWNLOADING;
 	}
 
@@ -990,32 +2121,88 @@ void Got_Filetxpak(void)
 	{
 		UINT32 pos = LONG(netbuffer->u.filetxpak.position);
 		UINT16 size = SHORT(netbuffer->u.filetxpak.size);
+		boolean done;
+
+		// A server resuming the file never sends the start again
+		if (part->resumed && (pos & ~0x80000000) == 0)
+			CL_RestartPartial(filenum);
+
 		// Use a special trick to know when the file is complete (not always used)
 		// WARNING: file fragments can arrive out of order so don't stop yet!
 		if (pos & 0x80000000)
 		{
 			pos &= ~0x80000000;
 			file->totalsize = pos + size;
+			part->sizeknown = true;
 		}
+		if (pos == 0 && size >= FILECOMPRESSHEADER && part->resumable)
+			part->tag = memcmp(netbuffer->u.filetxpak.data, FILECOMPRESSMAGIC, 4) ? 0 : netbuffer->u.filetxpak.data[4];
 		// We can receive packet in the wrong order, anyway all os support gaped file
 		fseek(file->file, pos, SEEK_SET);
 		if (fwrite(netbuffer->u.filetxpak.data,size,1,file->file) != 1)
 			I_Error("Can't write to %s: %s\n",filename, M_FileError(file->file));
-		file->currentsize += size;
+		if (part->resumable)
+			file->currentsize += CL_AddPartRange(part, pos, pos + size);
+		else
+			file->currentsize += size;
+
+		// Compressed streams are unpacked as they arrive, and a bad one
+		// fails once it is complete, so the server can finish sending it
+		// Fragments the map had no room for still count towards finishing,
+		// but then nothing vouches for the file, so it's checked at the end
+		done = (file->currentsize == file->totalsize || (part->unmapped && part->sizeknown
+			&& file->currentsize + part->unmapped >= file->totalsize));
+		if (part->tag && !CL_UnpackPartial(filenum, done))
+			part->badstream = true;
 
 		// Finished?
-		if (file->currentsize == file->totalsize)
+		if (done)
 		{
+			boolean resumed = part->resumed || part->unmapped;
+			boolean badstream = false;
+
+			if (part->tag)
+			{
+				badstream = (part->badstream || part->unpackedsize != part->rawsize
+					|| part->unpacked != file->totalsize || fflush(part->unpackfile));
+				if (!badstream)
+					Net_CountCompression(part->tag & 0x0F, part->rawsize, file->totalsize, false);
+			}
+
 			fclose(file->file);
 			file->file = NULL;
+			if (part->unpackfile)
+				fclose(part->unpackfile);
+			part->unpackfile = NULL;
+
+			if (badstream)
+				CL_DropPartial(filenum);
+			else if (part->resumable)
+				CL_FinishPartial(filenum);
 			file->status = FS_FOUND;
-			CONS_Printf(M_GetText("Downloading %s...(done)\n"),
-				filename);
+
+			if (badstream)
+			{
+				CONS_Alert(CONS_ERROR, M_GetText("Can't decompress %s\n"), filename);
+				file->status = FS_MD5SUMBAD;
+			}
+			// Pieced together from more than one attempt, so make sure
+			else if (resumed && checkfilemd5(filename, file->md5sum) == FS_MD5SUMBAD)
+			{
+				CONS_Alert(CONS_ERROR, M_GetText("Resumed download of %s is corrupt\n"), filename);
+				remove(filename);
+				file->status = FS_MD5SUMBAD;
+			}
+			else
+				CONS_Printf(M_GetText("Downloading %s...(done)\n"),
+					filename);
 #ifndef NONET
 			downloadcompletednum++;
 			downloadcompletedsize += file->totalsize;
 #endif
 		}
+		else if (part->resumable && ++part->unsaved >= PARTSAVEFRAGMENTS)
+			CL_SavePartial(filenum);
 	}
 	else
 	{
@@ -1086,9 +2273,20 @@ void CloseNetFile(void)
 	for (i = 0; i < MAX_WADFILES; i++)
 		if (fileneeded[i].status == FS_DOWNLOADING && fileneeded[i].file)
 		{
-			fclose(fileneeded[i].file);
-			// File is not complete delete it
-			remove(fileneeded[i].filename);
+			if (partfiles[i].resumable)
+			{
+				// Keep what arrived for the next attempt
+				CL_SavePartial(i);
+				fclose(fileneeded[i].file);
+				CL_StopUnpacking(i);
+			}
+			else
+			{
+				fclose(fileneeded[i].file);
+				// File is not complete delete it
+				remove(fileneeded[i].filename);
+			}
+			fileneeded[i].file = NULL;
 		}
 
 	// Remove PT_FILEFRAGMENT from acknowledge list
@@ -1199,239 +2397,448 @@ size_t curlwrite_data(void *ptr, size_t size, size_t nmemb, FILE *stream)
 {
     size_t written;
     written = fwrite(ptr, size, nmemb, stream);
+    curl_received += written * size;
     return written;
 }
 
+static void curlprogress(httptransfer_t *t, double dltotal, double dlnow)
+{
+	fileneeded_t *file = &fileneeded[t->filenum];
+
+	file->currentsize = t->resumefrom + (UINT32)dlnow;
+	if (dltotal > 0)
+		file->totalsize = t->resumefrom + (UINT32)dltotal;
+}
+
 #ifdef XFERINFOFUNCTION
 static int curlprogress_callbackx(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
 {
-	time_t curtime;
-
-	(void)clientp;
 	(void)ultotal;
 	(void)ulnow; // Function prototype requires these but we won't use, so just discard
 
-	curtime = time(NULL);
-
-	curl_dlnow = dlnow;
-	curl_dltotal = dltotal;
-
-	if (curtime > curl_starttime)
-	{
-		getbytes = curl_dlnow / (curtime - curl_starttime); // To-do: Make this more accurate???
-	}
-	else
-	{
-		getbytes = 0;
-	}
-
+	curlprogress(clientp, (double)dltotal, (double)dlnow);
 	return 0;
 }
 #else
 static int curlprogress_callback(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow)
 {
-	time_t curtime;
-
-	(void)clientp;
 	(void)ultotal;
 	(void)ulnow; // Function prototype requires these but we won't use, so just discard
 
-	curtime = time(NULL);
-
-	curl_dlnow = dlnow;
-	curl_dltotal = dltotal;
-
-	if (curtime > curl_starttime)
-	{
-		getbytes = curl_dlnow / (curtime - curl_starttime); // To-do: Make this more accurate???
-	}
-	else
-	{
-		getbytes = 0;
-	}
-
+	curlprogress(clientp, dltotal, dlnow);
 	return 0;
 }
 #endif
 
+/** Queues a file to be downloaded over HTTP, and starts the download
+  * thread if it isn't running
+  *
+  * \param url Where to download it from
+  * \param dfilenum The file
+  *
+  */
 void CURLPrepareFile(const char* url, int dfilenum)
 {
+	static boolean initialized = false;
+	fileneeded_t *file = &fileneeded[dfilenum];
+	httptransfer_t t;
 	HTTP_login *login;
+	char partpath[PARTPATHLEN];
 
 #ifdef PARANOIA
 	if (M_CheckParm("-nodownload"))
 		I_Error("Attempted to download files in -nodownload mode");
 #endif
 
-	if (!multi_handle)
+	if (!initialized)
 	{
 		curl_global_init(CURL_GLOBAL_ALL);
-		multi_handle = curl_multi_init();
+		initialized = true;
 	}
 
-	http_handle = curl_easy_init();
+	I_mkdir(downloaddir, 0755);
 
-	if (http_handle && multi_handle)
+	memset(&t, 0, sizeof t);
+	t.filenum = dfilenum;
+	t.origfilesize = file->currentsize;
+	t.origtotalfilesize = file->totalsize;
+	nameonly(file->filename);
+	snprintf(t.url, sizeof t.url, "%s/%s", url, file->filename);
+
+	// Authenticate if the user so wishes
+	login = CURLGetLogin(url, NULL);
+	if (login)
+		t.auth = strdup(login->auth);
+
+	CONS_Printf("Downloading %s from %s\n", file->filename, url);
+
+	strcatbf(file->filename, downloaddir, "/");
+
+	// The web server has the file as it is, so carry on from the first gap
+	file->file = NULL;
+	if (CL_LoadPartial(dfilenum) && !partfiles[dfilenum].tag)
 	{
-		I_mkdir(downloaddir, 0755);
+		CL_PartPath(partpath, dfilenum, "");
+		file->file = fopen(partpath, "r+b");
+		t.resumefrom = partfiles[dfilenum].end[0];
+		if (file->file && fseek(file->file, t.resumefrom, SEEK_SET))
+		{
+			fclose(file->file);
+			file->file = NULL;
+		}
+	}
+	if (!file->file)
+	{
+		t.resumefrom = 0;
+		CL_DropPartial(dfilenum);
+		CL_PartPath(partpath, dfilenum, "");
+		file->file = fopen(partpath, "wb");
+	}
+	else
+		CONS_Printf("Resuming %s at %s KB\n", partpath, sizeu1(t.resumefrom >> 10));
+	file->totalsize = t.origtotalfilesize;
+	file->currentsize = t.resumefrom;
 
-		curl_curfile = &fileneeded[dfilenum];
-		curl_realname = curl_curfile->filename;
-		nameonly(curl_realname);
+	if (!file->file)
+	{
+		CONS_Alert(CONS_WARNING, "Couldn't start HTTP download of %s\n", file->filename);
+		free(t.auth);
+		file->status = FS_FALLBACK;
+		curl_failedwebdownload = true;
+		return;
+	}
 
-		curl_origfilesize = curl_curfile->currentsize;
-		curl_origtotalfilesize = curl_curfile->totalsize;
+	Lock_curl();
+	file->status = FS_REQUESTED;
+	curl_pending[curl_numpending++] = t;
+	curl_transfers++;
+	curl_running = true;
+	if (!curl_thread)
+	{
+		curl_thread = true;
+		curl_received = 0;
+		curl_starttime = time(NULL);
+#ifdef HAVE_THREADS
+		I_spawn_thread("http-download", (I_thread_fn)CURLGetFile, NULL);
+#endif
+	}
+	Unlock_curl();
+}
+
+void CURLAbortFile(void)
+{
+	curl_running = false;
+}
 
-		curl_easy_setopt(http_handle, CURLOPT_URL, va("%s/%s", url, curl_realname));
+/** Hands a queued file to curl
+  *
+  * Runs on the download thread, so everything else was done by
+  * CURLPrepareFile beforehand.
+  *
+  * \param t The free transfer slot to use, filled in from curl_pending
+  * \return False if curl couldn't start it
+  *
+  */
+static boolean CURLStartFile(httptransfer_t *t)
+{
+	fileneeded_t *file = &fileneeded[t->filenum];
+	char useragent[32];
+	CURL *handle = curl_easy_init();
+
+	if (handle)
+	{
+		curl_easy_setopt(handle, CURLOPT_URL, t->url);
 
 		// Only allow HTTP and HTTPS
 #if defined(CURL_AT_LEAST_VERSION) && CURL_AT_LEAST_VERSION(7, 85, 0)
-		curl_easy_setopt(http_handle, CURLOPT_PROTOCOLS_STR, "http,https");
+		curl_easy_setopt(handle, CURLOPT_PROTOCOLS_STR, "http,https");
 #else
-		curl_easy_setopt(http_handle, CURLOPT_PROTOCOLS, CURLPROTO_HTTP|CURLPROTO_HTTPS);
+		curl_easy_setopt(handle, CURLOPT_PROTOCOLS, CURLPROTO_HTTP|CURLPROTO_HTTPS);
 #endif
 
-		curl_easy_setopt(http_handle, CURLOPT_USERAGENT, va("SRB2Kart/v%d.%d", VERSION, SUBVERSION)); // Set user agent as some servers won't accept invalid user agents.
+		snprintf(useragent, sizeof useragent, "SRB2Kart/v%d.%d", VERSION, SUBVERSION);
+		curl_easy_setopt(handle, CURLOPT_USERAGENT, useragent); // Set user agent as some servers won't accept invalid user agents.
 
-		// Authenticate if the user so wishes
-		login = CURLGetLogin(url, NULL);
-
-		if (login)
-		{
-			curl_easy_setopt(http_handle, CURLOPT_USERPWD, login->auth);
-		}
+		if (t->auth)
+			curl_easy_setopt(handle, CURLOPT_USERPWD, t->auth);
 
 		// Follow a redirect request, if sent by the server.
-		curl_easy_setopt(http_handle, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
 
-		curl_easy_setopt(http_handle, CURLOPT_FAILONERROR, 1L);
+		curl_easy_setopt(handle, CURLOPT_FAILONERROR, 1L);
 
-		CONS_Printf("Downloading %s from %s\n", curl_realname, url);
+		if (t->resumefrom)
+			curl_easy_setopt(handle, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)t->resumefrom);
 
-		strcatbf(curl_curfile->filename, downloaddir, "/");
-		curl_curfile->file = fopen(curl_curfile->filename, "wb");
-		curl_easy_setopt(http_handle, CURLOPT_WRITEDATA, curl_curfile->file);
-		curl_easy_setopt(http_handle, CURLOPT_WRITEFUNCTION, curlwrite_data);
-		curl_easy_setopt(http_handle, CURLOPT_NOPROGRESS, 0L);
+		curl_easy_setopt(handle, CURLOPT_WRITEDATA, file->file);
+		curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, curlwrite_data);
+		curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
 #ifdef XFERINFOFUNCTION
-		curl_easy_setopt(http_handle, CURLOPT_XFERINFOFUNCTION, curlprogress_callbackx);
+		curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, curlprogress_callbackx);
+		curl_easy_setopt(handle, CURLOPT_XFERINFODATA, t);
 #else
-		curl_easy_setopt(http_handle, CURLOPT_PROGRESSFUNCTION, curlprogress_callback);
+		curl_easy_setopt(handle, CURLOPT_PROGRESSFUNCTION, curlprogress_callback);
+		curl_easy_setopt(handle, CURLOPT_PROGRESSDATA, t);
 #endif
+	}
 
-		curl_curfile->status = FS_DOWNLOADING;
-		lastfilenum = dfilenum;
-		curl_multi_add_handle(multi_handle, http_handle);
+	// curl keeps its own copy
+	free(t->auth);
+	t->auth = NULL;
 
-		curl_multi_perform(multi_handle, &curl_runninghandles);
-		curl_starttime = time(NULL);
+	if (!handle)
+	{
+		CL_KeepHTTPPartial(t); // The fallback can carry on from there
+		return false;
+	}
 
-		curl_running = true;
-#ifdef HAVE_THREADS
-		I_spawn_thread("http-download", (I_thread_fn)CURLGetFile, NULL);
-#endif
+	t->handle = handle;
+	file->status = FS_DOWNLOADING;
+	lastfilenum = t->filenum;
+	curl_multi_add_handle(multi_handle, handle);
+	return true;
+}
+
+/** Checks a downloaded file, then hands it over to the game
+  *
+  * Runs on its own thread so the other downloads carry on meanwhile.
+  *
+  * \param file The file, which has been moved into place
+  *
+  */
+static void CURLCheckFile(fileneeded_t *file)
+{
+	char filename[MAX_WADPATH];
+	filestatus_t status = checkfilemd5(file->filename, file->md5sum);
+
+	strlcpy(filename, file->filename, sizeof filename);
+	nameonly(filename);
+
+	Lock_curl();
+	if (status == FS_MD5SUMBAD)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("HTTP Download of %s finished but is corrupt or has been modified\n"), filename);
+		file->status = FS_FALLBACK;
+		curl_failedwebdownload = true;
+	}
+	else
+	{
+		CONS_Printf(M_GetText("Finished HTTP download of %s\n"), filename);
+		downloadcompletednum++;
+		downloadcompletedsize += file->totalsize;
+		file->status = FS_FOUND;
 	}
+	if (curl_transfers > 0)
+		curl_transfers--;
+	Unlock_curl();
 }
 
-void CURLAbortFile(void)
+/** Wraps up a download curl is done with, whether it worked or not
+  *
+  * \param t The transfer
+  * \param easyres How it went
+  *
+  */
+static void CURLFinishFile(httptransfer_t *t, CURLcode easyres)
 {
-	curl_running = false;
+	fileneeded_t *file = &fileneeded[t->filenum];
+	char filename[MAX_WADPATH];
+
+	strlcpy(filename, file->filename, sizeof filename);
+	nameonly(filename);
+
+	if (easyres != CURLE_OK)
+	{
+		long response_code = 0;
+		char responsecode[32];
+		const char *easy_handle_error;
+
+		if (easyres == CURLE_HTTP_RETURNED_ERROR)
+			curl_easy_getinfo(t->handle, CURLINFO_RESPONSE_CODE, &response_code);
+
+		if (response_code)
+		{
+			snprintf(responsecode, sizeof responsecode, "HTTP response code %ld", response_code);
+			easy_handle_error = responsecode;
+		}
+		else
+			easy_handle_error = curl_easy_strerror(easyres);
+		CL_KeepHTTPPartial(t); // The fallback can carry on from there
+		file->currentsize = t->origfilesize;
+		CONS_Printf(M_GetText("Failed to download %s (%s)\n"), filename, easy_handle_error);
+
+		Lock_curl();
+		file->status = FS_FALLBACK;
+		curl_failedwebdownload = true;
+		if (curl_transfers > 0)
+			curl_transfers--;
+		Unlock_curl();
+	}
+	else
+	{
+		fclose(file->file);
+		file->file = NULL;
+		CL_FinishPartial(t->filenum);
+#ifdef HAVE_THREADS
+		I_spawn_thread("http-md5", (I_thread_fn)CURLCheckFile, file);
+#else
+		CURLCheckFile(file);
+#endif
+	}
+
+	curl_multi_remove_handle(multi_handle, t->handle);
+	curl_easy_cleanup(t->handle);
+	t->handle = NULL;
 }
 
+/** Runs the queued HTTP downloads, up to http_downloads at a time,
+  * until there are none left or they are aborted
+  */
 void CURLGetFile(void)
 {
 	CURLMcode mc; /* return code used by curl_multi_wait() */
-	CURLcode easyres; /* Return from easy interface */
 	CURLMsg *m; /* for picking up messages with the transfer status */
-	CURL *e;
 	int msgs_left; /* how many messages are left */
-	const char *easy_handle_error;
-	boolean running = true;
-	long response_code = 0;
-	static char *filename;
-
-	while (running && curl_running)
-    {
-    	if (curl_runninghandles)
+	int runninghandles;
+	INT32 i, active;
+	time_t curtime;
+
+	multi_handle = curl_multi_init();
+
+restart:
+	while (multi_handle)
+	{
+		active = 0;
+		for (i = 0; i < MAXHTTPDOWNLOADS; i++)
+			if (curl_active[i].handle)
+				active++;
+
+		// Start as many of the queued files as allowed
+		Lock_curl();
+		if (!curl_running)
 		{
-			curl_multi_perform(multi_handle, &curl_runninghandles);
+			Unlock_curl();
+			break;
+		}
+		for (i = 0; i < MAXHTTPDOWNLOADS && curl_numpending && active < cv_httpdownloads.value; i++)
+		{
+			if (curl_active[i].handle)
+				continue;
 
-			/* wait for activity, timeout or "nothing" */
-			mc = curl_multi_wait(multi_handle, NULL, 0, 1000, NULL);
+			curl_active[i] = curl_pending[0];
+			memmove(curl_pending, curl_pending + 1, --curl_numpending * sizeof (*curl_pending));
 
-			if (mc != CURLM_OK)
+			if (CURLStartFile(&curl_active[i]))
+				active++;
+			else
 			{
-				CONS_Alert(CONS_WARNING, "curl_multi_wait() failed, code %d.\n", mc);
-				continue;
+				CONS_Alert(CONS_WARNING, "Couldn't start HTTP download of %s\n", fileneeded[curl_active[i].filenum].filename);
+				fileneeded[curl_active[i].filenum].status = FS_FALLBACK;
+				curl_failedwebdownload = true;
+				curl_transfers--;
 			}
-			curl_curfile->currentsize = curl_dlnow;
-			curl_curfile->totalsize = curl_dltotal;
+		}
+		if (!active && !curl_numpending)
+		{
+			// Nothing left to do
+			Unlock_curl();
+			break;
+		}
+		Unlock_curl();
+
+		curl_multi_perform(multi_handle, &runninghandles);
+
+		/* wait for activity, timeout or "nothing" */
+		mc = curl_multi_wait(multi_handle, NULL, 0, 1000, NULL);
+
+		if (mc != CURLM_OK)
+		{
+			CONS_Alert(CONS_WARNING, "curl_multi_wait() failed, code %d.\n", mc);
+			continue;
 		}
 
 		/* See how the transfers went */
 		while ((m = curl_multi_info_read(multi_handle, &msgs_left)))
 		{
-			if (m && (m->msg == CURLMSG_DONE))
-			{
-				running = false;
-				e = m->easy_handle;
-				easyres = m->data.result;
-
-				filename = Z_StrDup(curl_realname);
-				nameonly(filename);
+			if (m->msg != CURLMSG_DONE)
+				continue;
 
-				if (easyres != CURLE_OK)
+			for (i = 0; i < MAXHTTPDOWNLOADS; i++)
+				if (curl_active[i].handle == m->easy_handle)
 				{
-					if (easyres == CURLE_HTTP_RETURNED_ERROR)
-						curl_easy_getinfo(e, CURLINFO_RESPONSE_CODE, &response_code);
-
-					easy_handle_error = (response_code) ? va("HTTP response code %ld", response_code) : curl_easy_strerror(easyres);
-					curl_curfile->status = FS_FALLBACK;
-					curl_curfile->currentsize = curl_origfilesize;
-					curl_curfile->totalsize = curl_origtotalfilesize;
-					curl_failedwebdownload = true;
-					fclose(curl_curfile->file);
-					remove(curl_curfile->filename);
-					CONS_Printf(M_GetText("Failed to download %s (%s)\n"), filename, easy_handle_error);
-				}
-				else
-				{
-					fclose(curl_curfile->file);
-
-					if (checkfilemd5(curl_curfile->filename, curl_curfile->md5sum) == FS_MD5SUMBAD)
-					{
-						CONS_Alert(CONS_ERROR, M_GetText("HTTP Download of %s finished but is corrupt or has been modified\n"), filename);
-						curl_curfile->status = FS_FALLBACK;
-						curl_failedwebdownload = true;
-					}
-					else
-					{
-						CONS_Printf(M_GetText("Finished HTTP download of %s\n"), filename);
-						downloadcompletednum++;
-						downloadcompletedsize += curl_curfile->totalsize;
-						curl_curfile->status = FS_FOUND;
-					}
+					CURLFinishFile(&curl_active[i], m->data.result);
+					break;
 				}
+		}
 
-				Z_Free(filename);
-				curl_curfile->file = NULL;
-				curl_transfers--;
-				curl_multi_remove_handle(multi_handle, e);
-				curl_easy_cleanup(e);
+		curtime = time(NULL);
+		if (curtime > curl_starttime)
+			curl_getbps = (UINT32)(curl_received / (curtime - curl_starttime));
+	}
 
-				if (!curl_transfers)
-					break;
-			}
-		}
+	// Aborted partway, so keep what arrived for next time
+	for (i = 0; i < MAXHTTPDOWNLOADS; i++)
+	{
+		if (!curl_active[i].handle)
+			continue;
+		CL_KeepHTTPPartial(&curl_active[i]);
+		curl_multi_remove_handle(multi_handle, curl_active[i].handle);
+		curl_easy_cleanup(curl_active[i].handle);
+		curl_active[i].handle = NULL;
 	}
 
-    if (!curl_transfers || !curl_running)
-    {
-		curl_multi_cleanup(multi_handle);
-		curl_global_cleanup();
-		multi_handle = NULL;
-    }
+	Lock_curl();
+	if (multi_handle && curl_running && curl_numpending)
+	{
+		// More were queued while it was stopping
+		Unlock_curl();
+		goto restart;
+	}
+	for (i = 0; i < curl_numpending; i++)
+	{
+		CL_KeepHTTPPartial(&curl_pending[i]);
+		free(curl_pending[i].auth);
+	}
+	curl_numpending = 0;
+	curl_thread = false;
 	curl_running = false;
+	Unlock_curl();
+
+	if (multi_handle)
+		curl_multi_cleanup(multi_handle);
+	multi_handle = NULL;
+}
+
+/** Keeps what an HTTP download got through before it stopped, and closes it
+  *
+  * \param t The transfer
+  *
+  */
+static void CL_KeepHTTPPartial(httptransfer_t *t)
+{
+	fileneeded_t *file = &fileneeded[t->filenum];
+	partfile_t *part = &partfiles[t->filenum];
+	long written;
+
+	fflush(file->file);
+	written = ftell(file->file);
+	fclose(file->file);
+	file->file = NULL;
+	file->totalsize = t->origtotalfilesize;
+
+	// It came in order from the start, and as the file itself
+	part->tag = 0;
+	part->sizeknown = true;
+	part->numranges = 0;
+	if (written > 0 && (UINT32)written < t->origtotalfilesize)
+	{
+		part->start[0] = 0;
+		part->end[0] = (UINT32)written;
+		part->numranges = 1;
+		CL_SavePartial(t->filenum);
+	}
+	else
+		CL_DropPartial(t->filenum);
 }
 
 HTTP_login *
@@ -14,15 +14,34 @@
 #define __D_NETFIL__
 
 #include "w_wad.h"
+#include "d_net.h"
 
 typedef enum
 {
 	SF_FILE,
 	SF_Z_RAM,
 	SF_RAM,
-	SF_NOFREERAM
+	SF_NOFREERAM,
+	SF_SHARED_RAM // from SV_AllocSharedRam, freed after its last transfer
 } freemethod_t;
 
+// Compression methods for savegames and file transfers. Nodes say which
+// ones they can decompress, and the server picks one per transfer.
+typedef enum
+{
+	NETCOMPRESS_NONE    = 0,
+	NETCOMPRESS_LZF     = 1,
+	NETCOMPRESS_DEFLATE = 1<<1,
+} netcompress_t;
+
+#ifdef HAVE_ZLIB
+#define NETCOMPRESS_SUPPORTED (NETCOMPRESS_LZF|NETCOMPRESS_DEFLATE)
+#else
+#define NETCOMPRESS_SUPPORTED NETCOMPRESS_LZF
+#endif
+
+extern UINT8 netcompression[MAXNETNODES];
+
 typedef enum
 {
 	FS_NOTCHECKED,
@@ -63,6 +82,7 @@ extern UINT32 totalfilesrequestedsize;
 extern boolean curl_failedwebdownload;
 extern boolean curl_running;
 extern INT32 curl_transfers;
+extern UINT32 curl_getbps; // All the HTTP downloads together
 
 typedef struct HTTP_login HTTP_login;
 
@@ -83,6 +103,15 @@ INT32 CL_CheckFiles(void);
 boolean CL_LoadServerFiles(void);
 void SV_SendRam(INT32 node, void *data, size_t size, freemethod_t freemethod,
 	UINT8 fileid);
+void *SV_AllocSharedRam(size_t size);
+void *SV_RetainSharedRam(void *data);
+void SV_ReleaseSharedRam(void *data);
+
+UINT8 SV_PickCompression(INT32 node);
+size_t Net_Compress(UINT8 method, const void *in, size_t inlen, void *out, size_t outlen);
+boolean Net_Decompress(UINT8 method, const void *in, size_t inlen, void *out, size_t outlen);
+void Net_CountCompression(UINT8 method, size_t before, size_t after, boolean sent);
+void Command_NetCompression_f(void);
 
 void SV_FileSendTicker(void);
 void Got_Filetxpak(void);
@@ -126,6 +126,10 @@ UINT32 I_GetSongPosition(void)
     return 0;
 }
 
+void I_UpdateSongLagThreshold(void)
+{
+}
+
 /// ------------------------
 //  MUSIC PLAYBACK
 /// ------------------------
@@ -134,34 +138,29 @@ boolean I_LoadSong(char *data, size_t len)
 {
 	(void)data;
 	(void)len;
-	return -1;
+	return false;
 }
 
 void I_UnloadSong(void)
 {
-	(void)handle;
 }
 
 boolean I_PlaySong(boolean looping)
 {
-	(void)handle;
 	(void)looping;
 	return false;
 }
 
 void I_StopSong(void)
 {
-	(void)handle;
 }
 
 void I_PauseSong(void)
 {
-	(void)handle;
 }
 
 void I_ResumeSong(void)
 {
-	(void)handle;
 }
 
 void I_SetMusicVolume(UINT8 volume)
@@ -188,18 +187,20 @@ void I_StopFadingSong(void)
 {
 }
 
-boolean I_FadeSongFromVolume(UINT8 target_volume, UINT8 source_volume, UINT32 ms, void (*callback)(void));
+boolean I_FadeSongFromVolume(UINT8 target_volume, UINT8 source_volume, UINT32 ms, void (*callback)(void))
 {
 	(void)target_volume;
 	(void)source_volume;
 	(void)ms;
+	(void)callback;
 	return false;
 }
 
-boolean I_FadeSong(UINT8 target_volume, UINT32 ms, void (*callback)(void));
+boolean I_FadeSong(UINT8 target_volume, UINT32 ms, void (*callback)(void))
 {
 	(void)target_volume;
 	(void)ms;
+	(void)callback;
 	return false;
 }
 
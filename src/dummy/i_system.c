@@ -21,6 +21,12 @@ UINT64 I_GetPrecisePrecision(void) {
 	return 1000000;
 }
 
+INT32 I_ForkInstances(INT32 count)
+{
+	(void)count;
+	return 0;
+}
+
 void I_GetEvent(void){}
 
 void I_OsPolling(void){}
@@ -1,6 +1,11 @@
 #include "../doomdef.h"
 #include "../command.h"
 #include "../i_video.h"
+#include "../i_system.h"
+#ifdef HAVE_SDL
+#include "SDL.h"
+#include "../sdl/sdlmain.h"
+#endif
 
 rendermode_t rendermode = render_none;
 
@@ -8,8 +13,13 @@ boolean highcolor = false;
 
 boolean allow_fullscreen = false;
 
+UINT8 graphics_started = 0;
+
 consvar_t cv_vidwait = {"vid_wait", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+static CV_PossibleValue_t keyboardlayout_cons_t[] = {{1,"Default US"}, {2, "Native"}, {3, "AZERTY"}, {0, NULL}};
+consvar_t cv_keyboardlayout = {"keyboardlayout", "Default US", CV_SAVE, keyboardlayout_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 void I_StartupGraphics(void){}
 
 void I_ShutdownGraphics(void){}
@@ -65,3 +75,21 @@ void I_BeginRead(void){}
 
 void I_EndRead(void){}
 
+UINT32 I_GetRefreshRate(void)
+{
+	return 0;
+}
+
+boolean I_UseNativeKeyboard(void)
+{
+	return false;
+}
+
+void I_StartupMouse(void){}
+
+void I_OsPolling(void){}
+
+#ifdef HAVE_SDL
+// the SDL system layer still calls this when it shuts down or errors out
+void SDLforceUngrabMouse(void){}
+#endif
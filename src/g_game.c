@@ -53,6 +53,7 @@
 #include "k_director.h" // SRB2kart
 #include "k_kart.h" // SRB2kart
 #include "r_fps.h" // frame interpolation/uncapped
+#include "m_perfstats.h" // benchdemo breakdown
 
 #ifdef HAVE_DISCORDRPC
 #include "discord.h"
@@ -8073,6 +8074,182 @@ void G_TimeDemo(const char *name)
 	G_DeferedPlayDemo(name);
 }
 
+//
+// G_BenchDemo
+// Plays a replay back with no drawing or sound, running game logic as fast
+// as it will go, then reports tics/sec, a per-subsystem breakdown and a
+// checksum of the final game state. Two builds that agree on the checksum
+// simulated the replay identically.
+//
+static struct
+{
+	boolean restoresound;
+	tic_t tics;
+	precise_t wall;
+	precise_t tictime;
+	precise_t playerthink;
+	precise_t thinkers;
+	precise_t luahooks;
+	UINT64 checkposition;
+	UINT64 mobjhooks;
+	UINT64 scenerybatch;
+} bench;
+
+void G_BenchDemo(const char *name)
+{
+	memset(&bench, 0, sizeof (bench));
+	bench.restoresound = sound_disabled;
+	S_StopSounds();
+	sound_disabled = true;
+	nodrawers = true;
+	demo.benchmark = true;
+	singletics = true;
+	G_DeferedPlayDemo(name);
+}
+
+static void G_StopBenchmark(void)
+{
+	demo.benchmark = false;
+	nodrawers = false;
+	singletics = false;
+	sound_disabled = bench.restoresound;
+}
+
+//
+// G_BenchmarkTicker
+// Called by D_SRB2Loop in place of the normal frame while a benchdemo runs.
+//
+void G_BenchmarkTicker(void)
+{
+	precise_t start = I_GetPreciseTime();
+	INT32 i;
+
+	for (i = 0; i < TICRATE && demo.benchmark; i++)
+	{
+		const boolean counted = (demo.playback && gamestate == GS_LEVEL && !demo.deferstart);
+
+		if (!TryRunTics(1))
+			break;
+
+		if (!demo.benchmark)
+			return; // The replay ended during this tic and the report has been printed.
+
+		if (!counted)
+			continue;
+
+		bench.tics++;
+		bench.tictime += ps_tictime.value.p;
+		bench.playerthink += ps_playerthink_time.value.p;
+		bench.thinkers += ps_thinkertime.value.p;
+		bench.luahooks += ps_lua_prethinkframe_time.value.p
+			+ ps_lua_thinkframe_time.value.p
+			+ ps_lua_postthinkframe_time.value.p;
+		bench.checkposition += ps_checkposition_calls.value.i;
+		bench.mobjhooks += ps_lua_mobjhooks.value.i;
+		bench.scenerybatch += ps_scenerybatch_commits.value.i;
+	}
+
+	bench.wall += I_GetPreciseTime() - start;
+
+	// The playdemo command failed; nothing is going to end the benchmark for us.
+	if (demo.benchmark && !demo.playback && gamestate != GS_LEVEL)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("benchdemo: the replay could not be started.\n"));
+		G_StopBenchmark();
+		if (demo.quitafterplaying)
+			I_Quit();
+	}
+}
+
+//
+// G_GameStateChecksum
+// Hashes the simulation state (rather than anything the renderer touches)
+// in thinker order, so two runs of the same replay can be compared.
+//
+#define CHECKSUMMIX(h, v) h = (h ^ (UINT32)(v)) * 16777619u
+
+UINT32 G_GameStateChecksum(void)
+{
+	UINT32 hash = 2166136261u;
+	thinker_t *th;
+	INT32 i;
+
+	CHECKSUMMIX(hash, leveltime);
+	CHECKSUMMIX(hash, P_GetRandSeed());
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		player_t *p = &players[i];
+
+		if (!playeringame[i])
+			continue;
+
+		CHECKSUMMIX(hash, i);
+		CHECKSUMMIX(hash, p->playerstate);
+		CHECKSUMMIX(hash, p->health);
+		CHECKSUMMIX(hash, p->laps);
+		CHECKSUMMIX(hash, p->realtime);
+		CHECKSUMMIX(hash, p->kartstuff[k_position]);
+		CHECKSUMMIX(hash, p->kartstuff[k_itemtype]);
+		CHECKSUMMIX(hash, p->kartstuff[k_itemamount]);
+	}
+
+	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	{
+		mobj_t *mo;
+
+		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+			continue;
+
+		mo = (mobj_t *)th;
+		CHECKSUMMIX(hash, mo->type);
+		CHECKSUMMIX(hash, mo->x);
+		CHECKSUMMIX(hash, mo->y);
+		CHECKSUMMIX(hash, mo->z);
+		CHECKSUMMIX(hash, mo->momx);
+		CHECKSUMMIX(hash, mo->momy);
+		CHECKSUMMIX(hash, mo->momz);
+		CHECKSUMMIX(hash, mo->angle);
+		CHECKSUMMIX(hash, mo->health);
+		CHECKSUMMIX(hash, mo->flags);
+		CHECKSUMMIX(hash, mo->flags2);
+		CHECKSUMMIX(hash, mo->state ? mo->state - states : -1);
+		CHECKSUMMIX(hash, mo->tics);
+		CHECKSUMMIX(hash, mo->fuse);
+		CHECKSUMMIX(hash, mo->scale);
+	}
+
+	return hash;
+}
+
+#undef CHECKSUMMIX
+
+static void G_BenchmarkReport(void)
+{
+	const UINT32 checksum = G_GameStateChecksum();
+	const UINT64 ticks = I_GetPrecisePrecision();
+	const double precision = (double)ticks;
+	const double wallsecs = bench.wall / precision;
+	const double tictime = bench.tictime ? (double)bench.tictime : 1.0;
+	const precise_t other = bench.tictime - min(bench.tictime, bench.playerthink + bench.thinkers + bench.luahooks);
+
+#define BENCHPART(name, t) CONS_Printf("  %-16s %10.3f ms %6.2f%%\n", name, (t) * 1000.0 / precision / max(bench.tics, 1), (t) * 100.0 / tictime)
+	CONS_Printf(M_GetText("benchdemo: %u tics in %.3f seconds, %.1f tics/sec\n"),
+		bench.tics, wallsecs, wallsecs > 0.0 ? bench.tics / wallsecs : 0.0);
+	CONS_Printf(M_GetText("Average per tic:\n"));
+	BENCHPART("Game logic", bench.tictime);
+	BENCHPART("Player think", bench.playerthink);
+	BENCHPART("Thinkers", bench.thinkers);
+	BENCHPART("Lua think hooks", bench.luahooks);
+	BENCHPART("Other", other);
+#undef BENCHPART
+	CONS_Printf(M_GetText("  %-16s %10.1f\n"), "CheckPosition", (double)bench.checkposition / max(bench.tics, 1));
+	CONS_Printf(M_GetText("  %-16s %10.1f\n"), "Lua mobj hooks", (double)bench.mobjhooks / max(bench.tics, 1));
+	if (bench.scenerybatch)
+		CONS_Printf(M_GetText("  %-16s %10.1f\n"), "Batched scenery", (double)bench.scenerybatch / max(bench.tics, 1));
+	CONS_Printf(M_GetText("Game state checksum: %08x\n"), checksum);
+}
+
 void G_DoPlayMetal(void)
 {
 	lumpnum_t l;
@@ -8254,6 +8431,17 @@ boolean G_CheckDemoStatus(void)
 
 	// DO NOT end metal sonic demos here
 
+	if (demo.benchmark)
+	{
+		G_BenchmarkReport();
+		G_StopDemo();
+		G_StopBenchmark();
+		if (demo.quitafterplaying)
+			I_Quit();
+		D_StartTitle();
+		return true;
+	}
+
 	if (demo.timing)
 	{
 		INT32 demotime;
@@ -47,6 +47,7 @@ struct demovars_s {
 	char titlename[65];
 	textinput_t titlenameinput;
 	boolean recording, playback, timing;
+	boolean benchmark; // headless benchdemo run, see G_BenchDemo
 	UINT16 version; // Current file format of the demo being played
 	boolean title; // Title Screen demo can be cancelled by any key
 	boolean rewinding; // Rewind in progress
@@ -358,6 +359,9 @@ extern demoghost *ghosts;
 
 void G_DoPlayDemo(char *defdemoname);
 void G_TimeDemo(const char *name);
+void G_BenchDemo(const char *name);
+void G_BenchmarkTicker(void);
+UINT32 G_GameStateChecksum(void);
 void G_AddGhost(char *defdemoname);
 void G_UpdateStaffGhostName(lumpnum_t l);
 void G_DoPlayMetal(void);
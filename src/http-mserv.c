@@ -27,6 +27,7 @@ Documentation available here.
 #include "mserv.h"
 #include "i_tcp.h"/* for current_port */
 #include "i_threads.h"
+#include "i_system.h"/* I_AddExitFunc */
 
 /* reasonable default I guess?? */
 #define DEFAULT_BUFFER_SIZE (4096)
@@ -57,14 +58,28 @@ consvar_t cv_masterserver_token = {
 
 #ifdef MASTERSERVER
 
+/*
+All master server traffic goes through one curl multi handle, so
+requests run side by side instead of one blocking call at a time.
+With threads, a single worker drives it and hands finished requests
+back to the main thread, which runs their callbacks in HMS_ticker.
+Without threads, HMS_ticker drives it too, which never blocks either.
+
+Serial requests (listing, updating, unlisting and changing the API)
+run one at a time in the order they were queued, so that each sees
+the server token or API the previous one left behind.
+*/
+
 static int hms_started;
 
-static char *hms_api;
-#ifdef HAVE_THREADS
-static I_mutex hms_api_mutex;
-#endif
+static CURLM *hms_multi;
+static const char *hms_bindaddr;
 
+/* only ever touched by whoever drives hms_multi */
+static char *hms_api;
 static char *hms_server_token;
+static int   hms_transfers;
+static int   hms_serial_busy;
 
 struct HMS_buffer
 {
@@ -74,6 +89,48 @@ struct HMS_buffer
 	int    end;
 };
 
+struct HMS_request
+{
+	/* returns the transfer to run, or NULL if there's nothing to send */
+	struct HMS_buffer * (*start)  (struct HMS_request *);
+	/* makes sense of the response, before it's freed */
+	void                (*finish) (struct HMS_request *);
+
+	HMS_done_fn done;
+	int         id;
+
+	int serial;
+	int ok;
+
+	/* copied from the main thread when the request was made */
+	char *token;
+	char *text;
+
+	char *post;
+	struct HMS_buffer *hms;
+	void *result;
+
+	struct HMS_request *next;
+};
+
+/* queued by the main thread, not started yet */
+static struct HMS_request *hms_pending;
+static struct HMS_request *hms_waiting;/* the worker's, blocked by a serial request */
+/* finished, for the main thread to call back */
+static struct HMS_request *hms_finished;
+
+#ifdef HAVE_THREADS
+static I_mutex hms_mutex;
+static I_cond  hms_cond;
+static int     hms_quit;
+
+#  define Lock_queue()   I_lock_mutex  (&hms_mutex)
+#  define Unlock_queue() I_unlock_mutex (hms_mutex)
+#else/*HAVE_THREADS*/
+#  define Lock_queue()
+#  define Unlock_queue()
+#endif/*HAVE_THREADS*/
+
 static void
 Contact_error (void)
 {
@@ -126,7 +183,7 @@ HMS_on_read (char *s, size_t _1, size_t n, void *userdata)
 }
 
 static struct HMS_buffer *
-HMS_connect (const char *format, ...)
+HMS_connect (struct HMS_request *req, const char *format, ...)
 {
 	va_list ap;
 	CURL *curl;
@@ -136,19 +193,11 @@ HMS_connect (const char *format, ...)
 	size_t token_length;
 	struct HMS_buffer *buffer;
 
-	if (! hms_started)
+	if (! hms_api)
 	{
-		if (curl_global_init(CURL_GLOBAL_ALL) != 0)
-		{
-			Contact_error();
-			Blame("From curl_global_init.\n");
-			return NULL;
-		}
-		else
-		{
-			atexit(curl_global_cleanup);
-			hms_started = 1;
-		}
+		Contact_error();
+		Blame("No master server set.\n");
+		return NULL;
 	}
 
 	curl = curl_easy_init();
@@ -160,9 +209,9 @@ HMS_connect (const char *format, ...)
 		return NULL;
 	}
 
-	if (cv_masterserver_token.string && cv_masterserver_token.string[0])
+	if (req->token)
 	{
-		quack_token = curl_easy_escape(curl, cv_masterserver_token.string, 0);
+		quack_token = curl_easy_escape(curl, req->token, 0);
 		token_length = ( sizeof "&token="-1 )+ strlen(quack_token);
 	}
 	else
@@ -171,10 +220,6 @@ HMS_connect (const char *format, ...)
 		token_length = 0;
 	}
 
-#ifdef HAVE_THREADS
-	I_lock_mutex(&hms_api_mutex);
-#endif
-
 	seek = strlen(hms_api) + 1;/* + '/' */
 
 	va_start (ap, format);
@@ -185,10 +230,6 @@ HMS_connect (const char *format, ...)
 
 	sprintf(url, "%s/", hms_api);
 
-#ifdef HAVE_THREADS
-	I_unlock_mutex(hms_api_mutex);
-#endif
-
 	va_start (ap, format);
 	seek += vsprintf(&url[seek], format, ap);
 	va_end (ap);
@@ -213,18 +254,20 @@ HMS_connect (const char *format, ...)
 		curl_easy_setopt(curl, CURLOPT_STDERR, logstream);
 	}
 
-	if (M_CheckParm("-bindaddr") && M_IsNextParm())
+	if (hms_bindaddr)
 	{
-		curl_easy_setopt(curl, CURLOPT_INTERFACE, M_GetNextParm());
+		curl_easy_setopt(curl, CURLOPT_INTERFACE, hms_bindaddr);
 	}
 
 	curl_easy_setopt(curl, CURLOPT_URL, url);
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 	curl_easy_setopt(curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);/* we're not on the main thread */
 
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, cv_masterserver_timeout.value);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HMS_on_read);
 	curl_easy_setopt(curl, CURLOPT_WRITEDATA, buffer);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, req);
 
 	curl_free(quack_token);
 	free(url);
@@ -233,20 +276,17 @@ HMS_connect (const char *format, ...)
 }
 
 static int
-HMS_do (struct HMS_buffer *buffer)
+HMS_check (struct HMS_buffer *buffer, CURLcode cc)
 {
-	CURLcode cc;
 	long status;
 
 	char *p;
 
-	cc = curl_easy_perform(buffer->curl);
-
 	if (cc != CURLE_OK)
 	{
 		Contact_error();
 		Blame(
-				"From curl_easy_perform: %s\n",
+				"From curl: %s\n",
 				curl_easy_strerror(cc)
 		);
 		return 0;
@@ -285,25 +325,365 @@ HMS_end (struct HMS_buffer *buffer)
 	free(buffer);
 }
 
-int
-HMS_register (void)
+static void
+Free_request (struct HMS_request *req)
 {
-	struct HMS_buffer *hms;
-	int ok;
+	free(req->token);
+	free(req->text);
+	free(req->post);
+	free(req->result);
+	free(req);
+}
+
+/* Appends to one of the queues above. */
+static void
+Append_request (struct HMS_request **queue, struct HMS_request *req)
+{
+	while (*queue)
+		queue = &(*queue)->next;
+
+	req->next = NULL;
+	*queue = req;
+}
+
+static void
+Finish_request (struct HMS_request *req)
+{
+	if (req->hms)
+	{
+		if (req->finish)
+			req->finish(req);
+
+		HMS_end(req->hms);
+		req->hms = NULL;
+	}
+
+	if (req->serial)
+		hms_serial_busy = 0;
+
+	Lock_queue();
+	{
+		Append_request(&hms_finished, req);
+	}
+	Unlock_queue();
+}
+
+/* Starts whatever may start; returns whether anything finished. */
+static int
+Start_requests (void)
+{
+	struct HMS_request *req;
+	struct HMS_request *next;
+	struct HMS_request *queue;
+	int quit = 0;
+	int progress = 0;
+
+	Lock_queue();
+	{
+		queue = hms_pending;
+		hms_pending = NULL;
+#ifdef HAVE_THREADS
+		quit = hms_quit;
+#endif
+	}
+	Unlock_queue();
+
+	/* serial requests left over from last time go first */
+	for (req = queue; req; req = next)
+	{
+		next = req->next;
+		Append_request(&hms_waiting, req);
+	}
+
+	queue = hms_waiting;
+	hms_waiting = NULL;
+
+	for (req = queue; req; req = next)
+	{
+		next = req->next;
+
+		if (quit && ! req->serial)
+		{
+			/* nobody is left to look at the answer */
+			Free_request(req);
+			continue;
+		}
+
+		if (req->serial && hms_serial_busy)
+		{
+			Append_request(&hms_waiting, req);
+			continue;
+		}
+
+		req->hms = req->start(req);
+
+		if (req->hms)
+		{
+			if (req->serial)
+				hms_serial_busy = 1;
+
+			curl_multi_add_handle(hms_multi, req->hms->curl);
+			hms_transfers++;
+		}
+		else
+		{
+			Finish_request(req);
+			progress = 1;
+		}
+	}
+
+	return progress;
+}
+
+static void
+Pump_requests (void)
+{
+	struct HMS_request *req;
+	CURLMsg *msg;
+	int left;
+	int running;
+	int progress;
+
+	do
+	{
+		progress = Start_requests();
+
+		curl_multi_perform(hms_multi, &running);
+
+		while (( msg = curl_multi_info_read(hms_multi, &left) ))
+		{
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+
+			req->ok = HMS_check(req->hms, msg->data.result);
+
+			curl_multi_remove_handle(hms_multi, msg->easy_handle);
+			hms_transfers--;
+
+			Finish_request(req);
+			progress = 1;
+		}
+	}
+	while (progress);
+}
+
+static void
+Wait_requests (int ms)
+{
+#if LIBCURL_VERSION_NUM >= 0x074400/* 7.68.0, curl_multi_wakeup */
+	curl_multi_poll(hms_multi, NULL, 0, ms, NULL);
+#else
+	/* can't be woken up early, so don't sleep long */
+	curl_multi_wait(hms_multi, NULL, 0, min(ms, 100), NULL);
+#endif
+}
+
+#ifdef HAVE_THREADS
+static void
+HMS_worker (void *userdata)
+{
+	int idle;
+	int quit;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		Lock_queue();
+		{
+			while (
+					! hms_pending &&
+					! hms_waiting &&
+					! hms_transfers &&
+					! hms_quit
+			){
+				I_hold_cond(&hms_cond, hms_mutex);
+			}
+
+			idle = ( ! hms_pending && ! hms_waiting && ! hms_transfers );
+			quit = hms_quit;
+		}
+		Unlock_queue();
+
+		/* unlisting on the way out still gets through */
+		if (quit && idle)
+			break;
+
+		Pump_requests();
+
+		if (hms_transfers)
+			Wait_requests(1000);
+	}
+}
+#endif/*HAVE_THREADS*/
 
-	char post[256];
+static void
+HMS_stop (void)
+{
+#ifdef HAVE_THREADS
+	/* the worker finishes what's queued, then I_stop_threads waits for it */
+	Lock_queue();
+	{
+		hms_quit = 1;
+		I_wake_one_cond(&hms_cond);
+	}
+	Unlock_queue();
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(hms_multi);
+#endif
+#else/*HAVE_THREADS*/
+	Pump_requests();
+
+	while (hms_transfers || hms_waiting)
+	{
+		Wait_requests(100);
+		Pump_requests();
+	}
+#endif/*HAVE_THREADS*/
+}
+
+static int
+HMS_start (void)
+{
+	if (hms_started)
+		return 1;
+
+	/* neither of these are safe to do from another thread */
+	if (curl_global_init(CURL_GLOBAL_ALL) != 0)
+	{
+		Contact_error();
+		Blame("From curl_global_init.\n");
+		return 0;
+	}
+
+	atexit(curl_global_cleanup);
+
+	hms_multi = curl_multi_init();
+
+	if (! hms_multi)
+	{
+		Contact_error();
+		Blame("From curl_multi_init.\n");
+		return 0;
+	}
+
+	if (M_CheckParm("-bindaddr") && M_IsNextParm())
+		hms_bindaddr = M_GetNextParm();
+
+	hms_started = 1;
+
+#ifdef HAVE_THREADS
+	I_spawn_thread("masterserver", HMS_worker, NULL);
+#endif
+
+	I_AddExitFunc(HMS_stop);
+
+	return 1;
+}
+
+static struct HMS_request *
+New_request (
+		struct HMS_buffer * (*start) (struct HMS_request *),
+		void (*finish) (struct HMS_request *),
+		int serial,
+		HMS_done_fn done,
+		int id
+){
+	struct HMS_request *req;
+
+	req = calloc(1, sizeof *req);
+
+	if (! req)
+		abort();
+
+	req->start  = start;
+	req->finish = finish;
+	req->serial = serial;
+	req->done   = done;
+	req->id     = id;
+
+	if (cv_masterserver_token.string && cv_masterserver_token.string[0])
+		req->token = strdup(cv_masterserver_token.string);
 
+	return req;
+}
+
+static void
+Queue_request (struct HMS_request *req)
+{
+	if (! HMS_start())
+	{
+		if (req->done)
+			req->done(0, NULL, req->id);
+
+		Free_request(req);
+		return;
+	}
+
+	Lock_queue();
+	{
+		Append_request(&hms_pending, req);
+#ifdef HAVE_THREADS
+		I_wake_one_cond(&hms_cond);
+#endif
+	}
+	Unlock_queue();
+
+#if defined (HAVE_THREADS) && LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(hms_multi);
+#endif
+}
+
+void
+HMS_ticker (void)
+{
+	struct HMS_request *req;
+	struct HMS_request *next;
+
+	if (! hms_started)
+		return;
+
+#ifndef HAVE_THREADS
+	Pump_requests();
+#endif
+
+	Lock_queue();
+	{
+		req = hms_finished;
+		hms_finished = NULL;
+	}
+	Unlock_queue();
+
+	for (; req; req = next)
+	{
+		next = req->next;
+
+		if (req->done)
+			req->done(req->ok, req->result, req->id);
+
+		Free_request(req);
+	}
+}
+
+static struct HMS_buffer *
+Start_register (struct HMS_request *req)
+{
+	struct HMS_buffer *hms;
 	char *contact;
 
-	hms = HMS_connect(
+	hms = HMS_connect(req,
 			"games/%s/%d/servers/register", SRB2APPLICATION, MODVERSION);
 
 	if (! hms)
-		return 0;
+		return NULL;
 
-	contact = curl_easy_escape(hms->curl, cv_server_contact.string, 0);
+	contact = curl_easy_escape(hms->curl, req->text, 0);
 
-	snprintf(post, sizeof post,
+	req->post = malloc(256);
+	snprintf(req->post, 256,
 			"port=%d&"
 			"contact=%s",
 
@@ -314,98 +694,140 @@ HMS_register (void)
 
 	curl_free(contact);
 
-	curl_easy_setopt(hms->curl, CURLOPT_POSTFIELDS, post);
+	curl_easy_setopt(hms->curl, CURLOPT_POSTFIELDS, req->post);
 
-	ok = HMS_do(hms);
+	return hms;
+}
+
+static void
+Finish_register (struct HMS_request *req)
+{
+	char *server_token;
 
-	if (ok)
+	if (req->ok)
 	{
-		hms_server_token = strdup(strtok(hms->buffer, "\n"));
+		server_token = strtok(req->hms->buffer, "\n");
+
+		free(hms_server_token);
+		hms_server_token = ( server_token ? strdup(server_token) : NULL );
 	}
+}
+
+void
+HMS_register (HMS_done_fn done, int id)
+{
+	struct HMS_request *req;
 
-	HMS_end(hms);
+	req = New_request(Start_register, Finish_register, 1, done, id);
+	req->text = strdup(cv_server_contact.string);
 
-	return ok;
+	Queue_request(req);
 }
 
-int
-HMS_unlist (void)
+static struct HMS_buffer *
+Start_unlist (struct HMS_request *req)
 {
 	struct HMS_buffer *hms;
-	int ok;
 
-	hms = HMS_connect("servers/%s/unlist", hms_server_token);
+	/* never listed, or the listing failed */
+	if (! hms_server_token)
+		return NULL;
+
+	hms = HMS_connect(req, "servers/%s/unlist", hms_server_token);
+
+	free(hms_server_token);
+	hms_server_token = NULL;
 
 	if (! hms)
-		return 0;
+		return NULL;
 
 	curl_easy_setopt(hms->curl, CURLOPT_POST, 1);
 	curl_easy_setopt(hms->curl, CURLOPT_POSTFIELDSIZE, 0);
 
-	ok = HMS_do(hms);
-	HMS_end(hms);
-
-	free(hms_server_token);
+	return hms;
+}
 
-	return ok;
+void
+HMS_unlist (HMS_done_fn done, int id)
+{
+	Queue_request(New_request(Start_unlist, NULL, 1, done, id));
 }
 
-int
-HMS_update (void)
+static struct HMS_buffer *
+Start_update (struct HMS_request *req)
 {
 	struct HMS_buffer *hms;
-	int ok;
-
-	char post[256];
-
 	char *title;
 
-	hms = HMS_connect("servers/%s/update", hms_server_token);
+	if (! hms_server_token)
+		return NULL;
+
+	hms = HMS_connect(req, "servers/%s/update", hms_server_token);
 
 	if (! hms)
-		return 0;
+		return NULL;
 
-	title = curl_easy_escape(hms->curl, cv_servername.string, 0);
+	title = curl_easy_escape(hms->curl, req->text, 0);
 
-	snprintf(post, sizeof post,
+	req->post = malloc(256);
+	snprintf(req->post, 256,
 			"title=%s",
 			title
 	);
 
 	curl_free(title);
 
-	curl_easy_setopt(hms->curl, CURLOPT_POSTFIELDS, post);
+	curl_easy_setopt(hms->curl, CURLOPT_POSTFIELDS, req->post);
 
-	ok = HMS_do(hms);
-	HMS_end(hms);
-
-	return ok;
+	return hms;
 }
 
 void
-HMS_list_servers (void)
+HMS_update (HMS_done_fn done, int id)
 {
-	struct HMS_buffer *hms;
+	struct HMS_request *req;
 
-	hms = HMS_connect("games/%s/%d/servers", SRB2APPLICATION, MODVERSION);
+	req = New_request(Start_update, NULL, 1, done, id);
+	req->text = strdup(cv_servername.string);
 
-	if (! hms)
-		return;
+	Queue_request(req);
+}
+
+static struct HMS_buffer *
+Start_fetch_servers (struct HMS_request *req)
+{
+	return HMS_connect(req, "games/%s/%d/servers", SRB2APPLICATION, MODVERSION);
+}
 
-	if (HMS_do(hms) && cv_masterserver_debug.value)
+static void
+Finish_list_servers (struct HMS_request *req)
+{
+	if (req->ok)
+		req->result = strdup(req->hms->buffer);
+}
+
+static void
+Print_server_list (int ok, void *result, int id)
+{
+	(void)id;
+
+	if (ok && cv_masterserver_debug.value)
 	{
-		CONS_Printf("%s\n", hms->buffer);
+		CONS_Printf("%s\n", (char *)result);
 	}
-
-	HMS_end(hms);
 }
 
-msg_server_t *
-HMS_fetch_servers (msg_server_t *list, int query_id)
+void
+HMS_list_servers (void)
 {
-	struct HMS_buffer *hms;
+	Queue_request(New_request(Start_fetch_servers, Finish_list_servers, 0,
+				Print_server_list, 0));
+}
 
-	int doing_shit;
+static void
+Finish_fetch_servers (struct HMS_request *req)
+{
+	msg_server_t *list;
 
 	char *address;
 	char *port;
@@ -416,146 +838,128 @@ HMS_fetch_servers (msg_server_t *list, int query_id)
 
 	int i;
 
-	(void)query_id;
+	if (! req->ok)
+		return;
 
-	hms = HMS_connect("games/%s/%d/servers", SRB2APPLICATION, MODVERSION);
+	/* +1 for easy test */
+	list = calloc(MAXSERVERLIST + 1, sizeof *list);
 
-	if (! hms)
-		return NULL;
+	p = req->hms->buffer;
+	i = 0;
 
-	if (HMS_do(hms))
+	while (i < MAXSERVERLIST && ( end = strchr(p, '\n') ))
 	{
-		doing_shit = 1;
+		*end = '\0';
 
-		p = hms->buffer;
-		i = 0;
+		address = strtok(p, " ");
+		port    = strtok(0, " ");
+		contact = strtok(0, "");
 
-		while (i < MAXSERVERLIST && ( end = strchr(p, '\n') ))
+		if (address && port)
 		{
-			*end = '\0';
-
-			address = strtok(p, " ");
-			port    = strtok(0, " ");
-			contact = strtok(0, "");
+			strlcpy(list[i].ip,      address, sizeof list[i].ip);
+			strlcpy(list[i].port,    port,    sizeof list[i].port);
 
-			if (address && port)
+			if (contact)
 			{
-#ifdef HAVE_THREADS
-				I_lock_mutex(&ms_QueryId_mutex);
-				{
-					if (query_id != ms_QueryId)
-						doing_shit = 0;
-				}
-				I_unlock_mutex(ms_QueryId_mutex);
-
-				if (! doing_shit)
-					break;
-#endif
-
-				strlcpy(list[i].ip,      address, sizeof list[i].ip);
-				strlcpy(list[i].port,    port,    sizeof list[i].port);
-
-				if (contact)
-				{
-					strlcpy(list[i].contact, contact, sizeof list[i].contact);
-				}
+				strlcpy(list[i].contact, contact, sizeof list[i].contact);
+			}
 
-				list[i].header.buffer[0] = 1;
+			list[i].header.buffer[0] = 1;
 
-				i++;
+			i++;
 
-				p = ( end + 1 );/* skip server delimiter */
-			}
-			else
-			{
-				/* malformed so quit the parsing */
-				break;
-			}
+			p = ( end + 1 );/* skip server delimiter */
+		}
+		else
+		{
+			/* malformed so quit the parsing */
+			break;
 		}
-
-		if (doing_shit)
-			list[i].header.buffer[0] = 0;
 	}
-	else
-		list = NULL;
 
-	HMS_end(hms);
+	list[i].header.buffer[0] = 0;
 
-	return list;
+	req->result = list;
 }
 
-int
-HMS_compare_mod_version (char *buffer, size_t buffer_size)
+void
+HMS_fetch_servers (HMS_done_fn done, int id)
 {
-	struct HMS_buffer *hms;
-	int ok;
+	Queue_request(New_request(Start_fetch_servers, Finish_fetch_servers, 0,
+				done, id));
+}
 
+static struct HMS_buffer *
+Start_compare_mod_version (struct HMS_request *req)
+{
+	return HMS_connect(req, "games/%s/version", SRB2APPLICATION);
+}
+
+static void
+Finish_compare_mod_version (struct HMS_request *req)
+{
 	char *version;
 	char *version_name;
 
-	hms = HMS_connect("games/%s/version", SRB2APPLICATION);
+	if (! req->ok)
+		return;
 
-	if (! hms)
-		return 0;
+	req->ok = 0;
 
-	ok = 0;
+	version      = strtok(req->hms->buffer, " ");
+	version_name = strtok(0, "\n");
 
-	if (HMS_do(hms))
+	if (version && version_name)
 	{
-		version      = strtok(hms->buffer, " ");
-		version_name = strtok(0, "\n");
-
-		if (version && version_name)
+		if (atoi(version) != MODVERSION)
 		{
-			if (atoi(version) != MODVERSION)
-			{
-				strlcpy(buffer, version_name, buffer_size);
-				ok = 1;
-			}
-			else
-				ok = -1;
+			req->result = strdup(version_name);
+			req->ok = 1;
 		}
+		else
+			req->ok = -1;
 	}
+}
 
-	HMS_end(hms);
-
-	return ok;
+void
+HMS_compare_mod_version (HMS_done_fn done, int id)
+{
+	Queue_request(New_request(Start_compare_mod_version, Finish_compare_mod_version, 0,
+				done, id));
 }
 
-const char *
-HMS_fetch_rules (char *buffer, size_t buffer_size)
+static struct HMS_buffer *
+Start_fetch_rules (struct HMS_request *req)
 {
-	struct HMS_buffer *hms;
+	return HMS_connect(req, "rules");
+}
 
-	hms = HMS_connect("rules");
+static void
+Finish_fetch_rules (struct HMS_request *req)
+{
+	char *p;
 
-	if (! hms)
-		return NULL;
+	if (! req->ok)
+		return;
 
-	boolean ok = HMS_do(hms);
+	p = strstr(req->hms->buffer, "\n\n");
 
-	if (ok)
+	if (p)
 	{
-		char *p = strstr(hms->buffer, "\n\n");
-
-		if (p)
-		{
-			p[1] = '\0';
+		p[1] = '\0';
 
-			strlcpy(buffer, hms->buffer, buffer_size);
-		}
-		else
-			buffer = NULL;
+		req->result = strdup(req->hms->buffer);
 	}
 	else
-		buffer = NULL;
-
-	HMS_end(hms);
-
-	if (!ok)
-		return NULL;
+		req->ok = 0;
+}
 
-	return buffer;
+void
+HMS_fetch_rules (HMS_done_fn done, int id)
+{
+	Queue_request(New_request(Start_fetch_rules, Finish_fetch_rules, 0,
+				done, id));
 }
 
 static char *
@@ -571,19 +975,32 @@ Strip_trailing_slashes (char *api)
 	return api;
 }
 
+static struct HMS_buffer *
+Start_set_api (struct HMS_request *req)
+{
+	free(hms_api);
+	hms_api = Strip_trailing_slashes(req->text);
+	req->text = NULL;
+
+	req->ok = 1;
+
+	return NULL;
+}
+
 void
-HMS_set_api (char *api)
+HMS_set_api (const char *api, HMS_done_fn done, int id)
 {
-#ifdef HAVE_THREADS
-	I_lock_mutex(&hms_api_mutex);
-#endif
-	{
-		free(hms_api);
-		hms_api = Strip_trailing_slashes(api);
-	}
-#ifdef HAVE_THREADS
-	I_unlock_mutex(hms_api_mutex);
-#endif
+	struct HMS_request *req;
+
+	/* -masterserver wins over the cvar without being saved, so a server
+	can be tried against a local master server */
+	if (M_CheckParm("-masterserver") && M_IsNextParm())
+		api = M_GetNextParm();
+
+	req = New_request(Start_set_api, NULL, 1, done, id);
+	req->text = strdup(api);
+
+	Queue_request(req);
 }
 
 #endif/*MASTERSERVER*/
@@ -94,6 +94,18 @@ extern void (*I_NetSend)(void);
 */
 extern boolean (*I_NetCanSend)(void);
 
+/**	\brief send anything the driver has queued, may be NULL
+*/
+extern void (*I_NetFlush)(void);
+
+/**	\brief	sleep until a packet arrives, may be NULL
+
+	\param	timeout	longest wait, in precise_t units
+
+	\return	true if a packet is waiting
+*/
+extern boolean (*I_NetWait)(precise_t timeout);
+
 /**	\brief	close a connection
 
 	\param	nodenum	node to be closed
@@ -134,6 +146,35 @@ extern boolean (*I_NetOpenSocket)(void);
 */
 extern void (*I_NetCloseSocket)(void);
 
+/**	\brief	point a server list query slot at an address, opening the
+	query socket if needed; setting slot 0 starts a new list
+
+	\param	slot	slot to set, below MAXSERVERLIST
+
+	\param	address	address of the server
+
+	\param	port	port of the server
+
+	\return	false if the address couldn't be used
+*/
+extern boolean (*I_NetQueryAddress)(INT32 slot, const char *address, const char *port);
+
+/**	\brief	send the packet in doomcom to a query slot, over the query socket
+*/
+extern void (*I_NetQuerySend)(INT32 slot);
+
+/**	\brief	get a packet from the query socket into doomcom
+
+	\return	the slot it came from, or -1 if there are none left
+*/
+extern INT32 (*I_NetQueryGet)(void);
+
+#ifdef HOLEPUNCH
+/**	\brief	ask the server in a query slot to punch through to the query socket
+*/
+extern void (*I_NetQueryHolePunch)(INT32 slot);
+#endif
+
 
 /**	\brief send a hole punching request
 */
@@ -52,6 +52,15 @@ size_t I_GetFreeMem(size_t *total);
   */
 precise_t I_GetPreciseTime(void);
 
+/**	\brief	Splits the process into several copies that carry on from here,
+		sharing everything loaded so far until one of them writes to it
+
+	\param	count	how many processes to end up with
+
+	\return	which copy this is, 0 for the original
+*/
+INT32 I_ForkInstances(INT32 count);
+
 /** \brief  Get the precision of precise_t in units per second. Invocations of
             this function for the program's duration MUST return the same value.
   */
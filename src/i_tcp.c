@@ -12,6 +12,10 @@
 ///        This is not really OS-dependent because all OSes have the same socket API.
 ///        Just use ifdef for OS-dependent parts.
 
+#if defined (__linux__) && !defined (_GNU_SOURCE)
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -77,6 +81,14 @@
 #if defined (__unix__) || defined (__APPLE__) || defined (UNIXCOMMON)
 	#include <sys/time.h>
 #endif // UNIXCOMMON
+
+#ifdef __linux__
+#define SOCK_MMSG // batch packets through recvmmsg/sendmmsg
+#include <sys/uio.h>
+#define SOCK_EPOLL // wait for packets and the next tic together
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 #endif // !NONET
 
 #ifdef USE_WINSOCK
@@ -152,11 +164,13 @@ static UINT8 UPNP_support = TRUE;
 #include "i_net.h"
 #include "d_net.h"
 #include "d_netfil.h"
+#include "d_clisrv.h" // MAXSERVERLIST
 #include "i_tcp.h"
 #include "m_argv.h"
 #include "stun.h"
 #include "d_main.h"
 #include "z_zone.h"
+#include "command.h" // netstress
 
 #include "doomstat.h"
 
@@ -507,6 +521,76 @@ static boolean SOCK_cmpaddr(mysockaddr_t *a, mysockaddr_t *b, UINT8 mask)
 		return false;
 }
 
+// Address to node lookup for SOCK_Get, rebuilt after clientaddress[]
+// changes. Only exact IPv4 address:port pairs are hashed; while any slot
+// could match more loosely (port 0 or IPv6), lookups use the linear scan
+// so they keep returning the same node SOCK_cmpaddr would pick first.
+#define NODEHASHSIZE 256 // power of two, > MAXNETNODES
+static UINT8 nodehash[NODEHASHSIZE]; // node number, 0 if empty
+static boolean nodehashdirty = true;
+static boolean nodehashexact = false;
+
+static inline UINT32 SOCK_HashAddr(const mysockaddr_t *a)
+{
+	UINT32 h = (UINT32)a->ip4.sin_addr.s_addr * 2654435761u;
+	h ^= (UINT32)a->ip4.sin_port * 40503u;
+	return (h ^ (h >> 16)) & (NODEHASHSIZE - 1);
+}
+
+static void SOCK_RebuildNodeHash(void)
+{
+	INT32 j;
+
+	memset(nodehash, 0, sizeof (nodehash));
+	nodehashexact = true;
+
+	for (j = 1; j <= MAXNETNODES; j++) //include LAN
+	{
+		mysockaddr_t *a = &clientaddress[j];
+		UINT32 h;
+
+		if (a->any.sa_family == 0)
+			continue; // free slot, never matches
+		if (a->any.sa_family != AF_INET || a->ip4.sin_port == 0)
+		{
+			nodehashexact = false;
+			continue;
+		}
+
+		// Keep the lowest node for a duplicate address, like the scan would.
+		for (h = SOCK_HashAddr(a); nodehash[h]; h = (h + 1) & (NODEHASHSIZE - 1))
+			if (SOCK_cmpaddr(a, &clientaddress[nodehash[h]], 0))
+				break;
+		if (!nodehash[h])
+			nodehash[h] = (UINT8)j;
+	}
+
+	nodehashdirty = false;
+}
+
+static INT32 SOCK_FindNode(mysockaddr_t *from)
+{
+	INT32 j;
+
+	if (nodehashdirty)
+		SOCK_RebuildNodeHash();
+
+	if (nodehashexact && from->any.sa_family == AF_INET)
+	{
+		UINT32 h;
+
+		for (h = SOCK_HashAddr(from); (j = nodehash[h]) != 0; h = (h + 1) & (NODEHASHSIZE - 1))
+			if (SOCK_cmpaddr(from, &clientaddress[j], 0))
+				return j;
+		return 0;
+	}
+
+	for (j = 1; j <= MAXNETNODES; j++) //include LAN
+		if (SOCK_cmpaddr(from, &clientaddress[j], 0))
+			return j;
+	return 0;
+}
+
 // This is a hack. For some reason, nodes aren't being freed properly.
 // This goes through and cleans up what nodes were supposed to be freed.
 /** \warning This function causes the file downloading to stop if someone joins.
@@ -647,103 +731,214 @@ static boolean hole_punch(ssize_t c)
 }
 #endif
 
-// Returns true if a packet was received from a new node, false in all other cases
-static boolean SOCK_Get(void)
+#ifdef SOCK_MMSG
+// Batched I/O. Received packets are queued per socket and handed out one
+// per SOCK_Get; sends to known nodes are queued and go out together on
+// SOCK_Flush, which NetUpdate calls once it has sent everything for the
+// frame (and SOCK_Get before it waits on replies).
+#define MMSGBATCH 32
+
+static char recvbuf[MMSGBATCH][MAXPACKETLENGTH];
+static mysockaddr_t recvaddr[MMSGBATCH];
+static struct iovec recviov[MMSGBATCH];
+static struct mmsghdr recvmsgs[MMSGBATCH];
+static INT32 recvcount = 0, recvpos = 0;
+static size_t recvsocket = 0;
+
+static char sendbuf[MMSGBATCH][MAXPACKETLENGTH];
+static mysockaddr_t sendaddr[MMSGBATCH];
+static INT16 sendnode[MMSGBATCH];
+static SOCKET_TYPE sendsocket[MMSGBATCH];
+static struct iovec sendiov[MMSGBATCH];
+static struct mmsghdr sendmsgs[MMSGBATCH];
+static INT32 sendcount = 0;
+
+static void SOCK_Flush(void);
+
+static boolean SOCK_FillRecvQueue(void)
 {
-	size_t i, n;
-	int j;
-	ssize_t c;
-	mysockaddr_t fromaddress;
-	socklen_t fromlen;
+	size_t n;
+	INT32 i, c;
 
 	for (n = 0; n < mysocketses; n++)
 	{
-		fromlen = (socklen_t)sizeof(fromaddress);
-		c = recvfrom(mysockets[n], (char *)&doomcom->data, MAXPACKETLENGTH, 0,
-			(void *)&fromaddress, &fromlen);
+		for (i = 0; i < MMSGBATCH; i++)
+		{
+			recviov[i].iov_base = recvbuf[i];
+			recviov[i].iov_len = MAXPACKETLENGTH;
+			memset(&recvmsgs[i].msg_hdr, 0, sizeof (recvmsgs[i].msg_hdr));
+			recvmsgs[i].msg_hdr.msg_name = &recvaddr[i];
+			recvmsgs[i].msg_hdr.msg_namelen = sizeof (recvaddr[i]);
+			recvmsgs[i].msg_hdr.msg_iov = &recviov[i];
+			recvmsgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		c = recvmmsg(mysockets[n], recvmsgs, MMSGBATCH, MSG_DONTWAIT, NULL);
 		if (c > 0)
 		{
+			recvcount = c;
+			recvpos = 0;
+			recvsocket = n;
+			return true;
+		}
+	}
+
+	return false;
+}
+#endif
+
+enum
+{
+	SOCKPACKET_CONSUMED, // handled by the driver, stop reading for now
+	SOCKPACKET_NODE, // from a known node
+	SOCKPACKET_NEWNODE, // from a node we just added
+	SOCKPACKET_NOSLOT, // from a new address with no free node
+};
+
+static INT32 SOCK_ReceivedPacket(size_t n, mysockaddr_t *fromaddress, socklen_t fromlen, ssize_t c)
+{
+	size_t i;
+	int j;
+
 #ifdef USE_STUN
-			if (STUN_got_response(doomcom->data, c))
-			{
-				break;
-			}
+	if (STUN_got_response(doomcom->data, c))
+	{
+		return SOCKPACKET_CONSUMED;
+	}
 #endif
 #ifdef HOLEPUNCH
-			if (hole_punch(c))
-			{
-				break;
-			}
+	if (hole_punch(c))
+	{
+		return SOCKPACKET_CONSUMED;
+	}
 #endif
 
-			// find remote node number
-			for (j = 1; j <= MAXNETNODES; j++) //include LAN
-			{
-				if (SOCK_cmpaddr(&fromaddress, &clientaddress[j], 0))
-				{
-					doomcom->remotenode = (INT16)j; // good packet from a game player
-					doomcom->datalength = (INT16)c;
-					nodesocket[j] = mysockets[n];
-					return false;
-				}
-			}
-			// not found
+	// find remote node number
+	j = SOCK_FindNode(fromaddress);
+	if (j)
+	{
+		doomcom->remotenode = (INT16)j; // good packet from a game player
+		doomcom->datalength = (INT16)c;
+		nodesocket[j] = mysockets[n];
+		return SOCKPACKET_NODE;
+	}
+	// not found
 
-			// find a free slot
-			j = getfreenode();
-			if (j > 0)
+	// find a free slot
+	j = getfreenode();
+	if (j > 0)
+	{
+		const time_t curTime = time(NULL);
+
+		M_Memcpy(&clientaddress[j], fromaddress, fromlen);
+		nodehashdirty = true;
+		nodesocket[j] = mysockets[n];
+		DEBFILE(va("New node detected: node:%d address:%s\n", j,
+				SOCK_GetNodeAddress(j)));
+		doomcom->remotenode = (INT16)j; // good packet from a game player
+		doomcom->datalength = (INT16)c;
+
+		// check if it's a banned dude so we can send a refusal later
+		for (i = 0; i < numbans; i++)
+		{
+			if (SOCK_cmpaddr(fromaddress, &banned[i].address, banned[i].mask))
 			{
-				const time_t curTime = time(NULL);
-
-				M_Memcpy(&clientaddress[j], &fromaddress, fromlen);
-				nodesocket[j] = mysockets[n];
-				DEBFILE(va("New node detected: node:%d address:%s\n", j,
-						SOCK_GetNodeAddress(j)));
-				doomcom->remotenode = (INT16)j; // good packet from a game player
-				doomcom->datalength = (INT16)c;
-
-				// check if it's a banned dude so we can send a refusal later
-				for (i = 0; i < numbans; i++)
+				if (banned[i].timestamp != NO_BAN_TIME)
 				{
-					if (SOCK_cmpaddr(&fromaddress, &banned[i].address, banned[i].mask))
+					if (curTime >= banned[i].timestamp)
 					{
-						if (banned[i].timestamp != NO_BAN_TIME)
-						{
-							if (curTime >= banned[i].timestamp)
-							{
-								SOCK_bannednode[j].timeleft = NO_BAN_TIME;
-								SOCK_bannednode[j].banid = SIZE_MAX;
-								DEBFILE("This dude was banned, but enough time has passed\n");
-								break;
-							}
-
-							SOCK_bannednode[j].timeleft = banned[i].timestamp - curTime;
-							SOCK_bannednode[j].banid = i;
-							DEBFILE("This dude has been temporarily banned\n");
-							break;
-						}
-						else
-						{
-							SOCK_bannednode[j].timeleft = NO_BAN_TIME;
-							SOCK_bannednode[j].banid = i;
-							DEBFILE("This dude has been banned\n");
-							break;
-						}
+						SOCK_bannednode[j].timeleft = NO_BAN_TIME;
+						SOCK_bannednode[j].banid = SIZE_MAX;
+						DEBFILE("This dude was banned, but enough time has passed\n");
+						break;
 					}
-				}
 
-				if (i == numbans)
+					SOCK_bannednode[j].timeleft = banned[i].timestamp - curTime;
+					SOCK_bannednode[j].banid = i;
+					DEBFILE("This dude has been temporarily banned\n");
+					break;
+				}
+				else
 				{
 					SOCK_bannednode[j].timeleft = NO_BAN_TIME;
-					SOCK_bannednode[j].banid = SIZE_MAX;
+					SOCK_bannednode[j].banid = i;
+					DEBFILE("This dude has been banned\n");
+					break;
 				}
+			}
+		}
+
+		if (i == numbans)
+		{
+			SOCK_bannednode[j].timeleft = NO_BAN_TIME;
+			SOCK_bannednode[j].banid = SIZE_MAX;
+		}
 
+		return SOCKPACKET_NEWNODE;
+	}
+	else
+		DEBFILE("New node detected: No more free slots\n");
+
+	return SOCKPACKET_NOSLOT;
+}
+
+// Returns true if a packet was received from a new node, false in all other cases
+static boolean SOCK_Get(void)
+{
+	ssize_t c;
+	mysockaddr_t fromaddress;
+	socklen_t fromlen;
+#ifdef SOCK_MMSG
+	INT32 i;
+
+	// Anything we're about to wait on a reply for should be out first.
+	SOCK_Flush();
+
+	while (recvpos < recvcount || SOCK_FillRecvQueue())
+	{
+		i = recvpos++;
+		c = recvmsgs[i].msg_len;
+		if (c <= 0)
+			continue;
+
+		M_Memcpy(doomcom->data, recvbuf[i], c);
+		fromlen = recvmsgs[i].msg_hdr.msg_namelen;
+		M_Memcpy(&fromaddress, &recvaddr[i], min(fromlen, (socklen_t)sizeof (fromaddress)));
+
+		switch (SOCK_ReceivedPacket(recvsocket, &fromaddress, fromlen, c))
+		{
+			case SOCKPACKET_CONSUMED:
+				goto nopacket;
+			case SOCKPACKET_NODE:
+				return false;
+			case SOCKPACKET_NEWNODE:
+				return true;
+			default:
+				break;
+		}
+	}
+nopacket:
+#else
+	size_t n;
+
+	for (n = 0; n < mysocketses; n++)
+	{
+		fromlen = (socklen_t)sizeof(fromaddress);
+		c = recvfrom(mysockets[n], (char *)&doomcom->data, MAXPACKETLENGTH, 0,
+			(void *)&fromaddress, &fromlen);
+		if (c > 0)
+		{
+			INT32 result = SOCK_ReceivedPacket(n, &fromaddress, fromlen, c);
+
+			if (result == SOCKPACKET_CONSUMED)
+				break;
+			if (result == SOCKPACKET_NODE)
+				return false;
+			if (result == SOCKPACKET_NEWNODE)
 				return true;
-			}
-			else
-				DEBFILE("New node detected: No more free slots\n");
 		}
 	}
+#endif
 
 	doomcom->remotenode = -1; // no packet
 	return false;
@@ -804,28 +999,216 @@ static boolean SOCK_CanGet(void)
 #endif
 
 #ifndef NONET
-static inline ssize_t SOCK_SendToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr)
+#ifdef SOCK_EPOLL
+// Built on the first wait after the sockets open, torn down with them
+static int epollfd = -1, timerfd = -1;
+
+static void SOCK_CloseEpoll(void)
 {
-	socklen_t d4 = (socklen_t)sizeof(struct sockaddr_in);
-#ifdef HAVE_IPV6
-	socklen_t d6 = (socklen_t)sizeof(struct sockaddr_in6);
+	if (epollfd != -1)
+		close(epollfd);
+	if (timerfd != -1)
+		close(timerfd);
+	epollfd = timerfd = -1;
+}
+
+static boolean SOCK_OpenEpoll(void)
+{
+	struct epoll_event ev;
+	size_t n;
+
+	epollfd = epoll_create1(EPOLL_CLOEXEC);
+	timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+	if (epollfd == -1 || timerfd == -1)
+	{
+		SOCK_CloseEpoll();
+		return false;
+	}
+
+	memset(&ev, 0, sizeof (ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = timerfd;
+	if (epoll_ctl(epollfd, EPOLL_CTL_ADD, timerfd, &ev) == -1)
+	{
+		SOCK_CloseEpoll();
+		return false;
+	}
+
+	for (n = 0; n < mysocketses; n++)
+	{
+		if (mysockets[n] == (SOCKET_TYPE)ERRSOCKET)
+			continue;
+		ev.data.fd = mysockets[n];
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, mysockets[n], &ev) == -1)
+		{
+			SOCK_CloseEpoll();
+			return false;
+		}
+	}
+
+	return true;
+}
 #endif
-	socklen_t d, da = (socklen_t)sizeof(mysockaddr_t);
 
+/** Sleeps until a packet arrives or the timeout runs out
+  *
+  * \param timeout Longest wait, in precise_t units
+  * \return true if a packet is waiting
+  */
+static boolean SOCK_Wait(precise_t timeout)
+{
+	const UINT64 precision = I_GetPrecisePrecision();
+	SOCKET_TYPE highest = 0;
+	boolean gotsocket = false;
+	struct timeval tv;
+	fd_set tset;
+	size_t n;
+
+#ifdef SOCK_MMSG
+	if (recvpos < recvcount)
+		return true; // Already read in, just not handed out yet
+#endif
+
+#ifdef SOCK_EPOLL
+	if (epollfd != -1 || SOCK_OpenEpoll())
+	{
+		struct epoll_event ready[MAXNETNODES+2];
+		struct itimerspec its;
+		boolean gotpacket = false;
+		int i, c;
+
+		// A timerfd wakes us right on the deadline, epoll_wait itself only does milliseconds
+		memset(&its, 0, sizeof (its));
+		its.it_value.tv_sec = (time_t)(timeout / precision);
+		its.it_value.tv_nsec = (long)(timeout % precision * 1000000000 / precision);
+
+		if (its.it_value.tv_sec || its.it_value.tv_nsec)
+		{
+			if (timerfd_settime(timerfd, 0, &its, NULL) == -1)
+				return false;
+			c = epoll_wait(epollfd, ready, MAXNETNODES+2, -1);
+		}
+		else
+			c = epoll_wait(epollfd, ready, MAXNETNODES+2, 0);
+
+		for (i = 0; i < c; i++)
+		{
+			if (ready[i].data.fd == timerfd)
+			{
+				UINT64 expirations;
+				if (read(timerfd, &expirations, sizeof (expirations)) < 0)
+					continue;
+			}
+			else
+				gotpacket = true;
+		}
+
+		// Don't let a leftover expiry cut the next wait short
+		memset(&its, 0, sizeof (its));
+		timerfd_settime(timerfd, 0, &its, NULL);
+
+		return gotpacket;
+	}
+#endif
+
+	FD_ZERO(&tset);
+	for (n = 0; n < mysocketses; n++)
+		if (mysockets[n] != (SOCKET_TYPE)ERRSOCKET)
+		{
+			FD_SET(mysockets[n], &tset);
+			if (mysockets[n] > highest)
+				highest = mysockets[n];
+			gotsocket = true;
+		}
+
+	if (!gotsocket)
+	{
+		I_SleepDuration(timeout);
+		return false;
+	}
+
+	tv.tv_sec = (long)(timeout / precision);
+	tv.tv_usec = (long)(timeout % precision * 1000000 / precision);
+	return select((int)highest + 1, &tset, NULL, NULL, &tv) >= 1;
+}
+#endif
+
+#ifndef NONET
+static inline socklen_t SOCK_AddrLen(mysockaddr_t *sockaddr)
+{
 	switch (sockaddr->any.sa_family)
 	{
-		case AF_INET:  d = d4; break;
+		case AF_INET:  return (socklen_t)sizeof(struct sockaddr_in);
 #ifdef HAVE_IPV6
-		case AF_INET6: d = d6; break;
+		case AF_INET6: return (socklen_t)sizeof(struct sockaddr_in6);
 #endif
-		default:       d = da; break;
+		default:       return (socklen_t)sizeof(mysockaddr_t);
 	}
+}
 
-	return sendto(socket, (char *)&doomcom->data, doomcom->datalength, 0, &sockaddr->any, d);
+static inline ssize_t SOCK_SendToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr)
+{
+	return sendto(socket, (char *)&doomcom->data, doomcom->datalength, 0, &sockaddr->any, SOCK_AddrLen(sockaddr));
 }
 
 #define ALLOWEDERROR(x) ((x) == ECONNREFUSED || (x) == EWOULDBLOCK || (x) == EHOSTUNREACH || (x) == ENETUNREACH)
 
+#ifdef SOCK_MMSG
+static void SOCK_Flush(void)
+{
+	INT32 i = 0, run, c;
+
+	while (i < sendcount)
+	{
+		// sendmmsg goes through one socket, so send runs of the same one
+		for (run = i + 1; run < sendcount && sendsocket[run] == sendsocket[i]; run++)
+			;
+
+		// A short count only means it stopped early; the next call starts
+		// at the first unsent message and returns -1 if that one fails.
+		c = sendmmsg(sendsocket[i], &sendmsgs[i], run - i, 0);
+		if (c > 0)
+		{
+			i += c;
+			continue;
+		}
+
+		// The first message failed; report it, skip it, go on.
+		if (c == ERRSOCKET && !ALLOWEDERROR(errno))
+		{
+			int e = errno;
+			I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", sendnode[i],
+				SOCK_GetNodeAddress(sendnode[i]), e, strerror(e));
+		}
+		i++;
+	}
+
+	sendcount = 0;
+}
+
+static void SOCK_QueueSend(SOCKET_TYPE socket, INT16 node)
+{
+	struct mmsghdr *msg;
+
+	if (sendcount == MMSGBATCH)
+		SOCK_Flush();
+
+	msg = &sendmsgs[sendcount];
+	M_Memcpy(sendbuf[sendcount], doomcom->data, doomcom->datalength);
+	M_Memcpy(&sendaddr[sendcount], &clientaddress[node], sizeof (mysockaddr_t));
+	sendiov[sendcount].iov_base = sendbuf[sendcount];
+	sendiov[sendcount].iov_len = doomcom->datalength;
+	memset(&msg->msg_hdr, 0, sizeof (msg->msg_hdr));
+	msg->msg_hdr.msg_name = &sendaddr[sendcount];
+	msg->msg_hdr.msg_namelen = SOCK_AddrLen(&sendaddr[sendcount]);
+	msg->msg_hdr.msg_iov = &sendiov[sendcount];
+	msg->msg_hdr.msg_iovlen = 1;
+	sendsocket[sendcount] = socket;
+	sendnode[sendcount] = doomcom->remotenode;
+	sendcount++;
+}
+#endif
+
 static void SOCK_Send(void)
 {
 	ssize_t c = ERRSOCKET;
@@ -865,7 +1248,12 @@ static void SOCK_Send(void)
 	}
 	else
 	{
+#ifdef SOCK_MMSG
+		SOCK_QueueSend(nodesocket[doomcom->remotenode], doomcom->remotenode);
+		return;
+#else
 		c = SOCK_SendToAddr(nodesocket[doomcom->remotenode], &clientaddress[doomcom->remotenode]);
+#endif
 	}
 
 	if (c == ERRSOCKET)
@@ -877,6 +1265,7 @@ static void SOCK_Send(void)
 	}
 }
 #undef ALLOWEDERROR
+
 #endif
 
 #ifndef NONET
@@ -888,12 +1277,201 @@ static void SOCK_FreeNodenum(INT32 numnode)
 
 	DEBFILE(va("Free node %d (%s)\n", numnode, SOCK_GetNodeAddress(numnode)));
 
+#ifdef SOCK_MMSG
+	SOCK_Flush(); // anything queued for it goes out first
+#endif
+
 	nodeconnected[numnode] = false;
 	nodesocket[numnode] = ERRSOCKET;
 
 	// put invalid address
 	memset(&clientaddress[numnode], 0, sizeof (clientaddress[numnode]));
+	nodehashdirty = true;
+}
+#endif
+
+#ifndef NONET
+// netstress [packets] [exit]: runs numbered packets through the driver over
+// loopback and checks them. A peer socket sends to our own socket, and
+// SOCK_Get has to hand every packet over in order and from the peer's node;
+// then SOCK_Send sends back to the peer, which has to get them all in order.
+// Prints packets/sec for each direction. With "exit", quits afterwards, with
+// an error if either check failed (see -netstress).
+#define NETSTRESSSIZE 128
+#define NETSTRESSBURST 32
+
+static SOCKET_TYPE SOCK_StressSocket(mysockaddr_t *addr)
+{
+	SOCKET_TYPE s = socket(AF_INET, SOCK_DGRAM, 0);
+	socklen_t len = (socklen_t)sizeof (addr->ip4);
+	unsigned long trueval = true;
+
+	if (s == (SOCKET_TYPE)ERRSOCKET)
+		return s;
+
+	memset(addr, 0, sizeof (*addr));
+	addr->ip4.sin_family = AF_INET;
+	addr->ip4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(s, &addr->any, len) == ERRSOCKET
+		|| getsockname(s, &addr->any, &len) == ERRSOCKET
+		|| ioctl(s, FIONBIO, &trueval) == ERRSOCKET)
+	{
+		close(s);
+		return ERRSOCKET;
+	}
+
+	return s;
+}
+
+static void SOCK_StressReport(const char *name, INT32 received, INT32 sent, INT32 bad, precise_t time)
+{
+	const double secs = (double)time / I_GetPrecisePrecision();
+	CONS_Printf("%-8s %d/%d packets in %.3f s, %.0f packets/sec, %d wrong\n",
+		name, received, sent, secs, secs > 0.0 ? received / secs : 0.0, bad);
+}
+
+static boolean SOCK_NetStress(INT32 total)
+{
+	mysockaddr_t ouraddr, peeraddr;
+	socklen_t len = (socklen_t)sizeof (ouraddr.ip4);
+	SOCKET_TYPE peer;
+	char buf[NETSTRESSSIZE];
+	INT32 sent, received, bad, seq, i;
+	size_t n;
+	SINT8 node;
+	precise_t start;
+
+	for (n = 0; n < mysocketses; n++)
+		if (myfamily[n] == AF_INET)
+			break;
+	if (n == mysocketses || getsockname(mysockets[n], &ouraddr.any, &len) == ERRSOCKET)
+	{
+		CONS_Alert(CONS_ERROR, "netstress: no IPv4 socket open\n");
+		return false;
+	}
+	ouraddr.ip4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	// Anything else arriving meanwhile would be eaten by the check
+	for (i = 1; i < MAXNETNODES; i++)
+		if (nodeconnected[i])
+		{
+			CONS_Alert(CONS_ERROR, "netstress: can't run while other nodes are connected\n");
+			return false;
+		}
+
+	peer = SOCK_StressSocket(&peeraddr);
+	if (peer == (SOCKET_TYPE)ERRSOCKET)
+	{
+		CONS_Alert(CONS_ERROR, "netstress: couldn't open a loopback socket\n");
+		return false;
+	}
+
+	// Give the peer a node of its own, like SOCK_NetMakeNodewPort does
+	node = getfreenode();
+	if (node <= 0)
+	{
+		CONS_Alert(CONS_ERROR, "netstress: no free node\n");
+		close(peer);
+		return false;
+	}
+	M_Memcpy(&clientaddress[node], &peeraddr, sizeof (peeraddr.ip4));
+	nodehashdirty = true;
+	nodesocket[node] = ERRSOCKET;
+
+	memset(buf, 0x55, sizeof (buf));
+
+	// Peer -> SOCK_Get. Send a burst, drain it, repeat, so the receive
+	// buffer never overflows and every loss is the driver's.
+	sent = received = bad = 0;
+	seq = 0;
+	start = I_GetPreciseTime();
+	while (sent < total)
+	{
+		for (i = 0; i < NETSTRESSBURST && sent < total; i++, sent++)
+		{
+			M_Memcpy(buf, &sent, sizeof (sent));
+			sendto(peer, buf, NETSTRESSSIZE, 0, &ouraddr.any, sizeof (ouraddr.ip4));
+		}
+
+		for (;;)
+		{
+			SOCK_Get();
+			if (doomcom->remotenode == -1)
+				break;
+
+			if (doomcom->remotenode != node)
+			{
+				// A stranger got in anyway; don't keep its node
+				SOCK_FreeNodenum(doomcom->remotenode);
+				continue;
+			}
+
+			if (doomcom->datalength != NETSTRESSSIZE || memcmp(doomcom->data, &seq, sizeof (seq)))
+				bad++;
+			seq++;
+			received++;
+		}
+	}
+	SOCK_StressReport("receive", received, sent, bad, I_GetPreciseTime() - start);
+	bad += sent - received;
+
+	// SOCK_Send -> peer, through the socket the peer's packets came in on
+	sent = received = 0;
+	seq = 0;
+	start = I_GetPreciseTime();
+	while (sent < total)
+	{
+		INT32 c;
+
+		for (i = 0; i < NETSTRESSBURST && sent < total; i++, sent++)
+		{
+			doomcom->remotenode = node;
+			doomcom->datalength = NETSTRESSSIZE;
+			memset(doomcom->data, 0x55, NETSTRESSSIZE);
+			M_Memcpy(doomcom->data, &sent, sizeof (sent));
+			SOCK_Send();
+		}
+#ifdef SOCK_MMSG
+		SOCK_Flush();
+#endif
+
+		while ((c = recvfrom(peer, buf, sizeof (buf), 0, NULL, NULL)) > 0)
+		{
+			if (c != NETSTRESSSIZE || memcmp(buf, &seq, sizeof (seq)))
+				bad++;
+			seq++;
+			received++;
+		}
+	}
+	SOCK_StressReport("send", received, sent, bad, I_GetPreciseTime() - start);
+	bad += sent - received;
+
+	SOCK_FreeNodenum(node);
+	close(peer);
+
+	return bad == 0;
 }
+
+void Command_Netstress(void)
+{
+	const INT32 total = (COM_Argc() > 1) ? max(atoi(COM_Argv(1)), NETSTRESSBURST) : 100000;
+	const boolean quit = (COM_Argc() > 2 && !stricmp(COM_Argv(2), "exit"));
+	const boolean passed = SOCK_NetStress(total);
+
+	if (passed)
+		CONS_Printf("netstress: passed\n");
+	else
+		CONS_Alert(CONS_ERROR, "netstress: failed\n");
+
+	if (quit)
+	{
+		if (!passed)
+			I_Error("netstress failed\n");
+		I_Quit();
+	}
+}
+#undef NETSTRESSSIZE
+#undef NETSTRESSBURST
 #endif
 
 //
@@ -901,6 +1479,25 @@ static void SOCK_FreeNodenum(INT32 numnode)
 //
 #ifndef NONET
 
+static void UDP_NoConnReset(SOCKET_TYPE s)
+{
+#ifdef USE_WINSOCK
+	{ // Alam_GBC: disable the new UDP connection reset behavior for Win2k and up
+#ifdef USE_WINSOCK2
+		DWORD dwBytesReturned = 0;
+		BOOL bfalse = FALSE;
+		WSAIoctl(s, SIO_UDP_CONNRESET, &bfalse, sizeof(bfalse),
+		         NULL, 0, &dwBytesReturned, NULL, NULL);
+#else
+		unsigned long falseval = false;
+		ioctl(s, SIO_UDP_CONNRESET, &falseval);
+#endif
+	}
+#else
+	(void)s;
+#endif
+}
+
 // allocate a socket
 static SOCKET_TYPE UDP_Bind(int family, struct sockaddr *addr, socklen_t addrlen)
 {
@@ -916,19 +1513,7 @@ static SOCKET_TYPE UDP_Bind(int family, struct sockaddr *addr, socklen_t addrlen
 
 	if (s == (SOCKET_TYPE)ERRSOCKET)
 		return (SOCKET_TYPE)ERRSOCKET;
-#ifdef USE_WINSOCK
-	{ // Alam_GBC: disable the new UDP connection reset behavior for Win2k and up
-#ifdef USE_WINSOCK2
-		DWORD dwBytesReturned = 0;
-		BOOL bfalse = FALSE;
-		WSAIoctl(s, SIO_UDP_CONNRESET, &bfalse, sizeof(bfalse),
-		         NULL, 0, &dwBytesReturned, NULL, NULL);
-#else
-		unsigned long falseval = false;
-		ioctl(s, SIO_UDP_CONNRESET, &falseval);
-#endif
-	}
-#endif
+	UDP_NoConnReset(s);
 
 	straddr.any = *addr;
 	I_OutputMsg("Binding to %s\n", SOCK_AddrToStr(&straddr));
@@ -1172,6 +1757,7 @@ static boolean UDP_Socket(void)
 		clientaddress[s].ip4.sin_addr.s_addr = htonl(INADDR_LOOPBACK); //GetLocalAddress(); // my own ip
 		s++;
 	}
+	nodehashdirty = true;
 
 	s = 0;
 
@@ -1298,6 +1884,15 @@ boolean I_InitTcpDriver(void)
 static void SOCK_CloseSocket(void)
 {
 	size_t i;
+
+#ifdef SOCK_MMSG
+	SOCK_Flush();
+	recvcount = recvpos = 0;
+#endif
+#ifdef SOCK_EPOLL
+	SOCK_CloseEpoll();
+#endif
+
 	for (i=0; i < MAXNETNODES+1; i++)
 	{
 		if (mysockets[i] != (SOCKET_TYPE)ERRSOCKET
@@ -1311,10 +1906,15 @@ static void SOCK_CloseSocket(void)
 }
 #endif
 
+#ifndef NONET
+static void SOCK_CloseQuery(void);
+#endif
+
 void I_ShutdownTcpDriver(void)
 {
 #ifndef NONET
 	SOCK_CloseSocket();
+	SOCK_CloseQuery();
 
 	CONS_Printf("I_ShutdownTcpDriver: ");
 #ifdef USE_WINSOCK
@@ -1378,7 +1978,10 @@ static SINT8 SOCK_NetMakeNodewPort(const char *address, const char *port)
 
 	if (newnode != -1)
 	{
-		if (!SOCK_GetAddr(&clientaddress[newnode].ip4, address, port, true))
+		boolean ok = SOCK_GetAddr(&clientaddress[newnode].ip4, address, port, true);
+
+		nodehashdirty = true;
+		if (!ok)
 		{
 			nodeconnected[newnode] = false;
 			return -1;
@@ -1390,7 +1993,7 @@ static SINT8 SOCK_NetMakeNodewPort(const char *address, const char *port)
 
 /* See ../doc/Holepunch-Protocol.txt */
 #ifdef HOLEPUNCH
-static void rendezvous(int size)
+static void rendezvous(SOCKET_TYPE s, int size)
 {
 	char *addrs = strdup(cv_rendezvousserver.string);
 
@@ -1420,7 +2023,7 @@ static void rendezvous(int size)
 		#ifdef HOLEPUNCH
 		holepunchpacket->magic = hole_punch_magic;
 		#endif
-		sendto(mysockets[0], doomcom->data, size, 0, &rzv.any, sizeof rzv.ip4);
+		sendto(s, doomcom->data, size, 0, &rzv.any, sizeof rzv.ip4);
 	}
 
 	free(addrs);
@@ -1436,12 +2039,135 @@ static void SOCK_RequestHolePunch(INT32 node)
 	CONS_Debug(DBG_NETPLAY,
 			"requesting hole punch to node %s\n", SOCK_AddrToStr(addr));
 
-	rendezvous(10);
+	rendezvous(mysockets[0], 10);
 }
 
 static void SOCK_RegisterHolePunch(void)
 {
-	rendezvous(4);
+	rendezvous(mysockets[0], 4);
+}
+#endif
+
+// Server list queries go out over their own socket, one address slot per
+// server, so the browser can ask every server at once without using up
+// nodes or mixing the replies into game traffic.
+static SOCKET_TYPE querysocket = ERRSOCKET;
+static mysockaddr_t queryaddress[MAXSERVERLIST];
+static INT32 queryslots = 0; // highest slot in use, plus one
+
+static boolean SOCK_OpenQuery(void)
+{
+	mysockaddr_t addr;
+	unsigned long trueval = true;
+	int opt = 1<<20; // a burst of replies from every server at once
+
+	if (querysocket != (SOCKET_TYPE)ERRSOCKET)
+		return true;
+
+	querysocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (querysocket == (SOCKET_TYPE)ERRSOCKET)
+		return false;
+
+	UDP_NoConnReset(querysocket);
+
+	memset(&addr, 0, sizeof (addr));
+	addr.ip4.sin_family = AF_INET;
+	addr.ip4.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(querysocket, &addr.any, sizeof (addr.ip4)) == ERRSOCKET
+		|| ioctl(querysocket, FIONBIO, &trueval) == ERRSOCKET)
+	{
+		close(querysocket);
+		querysocket = ERRSOCKET;
+		CONS_Alert(CONS_WARNING, M_GetText("Couldn't open the server list query socket\n"));
+		return false;
+	}
+
+	setsockopt(querysocket, SOL_SOCKET, SO_RCVBUF, (char *)&opt, (socklen_t)sizeof (opt));
+	return true;
+}
+
+static void SOCK_CloseQuery(void)
+{
+	if (querysocket != (SOCKET_TYPE)ERRSOCKET)
+		close(querysocket);
+	querysocket = ERRSOCKET;
+	queryslots = 0;
+}
+
+static boolean SOCK_QueryAddress(INT32 slot, const char *address, const char *port)
+{
+	if (slot < 0 || slot >= MAXSERVERLIST || !SOCK_OpenQuery())
+		return false;
+
+	if (slot == 0)
+		queryslots = 0; // a new list, forget the old one
+
+	memset(&queryaddress[slot], 0, sizeof (queryaddress[slot]));
+	if (!SOCK_GetAddr(&queryaddress[slot].ip4, address, port, false)
+		|| queryaddress[slot].any.sa_family != AF_INET) // the query socket is IPv4
+	{
+		memset(&queryaddress[slot], 0, sizeof (queryaddress[slot]));
+		return false;
+	}
+
+	queryslots = max(queryslots, slot + 1);
+	return true;
+}
+
+static void SOCK_QuerySend(INT32 slot)
+{
+	if (querysocket == (SOCKET_TYPE)ERRSOCKET || slot < 0 || slot >= queryslots
+		|| queryaddress[slot].any.sa_family != AF_INET)
+		return;
+
+	SOCK_SendToAddr(querysocket, &queryaddress[slot]);
+}
+
+static INT32 SOCK_QueryGet(void)
+{
+	mysockaddr_t fromaddress;
+	socklen_t fromlen;
+	ssize_t c;
+	INT32 slot;
+
+	if (querysocket == (SOCKET_TYPE)ERRSOCKET)
+		return -1;
+
+	for (;;)
+	{
+		fromlen = (socklen_t)sizeof (fromaddress);
+		c = recvfrom(querysocket, (char *)&doomcom->data, MAXPACKETLENGTH, 0,
+			&fromaddress.any, &fromlen);
+		if (c <= 0)
+			return -1;
+
+		// Replies are few enough, and only read while browsing, that a
+		// scan is fine here.
+		for (slot = 0; slot < queryslots; slot++)
+			if (queryaddress[slot].any.sa_family == AF_INET
+				&& SOCK_cmpaddr(&fromaddress, &queryaddress[slot], 0))
+			{
+				doomcom->datalength = (INT16)c;
+				return slot;
+			}
+		// not someone we asked, drop it
+	}
+}
+
+#ifdef HOLEPUNCH
+static void SOCK_QueryHolePunch(INT32 slot)
+{
+	mysockaddr_t *addr;
+
+	if (querysocket == (SOCKET_TYPE)ERRSOCKET || slot < 0 || slot >= queryslots)
+		return;
+
+	addr = &queryaddress[slot];
+	holepunchpacket->addr = addr->ip4.sin_addr.s_addr;
+	holepunchpacket->port = addr->ip4.sin_port;
+
+	// From the query socket, so the server punches through to that
+	rendezvous(querysocket, 10);
 }
 #endif
 
@@ -1453,6 +2179,7 @@ static boolean SOCK_OpenSocket(void)
 	size_t i;
 
 	memset(clientaddress, 0, sizeof (clientaddress));
+	nodehashdirty = true;
 
 	nodeconnected[0] = true; // always connected to self
 	for (i = 1; i < MAXNETNODES; i++)
@@ -1463,6 +2190,10 @@ static boolean SOCK_OpenSocket(void)
 	I_NetCloseSocket = SOCK_CloseSocket;
 	I_NetFreeNodenum = SOCK_FreeNodenum;
 	I_NetMakeNodewPort = SOCK_NetMakeNodewPort;
+#ifdef SOCK_MMSG
+	I_NetFlush = SOCK_Flush;
+#endif
+	I_NetWait = SOCK_Wait;
 
 #ifdef SELECTTEST
 	// seem like not work with libsocket : (
@@ -1697,8 +2428,31 @@ boolean I_InitTcpNetwork(void)
 	if (M_CheckParm("-clientport"))
 		clientport_name = M_GetNextParm();
 
+	// Each -instances server takes the next port up
+	if (serverinstance && serverport_name)
+	{
+		static char instanceport[8];
+		snprintf(instanceport, sizeof instanceport, "%d", atoi(serverport_name) + serverinstance);
+		serverport_name = instanceport;
+	}
+
 	// parse network game options,
-	if (M_CheckParm("-server") || dedicated)
+	if (relay)
+	{
+		if (!M_CheckParm("-relay") || !M_IsNextParm())
+			I_Error("-relay needs the address of the server to relay\n");
+		strcpy(serverhostname, M_GetNextParm());
+
+		// Viewers find the relay on the server port
+		clientport_name = serverport_name;
+
+		COM_BufAddText("connect \"");
+		COM_BufAddText(serverhostname);
+		COM_BufAddText("\"\n");
+
+		hardware_MAXPACKETLENGTH = INETPACKETLENGTH;
+	}
+	else if (M_CheckParm("-server") || dedicated)
 	{
 		server = true;
 
@@ -1782,7 +2536,25 @@ boolean I_InitTcpNetwork(void)
 		}
 	}
 
+#ifndef NONET
+	// Checks the driver over loopback once the socket is open, then quits
+	if (M_CheckParm("-netstress"))
+	{
+		COM_BufAddText("netstress ");
+		COM_BufAddText(M_IsNextParm() ? M_GetNextParm() : "100000");
+		COM_BufAddText(" exit\n");
+	}
+#endif
+
 	I_NetOpenSocket = SOCK_OpenSocket;
+#ifndef NONET
+	I_NetQueryAddress = SOCK_QueryAddress;
+	I_NetQuerySend = SOCK_QuerySend;
+	I_NetQueryGet = SOCK_QueryGet;
+#ifdef HOLEPUNCH
+	I_NetQueryHolePunch = SOCK_QueryHolePunch;
+#endif
+#endif
 	I_Ban = SOCK_Ban;
 	I_ClearBans = SOCK_ClearBans;
 	I_GetNodeAddress = SOCK_GetNodeAddress;
@@ -80,3 +80,14 @@ void I_UpdateTime(fixed_t timescale)
 		g_time.timefrac = FLOAT_TO_FIXED(fractional);
 	}
 }
+
+precise_t I_GetTimeUntilNextTic(fixed_t timescale)
+{
+	const double ticratescaled = (double)TICRATE * FIXED_TO_FLOAT(timescale);
+	const double elapsedseconds = (double)(I_GetPreciseTime() - enterprecise) / I_GetPrecisePrecision();
+	const double left = 1.0/ticratescaled - tictimer - elapsedseconds;
+
+	if (left <= 0.0)
+		return 0;
+	return (precise_t)(left * I_GetPrecisePrecision());
+}
@@ -40,6 +40,10 @@ void I_InitializeTime(void);
 
 void I_UpdateTime(fixed_t timescale);
 
+/**	\brief  Time left, in precise_t units, until the next tic is due.
+*/
+precise_t I_GetTimeUntilNextTic(fixed_t timescale);
+
 /** \brief  Block for at minimum the duration specified. This function makes a
             best effort not to oversleep, and will spinloop if sleeping would
 			take too long. However, callers should still check the current time
@@ -756,6 +756,17 @@ UINT8 LUAh_MobjCollideHook(mobj_t *thing1, mobj_t *thing2, enum hook which)
 	return shouldCollide;
 }
 
+// Does anything hook the thinker of this mobj type?
+boolean LUAh_HasMobjThinker(mobjtype_t type)
+{
+	if (!gL || !(hooksAvailable[hook_MobjThinker/8] & (1<<(hook_MobjThinker%8))))
+		return false;
+
+	I_Assert(type < NUMMOBJTYPES);
+
+	return (mobjthinkerhooks[MT_NULL] || mobjthinkerhooks[type]);
+}
+
 // Hook for mobj thinkers
 boolean LUAh_MobjThinker(mobj_t *mo)
 {
@@ -547,6 +547,7 @@ static int sector_set(lua_State *L)
 		break;
 	case sector_special:
 		sector->special = (INT16)luaL_checkinteger(L, 3);
+		P_InvalidateSpecialSectors();
 		break;
 	case sector_tag:
 		P_ChangeSectorTag((UINT32)(sector - sectors), (INT16)luaL_checkinteger(L, 3));
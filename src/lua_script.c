@@ -1629,6 +1629,219 @@ void LUA_Step(void)
 	}
 }
 
+static UINT32 HashLuaValue(int idx, int depth)
+{
+	UINT32 h = 0x811C9DC5 ^ (UINT32)lua_type(gL, idx);
+
+	switch (lua_type(gL, idx))
+	{
+		case LUA_TBOOLEAN:
+			h = (h ^ (UINT32)lua_toboolean(gL, idx)) * 0x01000193;
+			break;
+		case LUA_TNUMBER:
+			h = (h ^ (UINT32)lua_tonumber(gL, idx)) * 0x01000193;
+			break;
+		case LUA_TSTRING:
+		{
+			size_t len;
+			const char *str = lua_tolstring(gL, idx, &len);
+			while (len--)
+				h = (h ^ (UINT8)*str++) * 0x01000193;
+			break;
+		}
+		case LUA_TTABLE:
+		{
+			UINT32 sum = 0;
+
+			if (depth <= 0)
+				break;
+			if (idx < 0)
+				idx = lua_gettop(gL) + idx + 1;
+			// Tables iterate in no particular order, so add entries up
+			lua_pushnil(gL);
+			while (lua_next(gL, idx))
+			{
+				UINT32 key = HashLuaValue(-2, 0);
+				boolean empty = false;
+
+				// Empty tables aren't archived, so joiners won't have them
+				if (lua_istable(gL, -1))
+				{
+					lua_pushnil(gL);
+					if (lua_next(gL, -2))
+						lua_pop(gL, 2);
+					else
+						empty = true;
+				}
+				if (!empty)
+					sum += (key ^ HashLuaValue(-1, depth - 1)) * 0x01000193 + key;
+				lua_pop(gL, 1);
+			}
+			h ^= sum;
+			break;
+		}
+		default: // userdata, functions: only their type is comparable
+			break;
+	}
+	return h;
+}
+
+// Every variable name seen by LUA_ConsistencyHash, with its values summed
+typedef struct
+{
+	UINT32 name;
+	UINT32 value;
+} consistencyvar_t;
+
+static consistencyvar_t *consistencyvars = NULL;
+static size_t numconsistencyvars = 0, maxconsistencyvars = 0;
+
+static void AddConsistencyVar(UINT32 name, UINT32 value)
+{
+	size_t i;
+
+	for (i = 0; i < numconsistencyvars; i++)
+		if (consistencyvars[i].name == name)
+		{
+			consistencyvars[i].value += value;
+			return;
+		}
+
+	if (numconsistencyvars == maxconsistencyvars)
+	{
+		maxconsistencyvars = maxconsistencyvars ? maxconsistencyvars*2 : 32;
+		consistencyvars = Z_Realloc(consistencyvars, maxconsistencyvars * sizeof (*consistencyvars), PU_STATIC, NULL);
+	}
+	consistencyvars[numconsistencyvars].name = name;
+	consistencyvars[numconsistencyvars].value = value;
+	numconsistencyvars++;
+}
+
+static int CompareConsistencyVars(const void *a, const void *b)
+{
+	const UINT32 na = ((const consistencyvar_t *)a)->name, nb = ((const consistencyvar_t *)b)->name;
+	return (na > nb) - (na < nb);
+}
+
+/** Hashes the variables scripts have attached to players and mobjs,
+  * for comparing against other nodes when looking for desyncs.
+  *
+  * \param names Filled with the lowest name hashes, sorted.
+  * \param values Filled with the sum of the values under each of those names.
+  * \param numvars Set to how many names were filled in.
+  * \param maxvars Most names to fill in.
+  * \return Hash of all the variables.
+  */
+UINT32 LUA_ConsistencyHash(UINT32 *names, UINT32 *values, UINT8 *numvars, UINT8 maxvars)
+{
+	UINT32 sum = 0;
+	size_t i;
+
+	*numvars = 0;
+	if (!gL)
+		return 0;
+
+	numconsistencyvars = 0;
+	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
+	lua_pushnil(gL);
+	while (lua_next(gL, -2))
+	{
+		UINT32 key = HashLuaValue(-2, 0);
+		UINT32 fields = 0;
+		boolean empty = true;
+
+		if (!lua_istable(gL, -1))
+		{
+			lua_pop(gL, 1);
+			continue;
+		}
+
+		// Variables of one object, in no particular order
+		lua_pushnil(gL);
+		while (lua_next(gL, -2))
+		{
+			UINT32 name, value;
+
+			empty = false;
+
+			// Empty tables aren't archived, so joiners won't have them
+			if (lua_istable(gL, -1))
+			{
+				lua_pushnil(gL);
+				if (!lua_next(gL, -2))
+				{
+					lua_pop(gL, 1);
+					continue;
+				}
+				lua_pop(gL, 2);
+			}
+
+			name = HashLuaValue(-2, 0);
+			value = HashLuaValue(-1, 1);
+			fields += (name ^ value) * 0x01000193 + name;
+			AddConsistencyVar(name, value);
+			lua_pop(gL, 1);
+		}
+
+		if (!empty)
+			sum += (key ^ fields) * 0x01000193 + key;
+		lua_pop(gL, 1);
+	}
+	lua_pop(gL, 1);
+
+	qsort(consistencyvars, numconsistencyvars, sizeof (*consistencyvars), CompareConsistencyVars);
+	for (i = 0; i < numconsistencyvars && i < maxvars; i++)
+	{
+		names[i] = consistencyvars[i].name;
+		values[i] = consistencyvars[i].value;
+	}
+	*numvars = (UINT8)i;
+
+	return (0x811C9DC5 ^ LUA_TTABLE) ^ sum;
+}
+
+/** Finds the name of a variable hashed by LUA_ConsistencyHash.
+  *
+  * \param name Hash of the name.
+  * \return The name, or NULL if no object has a variable by that name now.
+  */
+const char *LUA_ConsistencyVarName(UINT32 name)
+{
+	static char found[64];
+	int top;
+
+	if (!gL)
+		return NULL;
+
+	top = lua_gettop(gL);
+	found[0] = '\0';
+	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
+	lua_pushnil(gL);
+	while (!found[0] && lua_next(gL, -2))
+	{
+		if (!lua_istable(gL, -1))
+		{
+			lua_pop(gL, 1);
+			continue;
+		}
+
+		lua_pushnil(gL);
+		while (lua_next(gL, -2))
+		{
+			if (lua_type(gL, -2) == LUA_TSTRING && HashLuaValue(-2, 0) == name)
+			{
+				strlcpy(found, lua_tostring(gL, -2), sizeof (found));
+				break;
+			}
+			lua_pop(gL, 1);
+		}
+		lua_settop(gL, top + 2);
+	}
+	lua_settop(gL, top);
+
+	return found[0] ? found : NULL;
+}
+
 void LUA_Archive(void)
 {
 	INT32 i;
@@ -57,6 +57,8 @@ void LUA_InvalidatePlayer(player_t *player);
 void LUA_Step(void);
 void LUA_Archive(void);
 void LUA_UnArchive(void);
+UINT32 LUA_ConsistencyHash(UINT32 *names, UINT32 *values, UINT8 *numvars, UINT8 maxvars);
+const char *LUA_ConsistencyVarName(UINT32 name);
 
 void LUA_ArchiveDemo(void);
 void LUA_UnArchiveDemo(void);
@@ -4638,19 +4638,6 @@ void M_Ticker(void)
 			setmodeneeded = vidm_previousmode + 1;
 	}
 
-#if defined (MASTERSERVER) && defined (HAVE_THREADS)
-	I_lock_mutex(&ms_ServerList_mutex);
-	{
-		if (ms_ServerList)
-		{
-			CL_QueryServerList(ms_ServerList);
-			free(ms_ServerList);
-			ms_ServerList = NULL;
-		}
-	}
-	I_unlock_mutex(ms_ServerList_mutex);
-#endif
-
 	CL_TimeoutServerList();
 }
 
@@ -9335,81 +9322,27 @@ M_GetWaitingMode (void)
 }
 
 #ifdef MASTERSERVER
-#ifdef HAVE_THREADS
 static void
-Spawn_masterserver_thread (const char *name, void (*thread)(int*))
+Got_servers (int fetched, void *server_list, int id)
 {
-	int *id = malloc(sizeof *id);
-
-	I_lock_mutex(&ms_QueryId_mutex);
-	{
-		*id = ms_QueryId;
-	}
-	I_unlock_mutex(ms_QueryId_mutex);
-
-	I_spawn_thread(name, (I_thread_fn)thread, id);
-}
-
-static int
-Same_instance (int id)
-{
-	int okay;
+	/* the menu was left or refreshed since */
+	if (id != ms_QueryId)
+		return;
 
-	I_lock_mutex(&ms_QueryId_mutex);
-	{
-		okay = ( id == ms_QueryId );
-	}
-	I_unlock_mutex(ms_QueryId_mutex);
+	M_SetWaitingMode(M_NOT_WAITING);
 
-	return okay;
+	if (fetched)
+		CL_QueryServerList(server_list);
+	else
+		M_PopupMasterServerConnectError();
 }
-#endif/*HAVE_THREADS*/
 
 static void
-Fetch_servers_thread (int *id)
+Fetch_servers (void)
 {
-	msg_server_t * server_list;
-
-	(void)id;
-
 	M_SetWaitingMode(M_WAITING_SERVERS);
 
-#ifdef HAVE_THREADS
-	server_list = GetShortServersList(*id);
-#else
-	server_list = GetShortServersList(0);
-#endif
-
-	if (server_list)
-	{
-#ifdef HAVE_THREADS
-		if (Same_instance(*id))
-#endif
-		{
-			M_SetWaitingMode(M_NOT_WAITING);
-
-#ifdef HAVE_THREADS
-			I_lock_mutex(&ms_ServerList_mutex);
-			{
-				ms_ServerList = server_list;
-			}
-			I_unlock_mutex(ms_ServerList_mutex);
-#else
-			CL_QueryServerList(server_list);
-			free(server_list);
-#endif
-		}
-#ifdef HAVE_THREADS
-		else
-		{
-			free(server_list);
-		}
-#endif
-	}
-
-#ifdef HAVE_THREADS
-	free(id);
-#endif
+	HMS_fetch_servers(Got_servers, ++ms_QueryId);
 }
 #endif/*MASTERSERVER*/
 
@@ -9472,12 +9405,20 @@ static void M_HandleServerPage(INT32 choice)
 
 static void M_Connect(INT32 choice)
 {
+	const SINT8 node = CL_ServerListNode(choice-FIRSTSERVERLINE + serverlistpage * SERVERS_PER_PAGE);
+
 	// do not call menuexitfunc
 	M_ClearMenus(false);
-	
-	CV_Set(&cv_lastserver, I_GetNodeAddress(serverlist[choice-FIRSTSERVERLINE + serverlistpage * SERVERS_PER_PAGE].node));
-		
-	COM_BufAddText(va("connect node %d\n", serverlist[choice-FIRSTSERVERLINE + serverlistpage * SERVERS_PER_PAGE].node));	
+
+	if (node == -1)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("No free node to connect to this server\n"));
+		return;
+	}
+
+	CV_Set(&cv_lastserver, I_GetNodeAddress(node));
+
+	COM_BufAddText(va("connect node %d\n", node));
 }
 
 static void M_Refresh(INT32 choice)
@@ -9490,11 +9431,7 @@ static void M_Refresh(INT32 choice)
 	CL_UpdateServerList();
 
 #ifdef MASTERSERVER
-#ifdef HAVE_THREADS
-	Spawn_masterserver_thread("fetch-servers", Fetch_servers_thread);
-#else/*HAVE_THREADS*/
-	Fetch_servers_thread(NULL);
-#endif/*HAVE_THREADS*/
+	Fetch_servers();
 #endif/*MASTERSERVER*/
 }
 
@@ -9723,46 +9660,22 @@ void M_SortServerList(void)
 
 #ifndef NONET
 #ifdef UPDATE_ALERT
-#ifdef MASTERSERVER	
-static void M_CheckMODVersion(int id)
-{
-	char updatestring[500];
-	const char *updatecheck = GetMODVersion(id);
-	if(updatecheck)
-	{
-		sprintf(updatestring, UPDATE_ALERT_STRING, VERSIONSTRING, updatecheck);
-#ifdef HAVE_THREADS
-		I_lock_mutex(&m_menu_mutex);
-#endif
-		M_StartMessage(updatestring, NULL, MM_NOTHING);
-#ifdef HAVE_THREADS
-		I_unlock_mutex(m_menu_mutex);
-#endif
-	}
-}
-#endif //MASTERSERVER
-#endif/*UPDATE_ALERT*/
-
-#if defined (UPDATE_ALERT) && defined (HAVE_THREADS)
 #ifdef MASTERSERVER
 static void
-Check_new_version_thread (int *id)
+Got_version (int newer, void *version_name, int id)
 {
-	M_SetWaitingMode(M_WAITING_VERSION);
+	char updatestring[500];
 
-	M_CheckMODVersion(*id);
+	(void)id;
 
-	if (Same_instance(*id))
+	if (newer > 0)
 	{
-		Fetch_servers_thread(id);
-	}
-	else
-	{
-		free(id);
+		sprintf(updatestring, UPDATE_ALERT_STRING, VERSIONSTRING, (char *)version_name);
+		M_StartMessage(updatestring, NULL, MM_NOTHING);
 	}
 }
-#endif
-#endif/*defined (UPDATE_ALERT) && defined (HAVE_THREADS)*/
+#endif //MASTERSERVER
+#endif/*UPDATE_ALERT*/
 
 #ifdef MASTERSERVER
 static void M_ConnectMenu(INT32 choice)
@@ -9779,34 +9692,11 @@ static void M_ConnectMenu(INT32 choice)
 	M_SetupNextMenu(&MP_ConnectDef);
 	itemOn = 0;
 
-#if defined (MASTERSERVER) && defined (HAVE_THREADS)
-	I_lock_mutex(&ms_QueryId_mutex);
-	{
-		ms_QueryId++;
-	}
-	I_unlock_mutex(ms_QueryId_mutex);
-
-	I_lock_mutex(&ms_ServerList_mutex);
-	{
-		if (ms_ServerList)
-		{
-			free(ms_ServerList);
-			ms_ServerList = NULL;
-		}
-	}
-	I_unlock_mutex(ms_ServerList_mutex);
-
-#ifdef UPDATE_ALERT
-	Spawn_masterserver_thread("check-new-version", Check_new_version_thread);
-#else/*UPDATE_ALERT*/
-	Spawn_masterserver_thread("fetch-servers", Fetch_servers_thread);
-#endif/*UPDATE_ALERT*/
-#else/*defined (MASTERSERVER) && defined (HAVE_THREADS)*/
 #ifdef UPDATE_ALERT
-	M_CheckMODVersion(0);
+	/* both go out at once, the server list doesn't wait on this */
+	HMS_compare_mod_version(Got_version, 0);
 #endif/*UPDATE_ALERT*/
 	M_Refresh(0);
-#endif/*defined (MASTERSERVER) && defined (HAVE_THREADS)*/
 }
 
 static void M_ConnectMenuModChecks(INT32 choice)
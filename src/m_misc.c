@@ -563,6 +563,10 @@ void M_SaveConfig(const char *filename)
 	if (!gameconfig_loaded)
 		return;
 
+	// Several -instances servers share one config, let the first one look after it
+	if (serverinstance)
+		return;
+
 	// Create backup of the config file
 	snprintf(backupfile, sizeof backupfile, "%s.bak", configfile);
 	backupfile[sizeof backupfile - 1] = '\0';
@@ -64,6 +64,14 @@ static ps_metric_t ps_removecount = {0};
 
 ps_metric_t ps_checkposition_calls = {0};
 
+ps_metric_t ps_scenerybatch_commits = {0};
+ps_metric_t ps_scenerybatch_fallbacks = {0};
+
+ps_metric_t ps_secnode_rebuilds = {0};
+ps_metric_t ps_secnode_reuses = {0};
+
+ps_metric_t ps_consistency_time = {0};
+
 ps_metric_t ps_lua_prethinkframe_time = {0};
 ps_metric_t ps_lua_thinkframe_time = {0};
 ps_metric_t ps_lua_postthinkframe_time = {0};
@@ -163,6 +171,7 @@ perfstatrow_t gamelogic_rows[] = {
 	{" lprethinkf", " LUAh_PreThinkFrame:", &ps_lua_prethinkframe_time, PS_TIME|PS_LEVEL},
 	{" lthinkf", " LUAh_ThinkFrame:", &ps_lua_thinkframe_time, PS_TIME|PS_LEVEL},
 	{" lpostthinkf", " LUAh_PostThinkFrame:", &ps_lua_postthinkframe_time, PS_TIME|PS_LEVEL},
+	{" synchsh", " Consistency:    ", &ps_consistency_time, PS_TIME|PS_HIDE_ZERO|PS_LEVEL},
 	{" other  ", " Other:          ", &ps_otherlogictime, PS_TIME|PS_LEVEL},
 	{0}
 };
@@ -182,6 +191,10 @@ perfstatrow_t thinkercount_rows[] = {
 perfstatrow_t misc_calls_rows[] = {
 	{"lmhook", "Lua mobj hooks: ", &ps_lua_mobjhooks, PS_LEVEL},
 	{"chkpos", "P_CheckPosition:", &ps_checkposition_calls, PS_LEVEL},
+	{"scnbtch", "Batched scenery:", &ps_scenerybatch_commits, PS_HIDE_ZERO|PS_LEVEL},
+	{"scnfall", "Batch fallbacks:", &ps_scenerybatch_fallbacks, PS_HIDE_ZERO|PS_LEVEL},
+	{"secbld", "Sector rebuilds:", &ps_secnode_rebuilds, PS_LEVEL},
+	{"secreuse", "Sector reuses:  ", &ps_secnode_reuses, PS_LEVEL},
 	{0}
 };
 
@@ -646,6 +659,7 @@ void PS_UpdateTickStats(void)
 				ps_tictime.value.p -
 				ps_playerthink_time.value.p -
 				ps_thinkertime.value.p -
+				ps_consistency_time.value.p -
 				ps_lua_prethinkframe_time.value.p -
 				ps_lua_thinkframe_time.value.p -
 				ps_lua_postthinkframe_time.value.p;
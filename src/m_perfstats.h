@@ -44,6 +44,14 @@ extern ps_metric_t ps_thlist_times[];
 
 extern ps_metric_t ps_checkposition_calls;
 
+extern ps_metric_t ps_scenerybatch_commits;
+extern ps_metric_t ps_scenerybatch_fallbacks;
+
+extern ps_metric_t ps_secnode_rebuilds;
+extern ps_metric_t ps_secnode_reuses;
+
+extern ps_metric_t ps_consistency_time;
+
 extern ps_metric_t ps_lua_prethinkframe_time;
 extern ps_metric_t ps_lua_thinkframe_time;
 extern ps_metric_t ps_lua_postthinkframe_time;
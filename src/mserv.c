@@ -19,7 +19,6 @@
 #include "doomdef.h"
 #include "console.h" // con_startup
 #include "command.h"
-#include "i_threads.h"
 #include "mserv.h"
 #include "m_menu.h"
 #include "z_zone.h"
@@ -41,17 +40,6 @@ static time_t  MSLastPing;
 
 static char *MSRules;
 
-#ifdef HAVE_THREADS
-static I_mutex MSMutex;
-static I_cond  MSCond;
-
-#  define Lock_state()   I_lock_mutex  (&MSMutex)
-#  define Unlock_state() I_unlock_mutex (MSMutex)
-#else/*HAVE_THREADS*/
-#  define Lock_state()
-#  define Unlock_state()
-#endif/*HAVE_THREADS*/
-
 #ifndef NONET
 static void Command_Listserv_f(void);
 #endif
@@ -95,12 +83,8 @@ consvar_t cv_masterserver_nagattempts = {"masterserver_nagattempts", "5", CV_SAV
 #endif
 
 
-#if defined (MASTERSERVER) && defined (HAVE_THREADS)
+#ifdef MASTERSERVER
 int           ms_QueryId;
-I_mutex       ms_QueryId_mutex;
-
-msg_server_t *ms_ServerList;
-I_mutex       ms_ServerList_mutex;
 #endif
 
 UINT16 current_port = 0;
@@ -136,70 +120,6 @@ void AddMServCommands(void)
 
 #ifdef MASTERSERVER
 
-static void WarnGUI (void)
-{
-#ifdef HAVE_THREADS
-	I_lock_mutex(&m_menu_mutex);
-#endif
-	M_PopupMasterServerConnectError();
-#ifdef HAVE_THREADS
-	I_unlock_mutex(m_menu_mutex);
-#endif
-}
-
-#define NUM_LIST_SERVER MAXSERVERLIST
-msg_server_t *GetShortServersList(int id)
-{
-	msg_server_t *server_list;
-
-	// +1 for easy test
-	server_list = malloc(( NUM_LIST_SERVER + 1 ) * sizeof *server_list);
-
-	if (HMS_fetch_servers(server_list, id))
-		return server_list;
-	else
-	{
-		free(server_list);
-		WarnGUI();
-		return NULL;
-	}
-}
-
-#ifdef UPDATE_ALERT
-char *GetMODVersion(int id)
-{
-	char *buffer;
-	int c;
-
-	(void)id;
-
-	buffer = malloc(16);
-
-	c = HMS_compare_mod_version(buffer, 16);
-
-#ifdef HAVE_THREADS
-	I_lock_mutex(&ms_QueryId_mutex);
-	{
-		if (id != ms_QueryId)
-			c = -1;
-	}
-	I_unlock_mutex(ms_QueryId_mutex);
-#endif
-
-	if (c > 0)
-		return buffer;
-	else
-	{
-		free(buffer);
-
-		if (! c)
-			WarnGUI();
-
-		return NULL;
-	}
-}
-#endif
-
 #ifndef NONET
 /** Gets a list of game servers. Called from console.
   */
@@ -213,320 +133,143 @@ static void Command_Listserv_f(void)
 }
 #endif
 
-static boolean firstmsrules = false;
+/*
+Everything here runs on the main thread. The requests themselves are
+answered later, from MasterClient_Ticker, so each callback checks the
+id it was sent with against MSId to see whether it's still wanted.
+*/
+
+static void UpdateServer(void);
 
 static void
-Get_masterserver_rules (boolean checkfirst)
+Print_rules (void)
 {
-	char rules[256];
-
-	if (checkfirst)
-	{
-		boolean MSRulesExist;
-
-		Lock_state();
-		MSRulesExist = (MSRules != NULL);
-		Unlock_state();
+	CONS_Printf("\n");
+	CONS_Alert(CONS_NOTICE, "%s\n", MSRules);
+}
 
-		if (MSRulesExist)
-			return;
-	}
+static void
+Got_rules (int ok, void *rules, int id)
+{
+	(void)id;
 
-	if (HMS_fetch_rules(rules, sizeof rules))
+	if (ok)
 	{
-		Lock_state();
 		Z_Free(MSRules);
 		MSRules = Z_StrDup(rules);
 
 		if (MSRegistered == true)
-		{
-			CONS_Printf("\n");
-			CONS_Alert(CONS_NOTICE, "%s\n", rules);
-		}
-
-		firstmsrules = true;
-
-		Unlock_state();
+			Print_rules();
 	}
 }
 
 static void
-Finish_registration (void)
+Update_done (void)
 {
-	int registered;
-
-	CONS_Printf("Registering this server on the master server...\n");
-
-	registered = HMS_register();
-
-	Lock_state();
-	{
-		MSRegistered = registered;
-		MSRegisteredId = MSId;
+	MSInProgress = false;
 
-		time(&MSLastPing);
-	}
-	Unlock_state();
-
-	char *rules = GetMasterServerRules();
-	if (rules == NULL)
-	{
-		Get_masterserver_rules(true);
-	}
-	else
-	{
-		CONS_Printf("\n");
-		CONS_Alert(CONS_NOTICE, "%s\n", rules);
-	}
-
-	if (registered)
-		CONS_Printf("Master server registration successful.\n");
+	if (MSUpdateAgain)
+		UpdateServer();
 }
 
 static void
-Finish_update (void)
+Registered (int ok, void *result, int id)
 {
-	int registered;
-	int done;
+	(void)result;
 
-	Lock_state();
+	if (id == MSId)
 	{
-		registered = MSRegistered;
-		MSUpdateAgain = false;/* this will happen anyway */
-	}
-	Unlock_state();
+		MSRegistered = ok;
+		MSRegisteredId = MSId;
 
-	if (registered)
-	{
-		if (HMS_update())
-		{
-			Lock_state();
-			{
-				time(&MSLastPing);
-				MSRegistered = true;
-			}
-			Unlock_state();
+		time(&MSLastPing);
 
-			CONS_Printf("Updated master server listing.\n");
-		}
+		if (MSRules)
+			Print_rules();
 		else
-			Finish_registration();
-	}
-	else
-		Finish_registration();
-
-	Lock_state();
-	{
-		done = ! MSUpdateAgain;
-
-		if (done)
-			MSInProgress = false;
-	}
-	Unlock_state();
-
-	if (! done)
-		Finish_update();
-}
-
-static void
-Finish_unlist (void)
-{
-	int registered;
-
-	Lock_state();
-	{
-		registered = MSRegistered;
-
-		if (MSId == MSRegisteredId)
-			MSId++;
-	}
-	Unlock_state();
+			HMS_fetch_rules(Got_rules, 0);
 
-	if (registered)
-	{
-		CONS_Printf("Removing this server from the master server...\n");
-
-		if (HMS_unlist())
-			CONS_Printf("Server deregistration request successfully sent.\n");
-
-		Lock_state();
-		{
-			MSRegistered = false;
-		}
-		Unlock_state();
-
-#ifdef HAVE_THREADS
-		I_wake_all_cond(&MSCond);
-#endif
+		if (ok)
+			CONS_Printf("Master server registration successful.\n");
 	}
-}
-
-static void
-Finish_masterserver_change (char *api)
-{
-	HMS_set_api(api);
 
-	if (!con_startup)
-		Get_masterserver_rules(false);
-}
-
-#ifdef HAVE_THREADS
-static int *
-Server_id (void)
-{
-	int *id;
-	id = malloc(sizeof *id);
-	Lock_state();
-	{
-		*id = MSId;
-	}
-	Unlock_state();
-	return id;
-}
-
-static int *
-New_server_id (void)
-{
-	int *id;
-	id = malloc(sizeof *id);
-	Lock_state();
-	{
-		*id = ++MSId;
-		I_wake_all_cond(&MSCond);
-	}
-	Unlock_state();
-	return id;
+	if (MSInProgress)
+		Update_done();
 }
 
 static void
-Register_server_thread (int *id)
+Register (void)
 {
-	int same;
-
-	Lock_state();
-	{
-		/* wait for previous unlist to finish */
-		while (*id == MSId && MSRegistered)
-			I_hold_cond(&MSCond, MSMutex);
-
-		same = ( *id == MSId );/* it could have been a while */
-	}
-	Unlock_state();
-
-	if (same)/* it could have been a while */
-		Finish_registration();
+	CONS_Printf("Registering this server on the master server...\n");
 
-	free(id);
+	HMS_register(Registered, MSId);
 }
 
 static void
-Update_server_thread (int *id)
+Updated (int ok, void *result, int id)
 {
-	int same;
+	(void)result;
 
-	Lock_state();
+	if (id != MSId)
+		Update_done();
+	else if (ok)
 	{
-		same = ( *id == MSRegisteredId );
-	}
-	Unlock_state();
-
-	if (same)
-		Finish_update();
-
-	free(id);
-}
+		time(&MSLastPing);
+		MSRegistered = true;
 
-static void
-Unlist_server_thread (int *id)
-{
-	int same;
+		CONS_Printf("Updated master server listing.\n");
 
-	Lock_state();
-	{
-		same = ( *id == MSRegisteredId );
+		Update_done();
 	}
-	Unlock_state();
-
-	if (same)
-		Finish_unlist();
-
-	free(id);
+	else
+		Register();/* Registered calls Update_done */
 }
 
 static void
-Change_masterserver_thread (char *api)
+Unlisted (int ok, void *result, int id)
 {
-	Lock_state();
-	{
-		while (MSRegistered)
-			I_hold_cond(&MSCond, MSMutex);
-	}
-	Unlock_state();
-
-	Finish_masterserver_change(api);
-}
+	(void)result;
+	(void)id;
 
-static void
-Get_masterserver_rules_thread (void)
-{
-	// THIS FUNC has its own lock check in it
-	Get_masterserver_rules(true);
+	if (ok)
+		CONS_Printf("Server deregistration request successfully sent.\n");
 }
 
-#endif/*HAVE_THREADS*/
-
 void RegisterServer(void)
 {
-#ifdef MASTERSERVER
-#ifdef HAVE_THREADS
-	I_spawn_thread(
-			"register-server",
-			(I_thread_fn)Register_server_thread,
-			New_server_id()
-	);
-#else
-	Finish_registration();
-#endif
-#endif/*MASTERSERVER*/
+	++MSId;
+	Register();
 }
 
 static void UpdateServer(void)
 {
-#ifdef HAVE_THREADS
-	I_spawn_thread(
-			"update-server",
-			(I_thread_fn)Update_server_thread,
-			Server_id()
-	);
-#else
-	Finish_update();
-#endif
+	MSInProgress = true;
+	MSUpdateAgain = false;/* this will happen anyway */
+
+	if (MSRegistered)
+		HMS_update(Updated, MSId);
+	else
+		Register();
 }
 
 void UnregisterServer(void)
 {
-#ifdef MASTERSERVER
-#ifdef HAVE_THREADS
-	I_spawn_thread(
-			"unlist-server",
-			(I_thread_fn)Unlist_server_thread,
-			Server_id()
-	);
-#else
-	Finish_unlist();
-#endif
-#endif/*MASTERSERVER*/
+	/* anything still on its way back is stale now */
+	MSId++;
+
+	if (MSRegistered)
+	{
+		CONS_Printf("Removing this server from the master server...\n");
+		MSRegistered = false;
+	}
+
+	/* does nothing unless the server was actually listed */
+	HMS_unlist(Unlisted, MSId);
 }
 
 char *GetMasterServerRules(void)
 {
-	char *rules;
-
-	Lock_state();
-	rules = MSRules ? Z_StrDup(MSRules) : NULL;
-	Unlock_state();
-
-	return rules;
+	return MSRules ? Z_StrDup(MSRules) : NULL;
 }
 
 static boolean
@@ -537,64 +280,53 @@ Online (void)
 
 static inline void SendPingToMasterServer(void)
 {
-	int ready;
 	time_t now;
 
 	if (Online())
 	{
 		time(&now);
 
-		Lock_state();
-		{
-			ready = (
-					MSRegisteredId == MSId &&
-					! MSInProgress &&
-					now >= ( MSLastPing + 60 * cv_masterserver_update_rate.value )
-			);
-
-			if (ready)
-				MSInProgress = true;
-		}
-		Unlock_state();
-
-		if (ready)
+		if (
+				MSRegisteredId == MSId &&
+				! MSInProgress &&
+				now >= ( MSLastPing + 60 * cv_masterserver_update_rate.value )
+		){
 			UpdateServer();
+		}
 	}
 }
 
 void MasterClient_Ticker(void)
 {
 #ifdef MASTERSERVER
+	HMS_ticker();
 	SendPingToMasterServer();
 #endif
 }
 
+static void
+Api_changed (int ok, void *result, int id)
+{
+	(void)ok;
+	(void)result;
+	(void)id;
+
+	if (!con_startup)
+		HMS_fetch_rules(Got_rules, 0);
+}
+
 static void
 Set_api (const char *api)
 {
-#ifdef HAVE_THREADS
-	I_spawn_thread(
-			"change-masterserver",
-			(I_thread_fn)Change_masterserver_thread,
-			strdup(api)
-	);
-#else
-	Finish_masterserver_change(strdup(api));
-#endif
+	/* queued behind the unlist, so that goes to the old one */
+	HMS_set_api(api, Api_changed, 0);
 }
 
 void
 Get_rules (void)
 {
-#ifdef HAVE_THREADS
-	I_spawn_thread(
-		"get-masterserver-rules",
-		(I_thread_fn)Get_masterserver_rules_thread,
-				   NULL
-	);
-#else
-	Get_masterserver_rules(true);
-#endif
+	if (! MSRules)
+		HMS_fetch_rules(Got_rules, 0);
 }
 
 #endif/*MASTERSERVER*/
@@ -603,23 +335,11 @@ static void
 Update_parameters (void)
 {
 #ifdef MASTERSERVER
-	int registered;
-	int delayed;
-
 	if (Online())
 	{
-		Lock_state();
-		{
-			delayed = MSInProgress;
-
-			if (delayed)/* do another update after the current one */
-				MSUpdateAgain = true;
-			else
-				registered = MSRegistered;
-		}
-		Unlock_state();
-
-		if (! delayed && registered)
+		if (MSInProgress)/* do another update after the current one */
+			MSUpdateAgain = true;
+		else if (MSRegistered)
 			UpdateServer();
 	}
 #endif/*MASTERSERVER*/
@@ -641,19 +361,11 @@ static void MasterServer_OnChange(void)
 static void
 Advertise_OnChange(void)
 {
-	int different;
-
 	if (cv_advertise.value)
 	{
 		if (serverrunning && netgame)
 		{
-			Lock_state();
-			{
-				different = ( MSId != MSRegisteredId );
-			}
-			Unlock_state();
-
-			if (different)
+			if (MSId != MSRegisteredId)
 			{
 				RegisterServer();
 			}
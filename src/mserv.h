@@ -71,14 +71,9 @@ extern consvar_t cv_masterserver_nagattempts;
 extern consvar_t cv_rendezvousserver;
 #endif
 
-#ifdef HAVE_THREADS
+#ifdef MASTERSERVER
 extern int           ms_QueryId;
-extern I_mutex       ms_QueryId_mutex;
 
-extern msg_server_t *ms_ServerList;
-extern I_mutex       ms_ServerList_mutex;
-#endif
-#ifdef MASTERSERVER
 void RegisterServer(void);
 void UnregisterServer(void);
 
@@ -86,11 +81,6 @@ void Get_rules(void);
 
 void MasterClient_Ticker(void);
 
-msg_server_t *GetShortServersList(int id);
-#ifdef UPDATE_ALERT
-char *GetMODVersion(int id);
-#endif
-
 char *GetMasterServerRules(void);
 #endif
 
@@ -98,14 +88,27 @@ void AddMServCommands(void);
 
 #ifdef MASTERSERVER
 /* HTTP */
-void HMS_set_api (char *api);
-int  HMS_register (void);
-int  HMS_unlist (void);
-int  HMS_update (void);
+
+/*
+Requests are queued and answered later, on the main thread, from
+HMS_ticker. 'ok' is zero on failure; 'result' is freed once the
+callback returns.
+*/
+typedef void (*HMS_done_fn)(int ok, void *result, int id);
+
+void HMS_ticker (void);
+
+void HMS_set_api (const char *api, HMS_done_fn done, int id);
+void HMS_register (HMS_done_fn done, int id);
+void HMS_unlist (HMS_done_fn done, int id);
+void HMS_update (HMS_done_fn done, int id);
 void HMS_list_servers (void);
-msg_server_t * HMS_fetch_servers (msg_server_t *list, int id);
-int  HMS_compare_mod_version (char *buffer, size_t size_of_buffer);
-const char * HMS_fetch_rules (char *buffer, size_t size_of_buffer);
+/* result is a msg_server_t list, terminated by a zeroed header */
+void HMS_fetch_servers (HMS_done_fn done, int id);
+/* ok > 0 and result is the version name if there's a newer version */
+void HMS_compare_mod_version (HMS_done_fn done, int id);
+/* result is the rules text */
+void HMS_fetch_rules (HMS_done_fn done, int id);
 
 #endif
 
@@ -38,7 +38,7 @@
 
 #include "lua_hook.h"
 
-#include "m_perfstats.h" // ps_checkposition_calls
+#include "m_perfstats.h" // ps_checkposition_calls, ps_secnode_*
 
 fixed_t tmbbox[4];
 mobj_t *tmthing;
@@ -4057,8 +4057,27 @@ void P_DelPrecipSeclist(mprecipsecnode_t *node)
 // at this location, so don't bother with checking impassable or
 // blocking lines.
 
+// Box around tmbbox that P_CreateSecNodeList also checks for lines. If no
+// line crosses it, the whole box is inside one sector, and the thing can move
+// anywhere inside it without its sector list changing.
+#define SECNODEMARGIN (32*FRACUNIT)
+static fixed_t secnodebox[4];
+static boolean secnodeboxclear;
+
 static inline boolean PIT_GetSectors(line_t *ld)
 {
+	if (secnodebox[BOXRIGHT] <= ld->bbox[BOXLEFT] ||
+		secnodebox[BOXLEFT] >= ld->bbox[BOXRIGHT] ||
+		secnodebox[BOXTOP] <= ld->bbox[BOXBOTTOM] ||
+		secnodebox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+		return true;
+
+	if (ld->polyobj) // line belongs to a polyobject, don't add it
+		return true;
+
+	if (P_BoxOnLineSide(secnodebox, ld) == -1)
+		secnodeboxclear = false;
+
 	if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT] ||
 		tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT] ||
 		tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM] ||
@@ -4068,9 +4087,6 @@ static inline boolean PIT_GetSectors(line_t *ld)
 	if (P_BoxOnLineSide(tmbbox, ld) != -1)
 		return true;
 
-	if (ld->polyobj) // line belongs to a polyobject, don't add it
-		return true;
-
 	// This line crosses through the object.
 
 	// Collect the sector(s) from the line and add to the
@@ -4128,6 +4144,11 @@ static inline boolean PIT_GetPrecipSectors(line_t *ld)
 
 // P_CreateSecNodeList alters/creates the sector_list that shows what sectors
 // the object resides in.
+//
+// Most moves leave a thing inside the one sector it was already in. When the
+// last rebuild left the thing in a single sector with no lines anywhere near
+// it (thing->secnodebox), and it is still within that area, the list it
+// already has is the one a rebuild would produce, so the blockmap is skipped.
 
 void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 {
@@ -4136,17 +4157,6 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 	mobj_t *saved_tmthing = tmthing; /* cph - see comment at func end */
 	fixed_t saved_tmx = tmx, saved_tmy = tmy; /* ditto */
 
-	// First, clear out the existing m_thing fields. As each node is
-	// added or verified as needed, m_thing will be set properly. When
-	// finished, delete all nodes where m_thing is still NULL. These
-	// represent the sectors the Thing has vacated.
-
-	while (node)
-	{
-		node->m_thing = NULL;
-		node = node->m_sectorlist_next;
-	}
-
 	P_SetTarget(&tmthing, thing);
 	tmflags = thing->flags;
 
@@ -4160,33 +4170,71 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 
 	validcount++; // used to make sure we only process a line once
 
-	xl = (unsigned)(tmbbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
-	xh = (unsigned)(tmbbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
-	yl = (unsigned)(tmbbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
-	yh = (unsigned)(tmbbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+	if (node && !node->m_sectorlist_next
+		&& node->m_sector == thing->subsector->sector
+		&& thing->secnodebox[BOXRIGHT] > thing->secnodebox[BOXLEFT] // set by a previous rebuild
+		&& tmbbox[BOXLEFT] >= thing->secnodebox[BOXLEFT]
+		&& tmbbox[BOXRIGHT] <= thing->secnodebox[BOXRIGHT]
+		&& tmbbox[BOXBOTTOM] >= thing->secnodebox[BOXBOTTOM]
+		&& tmbbox[BOXTOP] <= thing->secnodebox[BOXTOP])
+	{
+		node->m_thing = thing;
+		ps_secnode_reuses.value.i++;
+	}
+	else
+	{
+		// First, clear out the existing m_thing fields. As each node is
+		// added or verified as needed, m_thing will be set properly. When
+		// finished, delete all nodes where m_thing is still NULL. These
+		// represent the sectors the Thing has vacated.
 
-	BMBOUNDFIX(xl, xh, yl, yh);
+		while (node)
+		{
+			node->m_thing = NULL;
+			node = node->m_sectorlist_next;
+		}
 
-	for (bx = xl; bx <= xh; bx++)
-		for (by = yl; by <= yh; by++)
-			P_BlockLinesIterator(bx, by, PIT_GetSectors);
+		secnodebox[BOXTOP] = tmbbox[BOXTOP] + SECNODEMARGIN;
+		secnodebox[BOXBOTTOM] = tmbbox[BOXBOTTOM] - SECNODEMARGIN;
+		secnodebox[BOXRIGHT] = tmbbox[BOXRIGHT] + SECNODEMARGIN;
+		secnodebox[BOXLEFT] = tmbbox[BOXLEFT] - SECNODEMARGIN;
+		secnodeboxclear = true;
 
-	// Add the sector of the (x, y) point to sector_list.
-	sector_list = P_AddSecnode(thing->subsector->sector, thing, sector_list);
+		xl = (unsigned)(secnodebox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+		xh = (unsigned)(secnodebox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+		yl = (unsigned)(secnodebox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+		yh = (unsigned)(secnodebox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
 
-	// Now delete any nodes that won't be used. These are the ones where
-	// m_thing is still NULL.
-	node = sector_list;
-	while (node)
-	{
-		if (!node->m_thing)
+		BMBOUNDFIX(xl, xh, yl, yh);
+
+		for (bx = xl; bx <= xh; bx++)
+			for (by = yl; by <= yh; by++)
+				P_BlockLinesIterator(bx, by, PIT_GetSectors);
+
+		// Add the sector of the (x, y) point to sector_list.
+		sector_list = P_AddSecnode(thing->subsector->sector, thing, sector_list);
+
+		// Now delete any nodes that won't be used. These are the ones where
+		// m_thing is still NULL.
+		node = sector_list;
+		while (node)
 		{
-			if (node == sector_list)
-				sector_list = node->m_sectorlist_next;
-			node = P_DelSecnode(node);
+			if (!node->m_thing)
+			{
+				if (node == sector_list)
+					sector_list = node->m_sectorlist_next;
+				node = P_DelSecnode(node);
+			}
+			else
+				node = node->m_sectorlist_next;
 		}
+
+		if (secnodeboxclear)
+			M_Memcpy(thing->secnodebox, secnodebox, sizeof (secnodebox));
 		else
-			node = node->m_sectorlist_next;
+			memset(thing->secnodebox, 0, sizeof (thing->secnodebox));
+
+		ps_secnode_rebuilds.value.i++;
 	}
 
 	/* cph -
@@ -33,6 +33,7 @@
 #include "lua_hook.h"
 #include "b_bot.h"
 #include "p_slopes.h"
+#include "m_perfstats.h"
 
 #include "k_kart.h"
 
@@ -9285,8 +9286,9 @@ void P_PushableThinker(mobj_t *mobj)
 	}
 }
 
-// Quick, optimized function for scenery
-void P_SceneryThinker(mobj_t *mobj)
+// Movement half of P_SceneryThinker.
+// Returns false if the mobj was removed.
+static boolean P_SceneryMovement(mobj_t *mobj)
 {
 	if (mobj->flags & MF_BOXICON)
 	{
@@ -9312,7 +9314,7 @@ void P_SceneryThinker(mobj_t *mobj)
 		P_SceneryXYMovement(mobj);
 
 		if (P_MobjWasRemoved(mobj))
-			return;
+			return false;
 	}
 
 	// always do the gravity bit now, that's simpler
@@ -9323,10 +9325,10 @@ void P_SceneryThinker(mobj_t *mobj)
 		|| P_IsObjectInGoop(mobj))
 	{
 		if (!P_SceneryZMovement(mobj))
-			return; // mobj was removed
+			return false; // mobj was removed
 		P_CheckPosition(mobj, mobj->x, mobj->y); // Need this to pick up objects!
 		if (P_MobjWasRemoved(mobj))
-			return;
+			return false;
 		mobj->floorz = tmfloorz;
 		mobj->ceilingz = tmceilingz;
 	}
@@ -9336,6 +9338,15 @@ void P_SceneryThinker(mobj_t *mobj)
 		mobj->eflags &= ~MFE_JUSTHITFLOOR;
 	}
 
+	return true;
+}
+
+// Quick, optimized function for scenery
+void P_SceneryThinker(mobj_t *mobj)
+{
+	if (!P_SceneryMovement(mobj))
+		return;
+
 	P_CycleMobjState(mobj);
 
 	if (mobj->type != MT_RANDOMAUDIENCE)
@@ -9374,6 +9385,279 @@ void P_SceneryThinker(mobj_t *mobj)
 	}
 }
 
+//
+// P_SceneryTypeHasThinker
+//
+// Scenery types with their own case in P_MobjThinker's MF_SCENERY switch.
+// Keep this in sync with that switch!
+//
+static boolean P_SceneryTypeHasThinker(mobjtype_t type)
+{
+	switch (type)
+	{
+		case MT_HOOP:
+		case MT_NIGHTSPARKLE:
+		case MT_NIGHTSLOOPHELPER:
+		case MT_OVERLAY:
+		case MT_SHADOW:
+		case MT_ORBINAUT_SHIELD:
+		case MT_JAWZ_SHIELD:
+		case MT_BANANA_SHIELD:
+		case MT_SSMINE_SHIELD:
+		case MT_EGGMANITEM_SHIELD:
+		case MT_SINK_SHIELD:
+		case MT_SMOLDERING:
+		case MT_BOOMPARTICLE:
+		case MT_BATTLEBUMPER:
+		case MT_PLAYERARROW:
+		case MT_PLAYERWANTED:
+		case MT_PETSMOKER:
+		case MT_WATERDROP:
+		case MT_BUBBLES:
+		case MT_SMALLBUBBLE:
+		case MT_MEDIUMBUBBLE:
+		case MT_EXTRALARGEBUBBLE:
+		case MT_DROWNNUMBERS:
+		case MT_FLAMEJET:
+		case MT_VERTICALFLAMEJET:
+		case MT_SEED:
+		case MT_ROCKCRUMBLE1:
+		case MT_ROCKCRUMBLE2:
+		case MT_ROCKCRUMBLE3:
+		case MT_ROCKCRUMBLE4:
+		case MT_ROCKCRUMBLE5:
+		case MT_ROCKCRUMBLE6:
+		case MT_ROCKCRUMBLE7:
+		case MT_ROCKCRUMBLE8:
+		case MT_ROCKCRUMBLE9:
+		case MT_ROCKCRUMBLE10:
+		case MT_ROCKCRUMBLE11:
+		case MT_ROCKCRUMBLE12:
+		case MT_ROCKCRUMBLE13:
+		case MT_ROCKCRUMBLE14:
+		case MT_ROCKCRUMBLE15:
+		case MT_ROCKCRUMBLE16:
+		case MT_FIREDITEM:
+		// Special cased outside of the switch
+		case MT_GHOST:
+		case MT_EGGMOBILE_FIRE:
+		case MT_RANDOMAUDIENCE:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//
+// P_CanBatchSceneryThink
+//
+// Can this mobj's thinker be split up for P_BatchSceneryThink?
+// Only plain scenery without a thinker of its own qualifies. Movement,
+// gravity and clipping stay in P_CommitSceneryThink on the main thread,
+// so moving scenery like drift dust can be batched too.
+//
+boolean P_CanBatchSceneryThink(mobj_t *mobj)
+{
+	const UINT32 required = MF_SCENERY|MF_NOBLOCKMAP;
+
+	if ((mobj->flags & required) != required)
+		return false;
+
+	if (mobj->flags & (MF_NOTHINK|MF_BOXICON|MF_PUSHABLE))
+		return false;
+
+	if (mobj->player || !mobj->state)
+		return false;
+
+	if (P_SceneryTypeHasThinker(mobj->type))
+		return false;
+
+	if (LUAh_HasMobjThinker(mobj->type))
+		return false;
+
+	return true;
+}
+
+//
+// P_PrepareSceneryThink
+//
+// Snapshot everything P_BatchSceneryThink reads. Main thread only.
+//
+void P_PrepareSceneryThink(scenerythink_t *st, mobj_t *mobj)
+{
+	st->mo = mobj;
+	st->flags = mobj->flags;
+	st->eflags = mobj->eflags;
+	st->scale = mobj->scale;
+	st->destscale = mobj->destscale;
+	st->scalespeed = mobj->scalespeed;
+	st->z = mobj->z;
+	st->floorz = mobj->floorz;
+	st->ceilingz = mobj->ceilingz;
+	st->radius = mobj->radius;
+	st->height = mobj->height;
+	st->fuse = mobj->fuse;
+	st->state = mobj->state;
+	st->tics = mobj->tics;
+	st->frame = mobj->frame;
+	st->anim_duration = mobj->anim_duration;
+	st->serial = false;
+}
+
+static boolean P_SceneryThinkInputsMatch(const scenerythink_t *st)
+{
+	const mobj_t *mobj = st->mo;
+
+	return (mobj->flags == st->flags
+		&& mobj->eflags == st->eflags
+		&& mobj->scale == st->scale
+		&& mobj->destscale == st->destscale
+		&& mobj->scalespeed == st->scalespeed
+		&& mobj->z == st->z
+		&& mobj->floorz == st->floorz
+		&& mobj->ceilingz == st->ceilingz
+		&& mobj->radius == st->radius
+		&& mobj->height == st->height
+		&& mobj->fuse == st->fuse
+		&& mobj->state == st->state
+		&& mobj->tics == st->tics
+		&& mobj->frame == st->frame
+		&& mobj->anim_duration == st->anim_duration);
+}
+
+//
+// P_BatchSceneryThink
+//
+// Runs on worker threads. Mirrors the scaling, fuse and state cycling
+// parts of P_MobjThinker/P_SceneryThinker using only the snapshot and
+// the (read-only) info tables. Never touches the mobj itself.
+//
+void P_BatchSceneryThink(scenerythink_t *st)
+{
+	const mobjinfo_t *info = st->mo->info;
+	const state_t *state = st->state;
+	fixed_t scale = st->scale;
+	fixed_t height = st->height;
+	fixed_t z = st->z;
+	UINT32 frame = st->frame;
+	UINT16 anim_duration = st->anim_duration;
+
+	st->newradius = st->radius;
+
+	// Slowly scale up/down to reach your destscale.
+	if (scale != st->destscale)
+	{
+		const fixed_t oldheight = height;
+		UINT8 correctionType = 0;
+
+		if (z > st->floorz && z + height < st->ceilingz)
+			correctionType = 1;
+		else if (st->eflags & MFE_VERTICALFLIP)
+			correctionType = 2;
+
+		if (abs(scale - st->destscale) < st->scalespeed)
+			scale = st->destscale;
+		else if (scale < st->destscale)
+			scale += st->scalespeed;
+		else
+			scale -= st->scalespeed;
+
+		// P_SetScale, minus the player bits
+		st->newradius = FixedMul(info->radius, scale);
+		height = FixedMul(info->height, scale);
+
+		if (correctionType == 1)
+			z -= (height - oldheight)/2;
+		else if (correctionType == 2)
+			z -= height - oldheight;
+	}
+
+	st->newscale = scale;
+	st->newheight = height;
+	st->newz = z;
+
+	// Scenery object fuse! Very basic!
+	st->newfuse = st->fuse;
+	if (st->newfuse && --st->newfuse == 0)
+	{
+		st->serial = true; // LUAh_MobjFuse, P_RemoveMobj
+		return;
+	}
+
+	// P_CycleStateAnimation
+	if ((frame & FF_ANIMATE) && --anim_duration == 0)
+	{
+		anim_duration = (UINT16)state->var2;
+		if (((++frame) & FF_FRAMEMASK) - (state->frame & FF_FRAMEMASK) > (UINT32)state->var1)
+			frame = (state->frame & FF_FRAMEMASK) | (frame & ~FF_FRAMEMASK);
+	}
+
+	st->newframe = frame;
+	st->newanim_duration = anim_duration;
+	st->newtics = st->tics;
+
+	if (st->newtics != -1 && --st->newtics == 0)
+		st->serial = true; // P_SetMobjState, action functions
+}
+
+//
+// P_CommitSceneryThink
+//
+// Called from P_RunThinkers in place of P_MobjThinker, once it reaches
+// st->mo. Applies the batched result around the parts that have to run
+// on the main thread, in the same order P_MobjThinker would.
+//
+void P_CommitSceneryThink(scenerythink_t *st)
+{
+	mobj_t *mobj = st->mo;
+
+	if (st->serial || !P_SceneryThinkInputsMatch(st)
+		|| (mobj->subsector && GETSECSPECIAL(mobj->subsector->sector->special, 2) == 8))
+	{
+		ps_scenerybatch_fallbacks.value.i++;
+		P_MobjThinker(mobj);
+		return;
+	}
+
+	ps_scenerybatch_commits.value.i++;
+
+	// Remove dead target/tracer.
+	if (mobj->target && P_MobjWasRemoved(mobj->target))
+		P_SetTarget(&mobj->target, NULL);
+	if (mobj->tracer && P_MobjWasRemoved(mobj->tracer))
+		P_SetTarget(&mobj->tracer, NULL);
+	if (mobj->hnext && P_MobjWasRemoved(mobj->hnext))
+		P_SetTarget(&mobj->hnext, NULL);
+	if (mobj->hprev && P_MobjWasRemoved(mobj->hprev))
+		P_SetTarget(&mobj->hprev, NULL);
+
+	mobj->flags2 &= ~MF2_PUSHED;
+	mobj->eflags &= ~(MFE_SPRUNG|MFE_JUSTBOUNCEDWALL);
+
+	tmfloorthing = tmhitthing = NULL;
+
+	mobj->scale = st->newscale;
+	mobj->radius = st->newradius;
+	mobj->height = st->newheight;
+	mobj->z = st->newz;
+	mobj->fuse = st->newfuse;
+
+	if (!P_SceneryMovement(mobj))
+		return;
+
+	// Movement can set states too; if it did, cycle the new one for real.
+	if (mobj->state != st->state || mobj->tics != st->tics
+		|| mobj->frame != st->frame || mobj->anim_duration != st->anim_duration)
+	{
+		P_CycleMobjState(mobj);
+		return;
+	}
+
+	mobj->frame = st->newframe;
+	mobj->anim_duration = st->newanim_duration;
+	mobj->tics = st->newtics;
+}
+
 //
 // GAME SPAWN FUNCTIONS
 //
@@ -305,6 +305,7 @@ typedef struct mobj_s
 	angle_t pitch_sprite, roll_sprite;
 
 	struct msecnode_s *touching_sectorlist; // a linked list of sectors where this object appears
+	fixed_t secnodebox[4]; // area touching_sectorlist stays valid in, see P_CreateSecNodeList
 
 	struct subsector_s *subsector; // Subsector the mobj resides in.
 
@@ -495,6 +496,45 @@ void P_InitCachedActions(void);
 void P_RunCachedActions(void);
 void P_AddCachedAction(mobj_t *mobj, INT32 statenum);
 
+//
+// Batched scenery thinking
+//
+// The mobj-local part of a scenery thinker (fuse, scaling, state animation)
+// is computed on worker threads into one of these, then committed on the
+// main thread at the mobj's own place in the thinker list. Anything with
+// side effects (spawns, removals, state actions, sounds) falls back to the
+// regular P_MobjThinker there, so the result is identical to a serial run.
+//
+typedef struct
+{
+	mobj_t *mo;
+
+	// Inputs as seen when the batch was built. If any of these changed
+	// by the time the mobj's turn comes up, the result is thrown away.
+	UINT32 flags;
+	UINT16 eflags;
+	fixed_t scale, destscale, scalespeed;
+	fixed_t z, floorz, ceilingz, radius, height;
+	INT32 fuse;
+	state_t *state;
+	INT32 tics;
+	UINT32 frame;
+	UINT16 anim_duration;
+
+	// Results
+	boolean serial; // needs the full thinker, don't commit
+	fixed_t newscale, newradius, newheight, newz;
+	INT32 newfuse;
+	INT32 newtics;
+	UINT32 newframe;
+	UINT16 newanim_duration;
+} scenerythink_t;
+
+boolean P_CanBatchSceneryThink(mobj_t *mobj);
+void P_PrepareSceneryThink(scenerythink_t *st, mobj_t *mobj);
+void P_BatchSceneryThink(scenerythink_t *st);
+void P_CommitSceneryThink(scenerythink_t *st);
+
 // check mobj against water content, before movement code
 void P_MobjCheckWater(mobj_t *mobj);
 
@@ -795,7 +795,10 @@ static void P_NetUnArchiveWorld(void)
 		if (diff & SD_LIGHT)
 			sectors[i].lightlevel = READINT16(get);
 		if (diff & SD_SPECIAL)
+		{
 			sectors[i].special = READINT16(get);
+			P_InvalidateSpecialSectors();
+		}
 
 		if (diff2 & SD_FXOFFS)
 			sectors[i].floor_xoffs = READFIXED(get);
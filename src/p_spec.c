@@ -941,6 +941,114 @@ static INT32 P_FindLineFromLineTag(const line_t *line, INT32 start)
 }
 
 
+//
+// Executor tag chains
+//
+// Linedef executors (300-399) linked by tag, like firsttag/nexttag but
+// holding nothing else, so P_LinedefExecute only visits lines that can
+// actually run. Chains are kept in line order since an executor returning
+// false cancels the ones after it. Lines only ever lose their special
+// after this is built, and P_LinedefExecute re-checks it anyway.
+//
+static INT32 *executorfirsttag = NULL;
+static INT32 *executornexttag = NULL;
+
+static void P_InitExecutorTags(void)
+{
+	INT32 i;
+
+	if (!numlines)
+		return;
+
+	Z_Malloc(numlines * sizeof (*executorfirsttag), PU_LEVEL, &executorfirsttag);
+	Z_Malloc(numlines * sizeof (*executornexttag), PU_LEVEL, &executornexttag);
+
+	for (i = 0; i < (INT32)numlines; i++)
+		executorfirsttag[i] = -1;
+
+	for (i = (INT32)numlines - 1; i >= 0; i--)
+	{
+		const INT32 j = (unsigned)lines[i].tag % numlines;
+
+		if (lines[i].special < 300 || lines[i].special > 399)
+		{
+			executornexttag[i] = -1;
+			continue;
+		}
+
+		executornexttag[i] = executorfirsttag[j];
+		executorfirsttag[j] = i;
+	}
+}
+
+//
+// Special sector bits
+//
+// One bit per sector, set if the sector or one of its FOFs has a special.
+// Players touching only clear sectors skip P_PlayerInSpecialSector. Setting
+// a special at runtime (Lua, savegame) must call P_InvalidateSpecialSectors;
+// clearing one may leave the bit set, which only costs the regular check.
+//
+static UINT8 *specialsectors = NULL;
+static boolean specialsectorsdirty = true;
+
+void P_InvalidateSpecialSectors(void)
+{
+	specialsectorsdirty = true;
+}
+
+static void P_UpdateSpecialSectors(void)
+{
+	ffloor_t *rover;
+	size_t i;
+
+	if (!numsectors)
+		return;
+
+	if (!specialsectors)
+		Z_Malloc((numsectors + 7) / 8, PU_LEVEL, &specialsectors);
+	memset(specialsectors, 0, (numsectors + 7) / 8);
+
+	for (i = 0; i < numsectors; i++)
+	{
+		boolean special = (sectors[i].special != 0);
+
+		for (rover = sectors[i].ffloors; rover && !special; rover = rover->next)
+			special = (rover->master->frontsector->special != 0);
+
+		if (special)
+			specialsectors[i >> 3] |= 1 << (i & 7);
+	}
+
+	specialsectorsdirty = false;
+}
+
+static boolean P_TouchingSpecialSector(mobj_t *mo)
+{
+	msecnode_t *node;
+	size_t i;
+
+	if (specialsectorsdirty || !specialsectors)
+	{
+		P_UpdateSpecialSectors();
+		if (!specialsectors)
+			return true;
+	}
+
+	i = mo->subsector->sector - sectors;
+	if (specialsectors[i >> 3] & (1 << (i & 7)))
+		return true;
+
+	for (node = mo->touching_sectorlist; node; node = node->m_sectorlist_next)
+	{
+		i = node->m_sector - sectors;
+		if (specialsectors[i >> 3] & (1 << (i & 7)))
+			return true;
+	}
+
+	return false;
+}
+
 //
 // P_FindSpecialLineFromTag
 //
@@ -1687,13 +1795,21 @@ boolean P_RunTriggerLinedef(line_t *triggerline, mobj_t *actor, sector_t *caller
   */
 void P_LinedefExecute(INT16 tag, mobj_t *actor, sector_t *caller)
 {
-	size_t masterline;
+	INT32 masterline;
 
 	CONS_Debug(DBG_GAMELOGIC, "P_LinedefExecute: Executing trigger linedefs of tag %d\n", tag);
 
 	I_Assert(!actor || !P_MobjWasRemoved(actor)); // If actor is there, it must be valid.
 
-	for (masterline = 0; masterline < numlines; masterline++)
+	// Walk the executor chain for this tag if P_SpawnSpecials built one,
+	// otherwise every line. Either way lines come up in index order.
+	if (executorfirsttag)
+		masterline = executorfirsttag[(unsigned)tag % numlines];
+	else
+		masterline = 0;
+
+	for (; masterline >= 0 && masterline < (INT32)numlines;
+		masterline = executorfirsttag ? executornexttag[masterline] : masterline + 1)
 	{
 		if (lines[masterline].tag != tag)
 			continue;
@@ -4546,6 +4662,10 @@ void P_PlayerInSpecialSector(player_t *player)
 	if (!player->mo)
 		return;
 
+	// Nothing here can apply to a player only touching plain sectors.
+	if (!player->mo->subsector->polyList && !P_TouchingSpecialSector(player->mo))
+		return;
+
 	originalsector = player->mo->subsector->sector;
 
 	P_PlayerOnSpecial3DFloor(player, originalsector); // Handle FOFs first.
@@ -5275,6 +5395,8 @@ void P_SpawnSpecials(INT32 fromnetsave, boolean reloadinggamestate)
 	// but currently isn't.
 	(void)fromnetsave;
 
+	P_InitExecutorTags();
+
 	// Set the default gravity. Custom gravity overrides this setting.
 	gravity = (FRACUNIT*8)/10;
 
@@ -6291,6 +6413,9 @@ void P_SpawnSpecials(INT32 fromnetsave, boolean reloadinggamestate)
 		}
 	}
 
+	// FOFs are all in place now
+	P_InvalidateSpecialSectors();
+
 	if (!reloadinggamestate)
 		P_RunLevelLoadExecutors();
 }
@@ -38,6 +38,7 @@ void P_SpawnSpecials(INT32 fromnetsave, boolean reloadinggamestate);
 void P_UpdateSpecials(void);
 sector_t *P_PlayerTouchingSectorSpecial(player_t *player, INT32 section, INT32 number);
 void P_PlayerInSpecialSector(player_t *player);
+void P_InvalidateSpecialSectors(void);
 void P_ProcessSpecialSector(player_t *player, sector_t *sector, sector_t *roversector);
 
 fixed_t P_FindLowestFloorSurrounding(sector_t *sec);
@@ -31,6 +31,10 @@
 #include "i_video.h" // rendermode
 #include "m_perfstats.h"
 
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
+
 // Object place
 #include "m_cheat.h"
 
@@ -292,6 +296,147 @@ mobj_t *P_SetTarget(mobj_t **mop, mobj_t *targ)
 	return targ;
 }
 
+//
+// Batched scenery thinking
+//
+// Before the thinker loop, plain scenery mobjs are collected into a batch
+// whose mobj-local work (see P_BatchSceneryThink) is split among worker
+// threads. The thinker loop then commits each result when it reaches that
+// mobj, so everything still happens in thinker list order.
+//
+#ifdef HAVE_THREADS
+
+#define MAXSCENERYTHREADS 8
+#define MINSCENERYBATCH 64 // Not worth waking anyone up for less
+
+static CV_PossibleValue_t scenerythreads_cons_t[] = {{0, "MIN"}, {MAXSCENERYTHREADS, "MAX"}, {0, NULL}};
+consvar_t cv_scenerythreads = {"scenerythreads", "0", CV_SAVE, scenerythreads_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+static scenerythink_t *scenerybatch = NULL;
+static size_t scenerybatchsize = 0;
+static size_t scenerybatchcount = 0;
+static size_t scenerybatchpos = 0;
+
+static I_mutex scenery_mutex;
+static I_cond scenery_work_cond;
+static I_cond scenery_done_cond;
+static INT32 scenery_workers = 0; // Spawned so far
+static INT32 scenery_generation = 0;
+static INT32 scenery_parts = 0;
+static INT32 scenery_pending = 0;
+static boolean scenery_quit = false;
+
+static void P_BatchScenerySlice(INT32 part, INT32 parts)
+{
+	size_t i = (scenerybatchcount * part) / parts;
+	const size_t end = (scenerybatchcount * (part + 1)) / parts;
+
+	for (; i < end; i++)
+		P_BatchSceneryThink(&scenerybatch[i]);
+}
+
+static void P_SceneryWorker(void *userdata)
+{
+	const INT32 slot = (INT32)(size_t)userdata;
+	INT32 generation = 0;
+
+	I_lock_mutex(&scenery_mutex);
+	for (;;)
+	{
+		while (generation == scenery_generation && !scenery_quit)
+			I_hold_cond(&scenery_work_cond, scenery_mutex);
+
+		if (scenery_quit)
+			break;
+
+		generation = scenery_generation;
+
+		// The main thread takes the last slice.
+		if (slot < scenery_parts - 1)
+		{
+			const INT32 parts = scenery_parts;
+
+			I_unlock_mutex(scenery_mutex);
+			P_BatchScenerySlice(slot, parts);
+			I_lock_mutex(&scenery_mutex);
+
+			if (--scenery_pending == 0)
+				I_wake_all_cond(&scenery_done_cond);
+		}
+	}
+	I_unlock_mutex(scenery_mutex);
+}
+
+// Workers sleep on a condition variable, so they have to be
+// woken up before I_stop_threads waits on them.
+static void P_StopSceneryWorkers(void)
+{
+	I_lock_mutex(&scenery_mutex);
+	scenery_quit = true;
+	I_wake_all_cond(&scenery_work_cond);
+	I_unlock_mutex(scenery_mutex);
+}
+
+static void P_BuildSceneryBatch(void)
+{
+	thinker_t *th;
+	INT32 parts;
+
+	scenerybatchcount = scenerybatchpos = 0;
+
+	if (!cv_scenerythreads.value)
+		return;
+
+	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	{
+		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+			continue;
+
+		if (!P_CanBatchSceneryThink((mobj_t *)th))
+			continue;
+
+		if (scenerybatchcount >= scenerybatchsize)
+		{
+			scenerybatchsize = scenerybatchsize ? scenerybatchsize * 2 : 256;
+			scenerybatch = Z_Realloc(scenerybatch, scenerybatchsize * sizeof (*scenerybatch), PU_STATIC, NULL);
+		}
+
+		P_PrepareSceneryThink(&scenerybatch[scenerybatchcount++], (mobj_t *)th);
+	}
+
+	if (scenerybatchcount < MINSCENERYBATCH)
+	{
+		scenerybatchcount = 0;
+		return;
+	}
+
+	while (scenery_workers < cv_scenerythreads.value)
+	{
+		if (!scenery_workers)
+			I_AddExitFunc(P_StopSceneryWorkers);
+		I_spawn_thread("scenery-think", P_SceneryWorker, (void *)(size_t)scenery_workers);
+		scenery_workers++;
+	}
+
+	parts = cv_scenerythreads.value + 1;
+
+	I_lock_mutex(&scenery_mutex);
+	scenery_parts = parts;
+	scenery_pending = parts - 1;
+	scenery_generation++;
+	I_wake_all_cond(&scenery_work_cond);
+	I_unlock_mutex(scenery_mutex);
+
+	P_BatchScenerySlice(parts - 1, parts);
+
+	I_lock_mutex(&scenery_mutex);
+	while (scenery_pending)
+		I_hold_cond(&scenery_done_cond, scenery_mutex);
+	I_unlock_mutex(scenery_mutex);
+}
+
+#endif/*HAVE_THREADS*/
+
 //
 // P_RunThinkers
 //
@@ -316,15 +461,38 @@ mobj_t *P_SetTarget(mobj_t **mop, mobj_t *targ)
 //
 static inline void P_RunThinkers(void)
 {
+#ifdef HAVE_THREADS
+	P_BuildSceneryBatch();
+#endif
+
 	for (currentthinker = thinkercap.next; currentthinker != &thinkercap; currentthinker = currentthinker->next)
 	{
 		if (currentthinker->function.acp1 == (actionf_p1)P_NullPrecipThinker)
 			continue;
 #ifdef PARANOIA
 		I_Assert(currentthinker->function.acp1 != NULL)
+#endif
+#ifdef HAVE_THREADS
+		// The batch is in thinker order, and batched mobjs can't be
+		// freed before we get to them, so one cursor is enough.
+		if (scenerybatchpos < scenerybatchcount
+			&& currentthinker == &scenerybatch[scenerybatchpos].mo->thinker)
+		{
+			scenerythink_t *st = &scenerybatch[scenerybatchpos++];
+
+			if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
+			{
+				P_CommitSceneryThink(st);
+				continue;
+			}
+		}
 #endif
 		currentthinker->function.acp1(currentthinker);
 	}
+
+#ifdef HAVE_THREADS
+	scenerybatchcount = scenerybatchpos = 0;
+#endif
 }
 
 static inline void P_DeviceRumbleTick(void)
@@ -518,6 +686,10 @@ void P_Ticker(boolean run)
 		
 		ps_lua_mobjhooks.value.i = 0;
 		ps_checkposition_calls.value.i = 0;
+		ps_scenerybatch_commits.value.i = 0;
+		ps_scenerybatch_fallbacks.value.i = 0;
+		ps_secnode_rebuilds.value.i = 0;
+		ps_secnode_reuses.value.i = 0;
 
 		PS_START_TIMING(ps_lua_prethinkframe_time);
 		LUAh_PreThinkFrame();
@@ -1055,9 +1055,18 @@ void R_Init(void)
 	//I_OutputMsg("\nR_InitData");
 	R_InitData();
 
+	R_SetViewSize(); // setsizeneeded is set true
+	R_InitDrawNodes();
+
+	framecount = 0;
+
+	// The rest only feeds the drawers; a dedicated
+	// server never runs them, so don't pay for it.
+	if (dedicated)
+		return;
+
 	//I_OutputMsg("\nR_InitViewBorder");
 	R_InitViewBorder();
-	R_SetViewSize(); // setsizeneeded is set true
 
 	//I_OutputMsg("\nR_InitPlanes");
 	R_InitPlanes();
@@ -1068,10 +1077,6 @@ void R_Init(void)
 
 	//I_OutputMsg("\nR_InitTranslationTables\n");
 	R_InitTranslationTables();
-
-	R_InitDrawNodes();
-
-	framecount = 0;
 }
 
 //
@@ -115,6 +115,9 @@ typedef LPVOID (WINAPI *p_MapViewOfFile) (HANDLE, DWORD, DWORD, DWORD, SIZE_T);
 #include <errno.h>
 #include <sys/wait.h>
 #define NEWSIGNALHANDLER
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 #endif
 
 #ifndef NOMUMBLE
@@ -3436,6 +3439,56 @@ static void I_Fork(void)
 }
 #endif/*NEWSIGNALHANDLER*/
 
+INT32 I_ForkInstances(INT32 count)
+{
+#ifdef NEWSIGNALHANDLER
+	INT32 i;
+
+	// Children close their copy of the log, which would write its
+	// pending lines to the parent's log once more per child
+	fflush(stdout);
+	fflush(stderr);
+	if (logstream)
+		fflush(logstream);
+
+	for (i = 1; i < count; i++)
+	{
+		switch (fork())
+		{
+			case -1:
+				I_OutputMsg("I_ForkInstances(): couldn't start instance %d: %s\n", i, strerror(errno));
+				return 0;
+			case 0:
+#ifdef __linux__
+				// Go down with the first instance rather than linger on our own
+				prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+				// The first instance keeps the terminal to itself
+				consolevent = SDL_FALSE;
+
+#ifdef LOGMESSAGES
+				if (logstream)
+				{
+					char *ext = strrchr(logfilename, '.');
+
+					fclose(logstream);
+					if (ext && !strcmp(ext, ".txt"))
+						snprintf(ext, sizeof logfilename - (ext - logfilename), "-%d.txt", (int)i);
+					logstream = fopen(logfilename, "wt");
+				}
+#endif
+				return i;
+			default:
+				break;
+		}
+	}
+#else
+	if (count > 1)
+		I_OutputMsg("I_ForkInstances(): not supported on this platform\n");
+#endif
+	return 0;
+}
+
 INT32 I_StartupSystem(void)
 {
 	SDL_version SDLcompiled;
@@ -133,7 +133,8 @@ static boolean InitCube(void)
 	float globalgammamul, globalgammaoffs;
 	boolean doinggamma;
 
-	if (loaded_config == false)
+	// dedicated servers never register the colour cvars, nor show anything
+	if (loaded_config == false || dedicated)
 		return false;
 
 #define diffcons(cv) (cv.value != atoi(cv.defaultvalue))